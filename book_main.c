@@ -0,0 +1,9 @@
+#include "src/window_manager.c"
+#include "src/book_builder.c"
+
+// usage: ./book [file] [trials] [candidates]
+int main(int argc, char **argv) {
+  return run_book_builder(argc > 1 ? argv[1] : BOOK_FILE,
+                          argc > 2 ? atoi(argv[2]) : 0,
+                          argc > 3 ? atoi(argv[3]) : 0);
+}
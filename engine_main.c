@@ -0,0 +1,5 @@
+#include "src/window_manager.c"
+#include "src/engine.c"
+
+// reads the protocol from headers/engine.h on stdin, no ncurses needed
+int main() { return run_engine(stdin, stdout); }
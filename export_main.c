@@ -0,0 +1,4 @@
+#include "src/window_manager.c"
+#include "src/exporter.c"
+
+int main(int argc, char **argv) { return run_exporter(argc, argv); }
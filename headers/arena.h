@@ -0,0 +1,24 @@
+#pragma once
+#include <stddef.h>
+
+// the first block of an arena, bigger requests get a block of their own
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+typedef struct ArenaBlock ArenaBlock;
+
+// zeroed it's an empty arena, see arena.c
+typedef struct {
+  ArenaBlock *first, *current;
+  // the newest allocation, the only one that can grow in place
+  void *last;
+} Arena;
+
+void *arena_alloc(Arena *arena, size_t size);
+void arena_reset(Arena *arena);
+void free_arena(Arena *arena);
+
+// a NULL arena means the heap, so callers can take either
+void *pool_alloc(Arena *arena, size_t size);
+void *pool_realloc(Arena *arena, void *ptr, size_t old_size, size_t size);
+void pool_free(Arena *arena, void *ptr);
@@ -0,0 +1,5 @@
+#pragma once
+
+// capacity of a queue is rounded up to a power of two
+#define ATOMIC_QUEUE_MIN_CAP 2
+#define CACHE_LINE_SIZE 64
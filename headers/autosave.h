@@ -0,0 +1,9 @@
+#pragma once
+
+// the game as of the start of the last turn, load it like any save file
+#define AUTOSAVE_FILE ".autosave.txt"
+// saves waiting for the writer, autosaves are dropped when all are taken
+#define AUTOSAVE_SLOTS 4
+// how often a save the player asked for checks for a free slot
+#define AUTOSAVE_WAIT_US 1000
+#define MAX_SAVE_PATH 256
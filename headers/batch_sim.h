@@ -0,0 +1,25 @@
+#pragma once
+
+// games played side by side by ./sim, one byte lane per game in every
+// point's row
+#define SIM_LANES 32
+// pip 0 holds the checkers borne off, 1-24 the points counted from the
+// side's own bear off and SIM_BAR_PIP its bar
+#define SIM_BAR_PIP 25
+#define SIM_PIPS 26
+// pips of the home board
+#define SIM_HOME_PIPS 6
+// games still going after this many turns end without a result, two
+// closed boards with a checker on each bar never finish
+#define SIM_MAX_TURNS 1000
+#define DEFAULT_SIM_GAMES 100000
+// differing games printed by the check before it goes quiet
+#define MAX_SIM_REPORTS 10
+
+#define SIM_GAMES_FLAG "--games"
+#define SIM_SEED_FLAG "--seed"
+#define SIM_VARIANT_FLAG "--variant"
+#define SIM_POSITION_FLAG "--position"
+#define SIM_CHECK_FLAG "--check"
+
+int run_sim(int argc, char **argv);
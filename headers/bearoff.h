@@ -0,0 +1,9 @@
+#pragma once
+
+#define BEAROFF_SLOTS 6
+// ways to spread up to 15 checkers over the home board, 21 choose 6
+#define BEAROFF_POSITIONS 54264
+// the last bucket also holds the longer bear-offs
+#define BEAROFF_ROLLS 32
+
+float bearoff_win(const int *me, const int *opp);
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdio.h>
+
+// size of the content window the board is drawn into, see CONTENT_WIN_HEIGHT
+// and CONTENT_WIN_WIDTH in window_manager.h
+#define BOARD_TEXT_HEIGHT 15
+#define BOARD_TEXT_WIDTH 55
+// every row ends with '\n' and the whole buffer with '\0'
+#define BOARD_TEXT_LEN (BOARD_TEXT_HEIGHT * (BOARD_TEXT_WIDTH + 1) + 1)
+
+#define ANSI_CLEAR "\x1b[H\x1b[2J"
+#define ANSI_WHITE "\x1b[1;37m"
+#define ANSI_RED "\x1b[1;31m"
+#define ANSI_RESET "\x1b[0m"
+
+typedef enum { PlainText, AnsiText } BoardTextFormat;
+
+void init_board_text();
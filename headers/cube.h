@@ -0,0 +1,14 @@
+#pragma once
+
+// share of the ideal live cube value a player really gets out of the cube,
+// 0 plays the cube as dead and 1 as perfectly efficient
+#define CUBE_EFFICIENCY 0.68f
+
+typedef enum {
+  NoDouble,
+  DoubleTake,
+  DoublePass,
+  TooGoodToDouble,
+} CubeDecision;
+
+const char *cube_decision_str(CubeDecision decision);
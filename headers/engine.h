@@ -0,0 +1,97 @@
+#pragma once
+#include <stdio.h>
+
+// Line protocol read from stdin, one reply line per command unless noted.
+// Points are numbered 1-24 like in the UI, a step is <from>:<by> where from
+// can be "bar" and a trailing '*' marks a hit.
+//   position start|<id>   -> ok, set the position, the id also holds the side
+//                         to move
+//   id                    -> id <position id>
+//   dice <d1> <d2>        -> ok, set the roll of the side to move
+//   roll                  -> dice <d1> <d2>, random roll
+//   eval                  -> eval <equity> <win> <wg> <wbg> <lg> <lbg>
+//   bestmove              -> bestmove <step>... | none
+//   play                  like bestmove, then the play is made
+//   move <step>...        -> id <position id>, make a full play
+//   rollout <n>           -> rollout <n> <equity> <win> <wg> <wbg> <lg> <lbg>
+//   match <len> <white score> <red score> [crawford|post]
+//                         -> ok, length 0 is a money game
+//   cube <value> w|r|-    -> ok, cube value and owner
+//   met <away> <opp away> -> met <match winning chance>, before Crawford
+//   mwc                   -> mwc <cubeless match winning chance of the side
+//                         to move>
+//   weights <file>        -> ok, evaluate with trained network weights, the
+//                         ones in NETWORK_FILE are loaded at startup
+//   raceweights <file>    -> ok, network for races only, the one in
+//                         RACE_NETWORK_FILE is loaded at startup
+//   classes               -> classes <class> <class>:<count>..., class of
+//                         the position and positions evaluated per class
+//   book <file>|off       -> ok, opening book consulted by bestmove and play,
+//                         the one in BOOK_FILE is loaded at startup
+//   savemet <file>        -> ok, write the match equity table
+//   double [rollout]      -> double no-double|double-take|double-pass|too-good
+//                         <no double> <double take> <double pass> <trials>,
+//                         cube action for the side to move before rolling,
+//                         cubeful equities in points or match winning chances
+//   variant backgammon|nackgammon|hypergammon
+//                         -> ok, starting position of the variant, position
+//                         ids are read with its number of checkers
+//   hyper <file>|off      -> ok, exact hypergammon equities, the database in
+//                         HYPER_FILE is loaded at startup
+//   rules standard|house  -> ok, standard rules make bestmove use both dice
+//                         or the larger one, house rules force hits and
+//                         bearing off
+//   filter <stage> <keep> <margin>
+//                         -> ok, after scoring the plays at <stage> plies
+//                         bestmove keeps at most <keep> of them within
+//                         <margin> equity of the best for the next ply
+//   stats                 -> stats <plies>:<plays>:<positions>:<ms>...
+//                         [aborted], plays scored, positions evaluated and
+//                         time taken per stage by the last bestmove, aborted
+//                         when the deadline cut its last stage short and the
+//                         play comes from the stage before, nothing after a
+//                         book play
+//   set plies|seed|trials|threads|cubetime|movetime <n>
+//                         -> ok, cubetime is the double rollout budget in ms,
+//                         movetime the bestmove budget in ms, 0 for none:
+//                         bestmove deepens stage by stage up to plies and
+//                         keeps the best play of the last finished stage
+//   clock <ms> [<increment ms>]|off
+//                         -> ok, game clock of the side the engine plays,
+//                         each bestmove gets the remaining time divided by
+//                         CLOCK_MOVES_LEFT plus the increment and is charged
+//                         what it took; without arguments -> clock <ms>|off
+//   log <file>|off        -> ok, appends a line per bestmove with the position
+//                         id, dice, budget, time, positions and stats
+//   board                 board as text, terminated by a line with "."
+//   isready               -> readyok
+//   quit
+// Errors are reported as "error <reason>". Replies are flushed only when no
+// more input is pending, so queries can be streamed through one process.
+
+#define ENGINE_LINE_LEN 256
+#define ENGINE_TOKEN_LEN 32
+#define DEFAULT_PLIES 0
+#define MAX_PLIES 3
+// stage i of the move filter keeps DEFAULT_FILTER_KEEP >> i plays within
+// DEFAULT_FILTER_MARGIN / 2^i of the best
+#define DEFAULT_FILTER_KEEP 8
+#define DEFAULT_FILTER_MARGIN 0.16f
+#define DEFAULT_ROLLOUT_TRIALS 1296
+#define MAX_ROLLOUT_TRIALS 1000000
+// trials a rollout thread plays between checks of the deadline
+#define ROLLOUT_CHUNK 36
+#define MAX_ENGINE_THREADS 16
+#define DEFAULT_CUBE_TIME_MS 250
+#define MAX_CUBE_TIME_MS 60000
+#define MAX_MOVE_TIME_MS 3600000
+// positions a search evaluates between reads of the clock
+#define SEARCH_CHECK_NODES 256
+// moves the remaining clock time is shared over, about one side's moves in
+// a game, so a budget shrinks as the clock runs down
+#define CLOCK_MOVES_LEFT 20
+#define MAX_ROLLOUT_TURNS 1000
+#define ENGINE_IN_BUF_LEN (1 << 16)
+#define ENGINE_OUT_BUF_LEN (1 << 16)
+
+int run_engine(FILE *in, FILE *out);
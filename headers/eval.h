@@ -0,0 +1,32 @@
+#pragma once
+
+// probabilities for the player on roll, win includes gammons and backgammons
+typedef struct {
+  float win, win_gammon, win_backgammon, lose_gammon, lose_backgammon;
+} EvalOutput;
+
+// evaluators are picked per class, see classify_position
+typedef enum {
+  ClassOver,
+  ClassBearoff,
+  ClassRace,
+  ClassCrashed,
+  ClassContact,
+  POSITION_CLASS_COUNT
+} PositionClass;
+
+// checkers a side may have left outside its ace and deuce points for the
+// position to count as crashed
+#define CRASHED_CHECKERS 6
+
+// heuristic weights, all in units of the logistic score
+#define RACE_ROLL_PIPS 4.0f
+#define RACE_SCALE 2.0f
+#define CONTACT_PIP_WEIGHT 0.02f
+#define CONTACT_HOME_POINT_WEIGHT 0.12f
+#define CONTACT_BLOT_WEIGHT 0.08f
+#define CONTACT_BAR_WEIGHT 0.25f
+#define CONTACT_PRIME_WEIGHT 0.1f
+#define CONTACT_ANCHOR_WEIGHT 0.1f
+#define CONTACT_GAMMON_RATE 0.25f
+#define GAMMON_PIP_SCALE 12.0f
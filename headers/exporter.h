@@ -0,0 +1,7 @@
+#pragma once
+
+#define EXPORT_SELFPLAY_FLAG "--selfplay"
+#define EXPORT_CHECK_FLAG "--check"
+#define MAX_EXPORT_TURNS 1000
+
+int run_exporter(int argc, char **argv);
@@ -13,3 +13,5 @@ const int CONTENT_X_START = CONTENT_HORIZONTAL_MARGIN + 1;
 const int CONTENT_X_END = BOARD_WIDTH - CONTENT_HORIZONTAL_MARGIN;
 
 void play_menu_loop(WinManager *win_manager);
+void recover_game_menu(WinManager *win_manager);
+void report_save_failure(WinManager *win_manager);
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdbool.h>
+
+// Line protocol, one command per line, replies start with OK or ERR:
+//   NEW [solo]        create a game, solo seats the session on both sides
+//   JOIN <id>         take the free seat of a game
+//   STATE             OK state <w|r> roll <v1> <v2> out <w> <r> bar <w> <r>
+//   BOARD             board as text, terminated by a line with a single "."
+//   MOVE <from> <by>  move a checker, points are numbered 1-24 like in the UI
+//   ENTER <by>        enter a checker from the bar
+//   LEAVE             leave the current game
+//   PING              OK pong
+// Both seats also get unprompted TURN <w|r> <v1> <v2> and OVER <w|r> <points>
+// lines, points are 2 for a gammon and 3 for a backgammon. OVER - 0 ends a
+// game after SERVER_MAX_PASSES turns in a row without a move, like two closed
+// boards with a checker on each bar.
+
+#define SERVER_DEFAULT_PORT 4747
+#define SERVER_BACKLOG 512
+#define SERVER_MAX_EVENTS 256
+#define SERVER_LINE_LEN 256
+#define SERVER_REPLY_LEN 128
+#define SERVER_MAX_PASSES 100
+
+int run_server(const char *address);
@@ -0,0 +1,7 @@
+#pragma once
+
+#define MAX_STATS_THREADS 64
+#define DIE_FACES 6
+#define STATS_JSON_FLAG "--json"
+
+int run_game_stats(int argc, char **argv);
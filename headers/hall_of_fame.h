@@ -7,4 +7,6 @@ typedef struct {
 
 typedef struct {
   Vec vec;
+  // the entries and their names, freed together
+  Arena arena;
 } HallOfFame;
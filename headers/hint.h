@@ -0,0 +1,26 @@
+#pragma once
+#include "window_manager.h"
+
+// typed at the prompts for a move, shows the analysis of the turn
+#define HINT_INPUT "h"
+// the hint scores every play statically, then the best HINT_CANDIDATES of
+// them up to HINT_PLIES deep, showing MAX_HINT_PLAYS
+#define HINT_PLIES 1
+#define HINT_CANDIDATES 8
+#define MAX_HINT_PLAYS 3
+// search depth of the computer's plays and cube decisions
+#define COMPUTER_PLIES 1
+#define MAX_PLAY_TEXT_LEN 40
+
+// the background analysis in src/hint.c needs the engine, which needs the
+// game, so the game only sees these
+typedef struct GameManager GameManager;
+
+void analyse_position(GameManager *game_manager);
+void stop_analysis();
+void free_analyst();
+void show_hints(WinManager *win_manager);
+void computer_turn(WinManager *win_manager, GameManager *game_manager,
+                   char *play_text);
+bool computer_doubles(GameManager *game_manager);
+bool computer_takes(GameManager *game_manager);
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Database file: HYPER_MAGIC, checkers per side, number of side placements,
+// value iterations, then one int16 cubeless equity per state in units of
+// 1 / HYPER_EQUITY_SCALE. State (me, opp) with me on roll is at
+// me * side count + opp.
+#define HYPER_MAGIC "BGHYPR1"
+#define HYPER_MAGIC_LEN 8
+#define HYPER_FILE ".hypergammon.bin"
+#define HYPER_EQUITY_SCALE 10000.0f
+
+// a side's checkers are placed on slots from its own point of view:
+// 0 is borne off, 1-24 the points and 25 the bar
+#define HYPER_SLOTS 26
+#define HYPER_BAR 25
+#define HYPER_HOME_POINTS 6
+#define MAX_HYPER_CHECKERS 3
+// distinct positions one roll can lead to, plenty for 3 checkers
+#define MAX_HYPER_PLAYS 256
+
+#define HYPER_TOLERANCE 1e-5f
+#define MAX_HYPER_ITERATIONS 2000
+#define MAX_HYPER_THREADS 64
+
+int run_hyper_solver(int checkers, const char *filename, int threads);
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdbool.h>
+#include <stdio.h>
+
+// Journal of the game being played in the UI: a snapshot in the save file
+// format after a JOURNAL_HEADER line, then one line per turn, move or cube
+// change. A clean exit removes it, a crash leaves it for recovery.
+#define JOURNAL_FILE ".game_journal.txt"
+#define JOURNAL_HEADER "JOURNAL"
+// every record reaches the OS right away, fsync runs at most this often
+#define JOURNAL_SYNC_MS 500
+#define MAX_JOURNAL_PATH 256
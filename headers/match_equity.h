@@ -0,0 +1,14 @@
+#pragma once
+#include <stdbool.h>
+
+#define MAX_MATCH_LENGTH 25
+// share of games that end in a gammon, used to build the table
+#define MET_GAMMON_RATE 0.26f
+#define MET_FILE ".match_equity.bin"
+#define MET_HEADER "BGMET1"
+#define MET_HEADER_LEN 6
+
+void init_match_equity();
+float match_equity(int away, int opp_away, bool crawford_pending);
+bool save_match_equity(const char *filename);
+bool load_match_equity(const char *filename);
@@ -0,0 +1,16 @@
+#pragma once
+
+#define IMPORT_LINE_LEN 1024
+#define IMPORT_PATH_LEN 512
+#define IMPORT_TOKEN_LEN 64
+#define IMPORT_SAVE_SUFFIX ".save"
+#define MAX_IMPORT_THREADS 64
+// points in the files are counted from the mover's side, 25 is the bar
+#define IMPORT_BAR_POINT 25
+#define IMPORT_OFF_POINT 0
+#define SGF_BAR_CHAR 'y'
+#define SGF_OFF_CHAR 'z'
+#define SGF_PROP_LEN 16
+#define SGF_VALUE_LEN 256
+
+int run_importer(int argc, char **argv);
@@ -0,0 +1,6 @@
+#pragma once
+
+#define PLAY_SET_MIN_CAP 64
+// the 21 distinct rolls, see all_rolls
+#define ROLL_COUNT 21
+#define ROLL_OUTCOMES 36
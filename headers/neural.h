@@ -0,0 +1,18 @@
+#pragma once
+#include "eval.h"
+#include <stdbool.h>
+
+// per point and side: one unit for 1, 2 and 3 checkers and one for the rest,
+// then bar and borne off checkers of both sides and two units for the turn
+#define NET_POINT_UNITS 4
+#define NET_INPUTS (BOARD_SIZE * NET_POINT_UNITS * 2 + 6)
+#define NET_HIDDEN 40
+// win, win gammon, win backgammon, lose gammon, lose backgammon of White
+#define NET_OUTPUTS 5
+#define NET_INIT_RANGE 0.1f
+
+#define NETWORK_FILE ".network.bin"
+// optional network used for races only
+#define RACE_NETWORK_FILE ".race_network.bin"
+#define NETWORK_HEADER "BGNET1"
+#define NETWORK_HEADER_LEN 6
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+
+// Book file: BOOK_MAGIC, entry count, entry size, then the entries sorted by
+// hash and dice. Only White to move is stored, Red's positions are looked
+// up mirrored.
+#define BOOK_MAGIC "BGBOOK1"
+#define BOOK_MAGIC_LEN 8
+#define BOOK_FILE ".opening_book.bin"
+#define BOOK_ENTRY_SIZE 32
+
+// rollout trials and rollout candidates per book position when generating
+#define DEFAULT_BOOK_TRIALS 144
+#define DEFAULT_BOOK_CANDIDATES 3
+#define MAX_BOOK_CANDIDATES 16
+// no time limit on the book rollouts, only the trial count
+#define BOOK_ROLLOUT_TIME_MS (24 * 3600 * 1000)
+
+int run_book_builder(const char *filename, int trials, int candidates);
@@ -0,0 +1,15 @@
+#pragma once
+
+// plies counted by ./perft, every ply is a roll followed by a play
+#define MAX_PERFT_DEPTH 8
+#define MAX_PERFT_THREADS 64
+// mismatching positions printed by the reference check before it goes quiet
+#define MAX_PERFT_REPORTS 10
+
+#define PERFT_THREADS_FLAG "--threads"
+#define PERFT_RULES_FLAG "--rules"
+#define PERFT_VARIANT_FLAG "--variant"
+#define PERFT_POSITION_FLAG "--position"
+#define PERFT_CHECK_FLAG "--check"
+
+int run_perft(int argc, char **argv);
@@ -0,0 +1,13 @@
+#pragma once
+#include <stdbool.h>
+
+// every side takes at most 15 ones and 25 zeros, see position_key
+#define POSITION_KEY_LEN 10
+// base64 of the key, one spare bit of the last char holds the side to move
+#define POSITION_ID_LEN 14
+#define POSITION_SLOT_COUNT 25
+#define BASE64_BITS 6
+
+typedef struct {
+  unsigned char bytes[POSITION_KEY_LEN];
+} PositionKey;
@@ -0,0 +1,28 @@
+#pragma once
+
+// Index file: INDEX_MAGIC, entry count, entry size, game count and names
+// length, then the entries sorted by hash, game, turn and move, then the
+// columns of the pattern queries in the same order, then the NUL
+// terminated names of the save files the game ids refer to.
+#define INDEX_MAGIC "BGINDEX1"
+#define INDEX_MAGIC_LEN 8
+#define INDEX_FILE ".position_index.bin"
+#define INDEX_ENTRY_SIZE 32
+#define MAX_INDEX_THREADS 64
+// turns past it aren't indexed, the entries keep the turn in 16 bits
+#define MAX_INDEX_TURNS 65535
+#define INDEX_FIND_FLAG "--find"
+#define INDEX_PATTERN_FLAG "--pattern"
+
+// Pattern columns: point masks of the side to move and of its opponent,
+// each in its own numbering with bit 0 its 1-point, of the points it holds
+// and the points it made, then both bar counts
+#define PATTERN_MASK_COLUMNS 4
+#define PATTERN_BAR_COLUMNS 2
+#define PATTERN_COLUMNS_SIZE (PATTERN_MASK_COLUMNS * 4 + PATTERN_BAR_COLUMNS)
+// positions tested at once, their masks stay in the L1 cache
+#define PATTERN_BLOCK 1024
+#define MAX_PATTERN_PRINTS 20
+#define OPPONENT_PATTERN_PREFIX "opp:"
+
+int run_position_index(int argc, char **argv);
@@ -0,0 +1,20 @@
+#pragma once
+
+// Stream layout, all numbers little endian as written by the host:
+//   header   POSITION_STREAM_MAGIC, record size, records per chunk
+//   chunks   record count, packed length, packed records
+//   index    offset and record count of every chunk
+//   trailer  index offset, chunk count, POSITION_INDEX_MAGIC
+// Records in a chunk are XOR-ed with the record before them and runs of
+// zero bytes are stored as a zero followed by the run length, so every
+// chunk can be read on its own through the index.
+#define POSITION_STREAM_MAGIC "BGPOS1"
+#define POSITION_INDEX_MAGIC "BGIDX1"
+#define POSITION_MAGIC_LEN 6
+#define POSITION_RECORD_SIZE 16
+#define RECORDS_PER_CHUNK 4096
+#define CHUNK_BUF_SIZE (RECORDS_PER_CHUNK * POSITION_RECORD_SIZE * 2)
+#define MAX_ZERO_RUN 255
+// written by White's view, 0 while the game isn't finished
+#define NO_RESULT 0
+#define MAX_RECORD_TURN 255
@@ -0,0 +1,7 @@
+#pragma once
+
+// xorshift64*, every thread and every rollout owns its own state so results
+// are reproducible and don't go through the global rand()
+typedef struct {
+  unsigned long long state;
+} Rng;
@@ -0,0 +1,16 @@
+#pragma once
+
+// games ./server --check plays side by side against a server it starts on
+// a unix socket of its own
+#define DEFAULT_SERVER_CHECK_GAMES 8
+#define MAX_SERVER_CHECK_GAMES 256
+// a checked game still going after this many turns counts as stuck
+#define SERVER_CHECK_MAX_TURNS 2000
+// tries and pause in microseconds while the server comes up
+#define SERVER_CHECK_CONNECT_TRIES 200
+#define SERVER_CHECK_CONNECT_WAIT_US 10000
+
+#define SERVER_CHECK_FLAG "--check"
+#define SERVER_CHECK_SOCKET "/tmp/backgammon_check_%d.sock"
+
+int check_server(int games);
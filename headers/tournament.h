@@ -0,0 +1,26 @@
+#pragma once
+
+#define MAX_TOURNAMENT_PLAYERS 16
+#define MAX_TOURNAMENT_THREADS 64
+#define MAX_PLAYER_SPEC_LEN 256
+#define MAX_PLAYER_NAME 32
+// a game still going after this many turns counts half for both
+#define MAX_TOURNAMENT_TURNS 1000
+// pairs of games per matchup when the SPRT doesn't stop it before
+#define DEFAULT_TOURNAMENT_PAIRS 5000
+// SPRT of elo0 against elo1 for the first player of a matchup
+#define DEFAULT_SPRT_ELO0 0.0
+#define DEFAULT_SPRT_ELO1 20.0
+#define DEFAULT_SPRT_ALPHA 0.05
+#define DEFAULT_SPRT_BETA 0.05
+// pairs played before the first test, the variance needs a few
+#define MIN_SPRT_PAIRS 16
+
+#define TOURNAMENT_PLAYER_FLAG "--player"
+#define TOURNAMENT_GAUNTLET_FLAG "--gauntlet"
+#define TOURNAMENT_PAIRS_FLAG "--pairs"
+#define TOURNAMENT_THREADS_FLAG "--threads"
+#define TOURNAMENT_SEED_FLAG "--seed"
+#define TOURNAMENT_SPRT_FLAG "--sprt"
+
+int run_tournament(int argc, char **argv);
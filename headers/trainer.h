@@ -0,0 +1,14 @@
+#pragma once
+
+#define TD_ALPHA 0.1f
+#define TD_LAMBDA 0.7f
+#define MAX_TRAIN_THREADS 64
+// gradient buffers in flight per worker
+#define TRAIN_BUFFERS_PER_WORKER 2
+#define MAX_TRAIN_TURNS 1000
+#define TRAIN_IDLE_US 1000
+#define TRAIN_REPORT_SECS 10
+#define TRAIN_CHECKPOINT_SECS 300
+#define CHECKPOINT_TMP_SUFFIX ".tmp"
+
+int run_trainer(const char *weights_file, long long max_games, int threads);
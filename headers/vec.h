@@ -1,5 +1,6 @@
 #pragma once
 
+#include "arena.h"
 #include <stdlib.h>
 
 #define DEFAULT_CAP 8
@@ -10,9 +11,13 @@ typedef struct {
   void *data;
   size_t elem_size;
   int len, cap;
+  // where the data lives, NULL for the heap
+  Arena *arena;
 } Vec;
 
+void vec_in_arena(Vec *vec_out, size_t elem_size, int cap, Arena *arena);
 void vec_with_cap(Vec *vec_out, size_t elem_size, int cap);
 void vec_new(Vec *vec_out, size_t elem_size);
 int vec_extend(Vec *vec);
+int vec_shrink(Vec *vec);
 void vec_free(Vec *vec);
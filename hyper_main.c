@@ -0,0 +1,9 @@
+#include "src/window_manager.c"
+#include "src/hypergammon.c"
+
+// usage: ./hyper [checkers] [file] [threads]
+int main(int argc, char **argv) {
+  return run_hyper_solver(argc > 1 ? atoi(argv[1]) : 0,
+                          argc > 2 ? argv[2] : HYPER_FILE,
+                          argc > 3 ? atoi(argv[3]) : 1);
+}
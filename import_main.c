@@ -0,0 +1,4 @@
+#include "src/window_manager.c"
+#include "src/match_import.c"
+
+int main(int argc, char **argv) { return run_importer(argc, argv); }
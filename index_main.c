@@ -0,0 +1,4 @@
+#include "src/window_manager.c"
+#include "src/position_index.c"
+
+int main(int argc, char **argv) { return run_position_index(argc, argv); }
@@ -0,0 +1,4 @@
+#include "src/window_manager.c"
+#include "src/perft.c"
+
+int main(int argc, char **argv) { return run_perft(argc, argv); }
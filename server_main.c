@@ -0,0 +1,12 @@
+#include "src/window_manager.c"
+#include "src/server_check.c"
+
+// usage: ./server [port | host:port | unix:path]
+//        ./server --check [games]
+int main(int argc, char **argv) {
+  init_rng();
+  if (argc > 1 && strcmp(argv[1], SERVER_CHECK_FLAG) == 0)
+    return check_server(argc > 2 ? atoi(argv[2])
+                                 : DEFAULT_SERVER_CHECK_GAMES);
+  return run_server(argc > 1 ? argv[1] : NULL);
+}
@@ -0,0 +1,4 @@
+#include "src/window_manager.c"
+#include "src/batch_sim.c"
+
+int main(int argc, char **argv) { return run_sim(argc, argv); }
@@ -0,0 +1,135 @@
+#pragma once
+#include "../headers/arena.h"
+#include "../headers/vec.h"
+#include <stdint.h>
+#include <string.h>
+
+// A bump allocator over a chain of blocks. Nothing is freed on its own:
+// arena_release goes back to a mark and arena_reset to the start, both
+// O(1), and the blocks are kept for the next round.
+struct ArenaBlock {
+  ArenaBlock *next;
+  size_t size, used;
+  _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+typedef struct {
+  ArenaBlock *block;
+  size_t used;
+} ArenaMark;
+
+size_t arena_align(size_t size) {
+  return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+ArenaBlock *new_arena_block(size_t size) {
+  size_t block_size = ARENA_BLOCK_SIZE;
+  while (block_size < size)
+    block_size *= 2;
+  ArenaBlock *block = malloc(sizeof(ArenaBlock) + block_size);
+  if (block == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  *block = (ArenaBlock){NULL, block_size, 0};
+  return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  size = arena_align(size);
+  ArenaBlock *block = arena->current;
+  if (block == NULL) {
+    block = new_arena_block(size);
+    arena->first = block;
+  } else if (block->used + size > block->size) {
+    // the blocks after the current one are free, the ones too small for
+    // the request are dropped so the chain doesn't grow round after round
+    while (block->next != NULL && block->next->size < size) {
+      ArenaBlock *small = block->next;
+      block->next = small->next;
+      free(small);
+    }
+    if (block->next == NULL)
+      block->next = new_arena_block(size);
+    block = block->next;
+    block->used = 0;
+  }
+
+  arena->current = block;
+  void *ptr = block->data + block->used;
+  block->used += size;
+  arena->last = ptr;
+  return ptr;
+}
+
+// extends the newest allocation in place when its block has room
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t size) {
+  ArenaBlock *block = arena->current;
+  if (ptr != NULL && ptr == arena->last) {
+    size_t start = (unsigned char *)ptr - block->data;
+    if (start + arena_align(size) <= block->size) {
+      block->used = start + arena_align(size);
+      return ptr;
+    }
+  }
+  void *grown = arena_alloc(arena, size);
+  if (ptr != NULL)
+    memcpy(grown, ptr, old_size < size ? old_size : size);
+  return grown;
+}
+
+ArenaMark arena_mark(Arena *arena) {
+  return (ArenaMark){arena->current,
+                     arena->current != NULL ? arena->current->used : 0};
+}
+
+// frees everything allocated since the mark
+void arena_release(Arena *arena, ArenaMark mark) {
+  if (mark.block == NULL) {
+    arena_reset(arena);
+    return;
+  }
+  arena->current = mark.block;
+  arena->current->used = mark.used;
+  arena->last = NULL;
+}
+
+void arena_reset(Arena *arena) {
+  arena->current = arena->first;
+  if (arena->first != NULL)
+    arena->first->used = 0;
+  arena->last = NULL;
+}
+
+void free_arena(Arena *arena) {
+  ArenaBlock *block = arena->first;
+  while (block != NULL) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  *arena = (Arena){NULL, NULL, NULL};
+}
+
+// the calling thread's arena for short lived search structures, take a
+// mark before using it and release it after. Threads that search free it
+// before they exit.
+Arena *scratch_arena() {
+  static _Thread_local Arena scratch;
+  return &scratch;
+}
+
+void *pool_alloc(Arena *arena, size_t size) {
+  if (arena != NULL)
+    return arena_alloc(arena, size);
+  return malloc(size);
+}
+
+void *pool_realloc(Arena *arena, void *ptr, size_t old_size, size_t size) {
+  if (arena != NULL)
+    return arena_grow(arena, ptr, old_size, size);
+  return realloc(ptr, size);
+}
+
+void pool_free(Arena *arena, void *ptr) {
+  if (arena == NULL)
+    free(ptr);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "../headers/atomic_queue.h"
+#include "game.c"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Bounded multi-producer multi-consumer queue of pointers without locks.
+// Every cell has a sequence number telling whose turn it is: a producer may
+// fill it when it equals the position, a consumer may take it when it
+// equals the position + 1.
+typedef struct {
+  atomic_size_t sequence;
+  void *data;
+} QueueCell;
+
+typedef struct {
+  QueueCell *cells;
+  size_t mask;
+  _Alignas(CACHE_LINE_SIZE) atomic_size_t push_pos;
+  _Alignas(CACHE_LINE_SIZE) atomic_size_t pop_pos;
+} AtomicQueue;
+
+void new_atomic_queue(AtomicQueue *queue, size_t cap) {
+  size_t size = ATOMIC_QUEUE_MIN_CAP;
+  while (size < cap)
+    size *= 2;
+  queue->cells = malloc(size * sizeof(QueueCell));
+  if (queue->cells == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  for (size_t i = 0; i < size; i++)
+    atomic_init(&queue->cells[i].sequence, i);
+  queue->mask = size - 1;
+  atomic_init(&queue->push_pos, 0);
+  atomic_init(&queue->pop_pos, 0);
+}
+
+void free_atomic_queue(AtomicQueue *queue) {
+  free(queue->cells);
+  queue->cells = NULL;
+}
+
+// returns false when the queue is full
+bool atomic_queue_push(AtomicQueue *queue, void *data) {
+  size_t pos = atomic_load_explicit(&queue->push_pos, memory_order_relaxed);
+  while (true) {
+    QueueCell *cell = &queue->cells[pos & queue->mask];
+    size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    long diff = (long)(seq - pos);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->push_pos, &pos,
+                                                pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        cell->data = data;
+        atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&queue->push_pos, memory_order_relaxed);
+    }
+  }
+}
+
+// returns false when the queue is empty
+bool atomic_queue_pop(AtomicQueue *queue, void **data) {
+  size_t pos = atomic_load_explicit(&queue->pop_pos, memory_order_relaxed);
+  while (true) {
+    QueueCell *cell = &queue->cells[pos & queue->mask];
+    size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    long diff = (long)(seq - (pos + 1));
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->pop_pos, &pos,
+                                                pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        *data = cell->data;
+        atomic_store_explicit(&cell->sequence, pos + queue->mask + 1,
+                              memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&queue->pop_pos, memory_order_relaxed);
+    }
+  }
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "../headers/autosave.h"
+#include "atomic_queue.c"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Saves are serialized in memory by the caller and written by a background
+// thread, so the input loop never waits on the file system. Slots go round
+// through two queues like the trainer's buffers: pending ones to the
+// writer, written ones back. Every file is written to a temporary file and
+// renamed over the old one, so it's either the old or the new save.
+typedef struct {
+  char filename[MAX_SAVE_PATH];
+  char *data;
+  size_t len;
+} SaveSlot;
+
+typedef struct {
+  SaveSlot slots[AUTOSAVE_SLOTS];
+  AtomicQueue pending, free_slots;
+  // one post per pending slot, one more to stop
+  sem_t ready;
+  pthread_t writer;
+  bool running;
+  // set by the writer when a save failed, failed_name is the file
+  atomic_bool failed;
+  char failed_name[MAX_SAVE_PATH];
+} Autosave;
+
+bool write_save_slot(SaveSlot *slot) {
+  char tmp[MAX_SAVE_PATH + 4];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", slot->filename);
+  FILE *fp = fopen(tmp, "w");
+  if (fp == NULL)
+    return false;
+  bool ok = fwrite(slot->data, 1, slot->len, fp) == slot->len &&
+            fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+  ok = fclose(fp) == 0 && ok;
+  ok = ok && rename(tmp, slot->filename) == 0;
+  if (!ok)
+    unlink(tmp);
+  return ok;
+}
+
+void *autosave_writer(void *arg) {
+  Autosave *autosave = arg;
+  while (true) {
+    sem_wait(&autosave->ready);
+    void *data;
+    if (!atomic_queue_pop(&autosave->pending, &data))
+      break;
+    SaveSlot *slot = data;
+    if (!write_save_slot(slot)) {
+      memcpy(autosave->failed_name, slot->filename, MAX_SAVE_PATH);
+      atomic_store(&autosave->failed, true);
+    }
+    atomic_queue_push(&autosave->free_slots, slot);
+  }
+  return NULL;
+}
+
+bool start_autosave(Autosave *autosave) {
+  memset(autosave, 0, sizeof(*autosave));
+  new_atomic_queue(&autosave->pending, AUTOSAVE_SLOTS);
+  new_atomic_queue(&autosave->free_slots, AUTOSAVE_SLOTS);
+  for (int i = 0; i < AUTOSAVE_SLOTS; i++)
+    atomic_queue_push(&autosave->free_slots, &autosave->slots[i]);
+  atomic_init(&autosave->failed, false);
+  sem_init(&autosave->ready, 0, 0);
+  autosave->running = pthread_create(&autosave->writer, NULL,
+                                     autosave_writer, autosave) == 0;
+  if (!autosave->running) {
+    sem_destroy(&autosave->ready);
+    free_atomic_queue(&autosave->pending);
+    free_atomic_queue(&autosave->free_slots);
+  }
+  return autosave->running;
+}
+
+// a free slot, NULL when all are pending and wait is false
+SaveSlot *take_save_slot(Autosave *autosave, bool wait) {
+  void *data;
+  while (!atomic_queue_pop(&autosave->free_slots, &data)) {
+    if (!wait)
+      return NULL;
+    usleep(AUTOSAVE_WAIT_US);
+  }
+  return data;
+}
+
+// gives back a slot taken but not used
+void submit_free_slot(Autosave *autosave, SaveSlot *slot) {
+  atomic_queue_push(&autosave->free_slots, slot);
+}
+
+// hands the slot's data, which it now owns, to the writer
+void submit_save_slot(Autosave *autosave, SaveSlot *slot) {
+  atomic_queue_push(&autosave->pending, slot);
+  sem_post(&autosave->ready);
+}
+
+// the file of a save that failed since the last call, if any
+bool take_save_failure(Autosave *autosave, char *filename) {
+  if (!autosave->running || !atomic_exchange(&autosave->failed, false))
+    return false;
+  memcpy(filename, autosave->failed_name, MAX_SAVE_PATH);
+  return true;
+}
+
+// writes what is still pending and stops the writer
+void stop_autosave(Autosave *autosave) {
+  if (!autosave->running)
+    return;
+  sem_post(&autosave->ready);
+  pthread_join(autosave->writer, NULL);
+  sem_destroy(&autosave->ready);
+  for (int i = 0; i < AUTOSAVE_SLOTS; i++)
+    free(autosave->slots[i].data);
+  free_atomic_queue(&autosave->pending);
+  free_atomic_queue(&autosave->free_slots);
+  autosave->running = false;
+}
@@ -0,0 +1,389 @@
+#pragma once
+#include "../headers/batch_sim.h"
+#include "engine.c"
+#include <stdint.h>
+#include <string.h>
+
+// Plays SIM_LANES games in lockstep with a fixed policy: each die, the
+// larger first, moves the rearmost checker that can legally move by it,
+// entering from the bar first and bearing off under the standard rules. A
+// die nothing can move by is lost, so the policy doesn't look for the play
+// that uses the most dice.
+//
+// The boards are kept as a structure of arrays: one row of SIM_LANES bytes
+// per pip and side, every side counting pips from its own bear off, and
+// next to them a word per lane and side with a bit for every pip it holds
+// and one for every point it blocks. The rows and words of the side to move
+// and of its opponent swap every turn, so the same code plays both sides.
+// Finding the checker each lane moves and checking for the end of the game
+// run across all lanes at once, only making the moves goes lane by lane. A
+// finished lane starts the next game right away.
+
+// the start position as pips of the side on roll (0) and its opponent (1)
+typedef struct {
+  Board board;
+  CheckerKind on_roll;
+  int8_t pips[2][SIM_PIPS];
+  int checkers;
+} SimStart;
+
+typedef struct {
+  // checkers[side][pip][lane], mover is the side to move
+  int8_t checkers[2][SIM_PIPS][SIM_LANES];
+  // bit p of occupied[side][lane] is set when the side has checkers on its
+  // pip p, bit p of blocks[side][lane] when it holds the opponent's pip p
+  // with two or more
+  uint32_t occupied[2][SIM_LANES];
+  uint32_t blocks[2][SIM_LANES];
+  int mover;
+  int8_t active[SIM_LANES];
+  CheckerKind mover_kind[SIM_LANES];
+  int turns[SIM_LANES];
+  // index of the game each lane is playing
+  int game[SIM_LANES];
+  Rng rngs[SIM_LANES];
+} SimBatch;
+
+// turns is SIM_MAX_TURNS and winner None for a game that didn't finish
+typedef struct {
+  int lane;
+  int turns;
+  CheckerKind winner;
+  WinKind win_kind;
+} SimGame;
+
+typedef struct {
+  long long games, unfinished, turns;
+  // summed outcomes for the side on roll at the start
+  EvalOutput outcome;
+} SimTotals;
+
+// pip of an index of board_points for a side
+int sim_pip(CheckerKind side, int pos) {
+  return side == White ? BOARD_SIZE - pos : pos + 1;
+}
+
+void new_sim_start(SimStart *start, Board *board, CheckerKind on_roll) {
+  memset(start, 0, sizeof(*start));
+  start->board = *board;
+  start->on_roll = on_roll;
+  CheckerKind sides[] = {on_roll, opposite_checker(on_roll)};
+  for (int s = 0; s < 2; s++) {
+    int8_t *pips = start->pips[s];
+    for (int i = 0; i < BOARD_SIZE; i++) {
+      if (board->board_points[i].checker_kind == sides[s])
+        pips[sim_pip(sides[s], i)] = board->board_points[i].checker_count;
+    }
+    pips[SIM_BAR_PIP] = bar_count(board, sides[s]);
+    pips[0] = sides[s] == White ? board->white_out_count
+                                : board->red_out_count;
+  }
+  for (int p = 0; p < SIM_PIPS; p++)
+    start->checkers += start->pips[0][p];
+}
+
+void start_lane(SimBatch *batch, SimStart *start, int lane, int game) {
+  for (int s = 0; s < 2; s++) {
+    int side = s == 0 ? batch->mover : !batch->mover;
+    batch->occupied[side][lane] = batch->blocks[side][lane] = 0;
+    for (int p = 0; p < SIM_PIPS; p++) {
+      int8_t count = start->pips[s][p];
+      batch->checkers[side][p][lane] = count;
+      if (p > 0 && count > 0)
+        batch->occupied[side][lane] |= 1u << p;
+      if (p > 0 && p < SIM_BAR_PIP && count > 1)
+        batch->blocks[side][lane] |= 1u << (SIM_BAR_PIP - p);
+    }
+  }
+  batch->active[lane] = 1;
+  batch->mover_kind[lane] = start->on_roll;
+  batch->turns[lane] = 0;
+  batch->game[lane] = game;
+}
+
+// moves a checker of the side to move in a lane, to is 0 or less when it
+// bears off and a blot on the destination is hit. Whether a count crosses
+// one of the thresholds of the words is data the branch predictor can't
+// learn, so they're updated with masks instead.
+void sim_move(SimBatch *batch, int lane, int from, int to) {
+  int mover = batch->mover;
+  int8_t(*own)[SIM_LANES] = batch->checkers[mover];
+  int8_t(*opp)[SIM_LANES] = batch->checkers[!mover];
+  uint32_t *occupied = &batch->occupied[mover][lane];
+  uint32_t *blocks = &batch->blocks[mover][lane];
+  uint32_t *opp_occupied = &batch->occupied[!mover][lane];
+
+  // the bar's block bit would be bit 0, which no die reaches
+  int8_t left = --own[from][lane];
+  *occupied &= ~((uint32_t)(left == 0) << from);
+  *blocks &= ~((uint32_t)(left == 1) << (SIM_BAR_PIP - from));
+
+  bool on_board = to > 0;
+  int dest = on_board ? to : 0;
+  int8_t now = ++own[dest][lane];
+  *occupied |= (uint32_t)on_board << dest;
+  *blocks |= (uint32_t)(on_board & (now == 2)) << (SIM_BAR_PIP - dest);
+
+  int blot = SIM_BAR_PIP - dest;
+  bool hit = on_board & (opp[blot][lane] == 1);
+  opp[blot][lane] -= hit;
+  opp[SIM_BAR_PIP][lane] += hit;
+  *opp_occupied = (*opp_occupied & ~((uint32_t)hit << blot)) |
+                  (uint32_t)hit << SIM_BAR_PIP;
+}
+
+// one die per lane, 0 for none, and die_bit its 1 << die. The pips a lane
+// could move a checker from are found for all lanes at once from their
+// words: a checker on the bar has to enter first, others move unless the
+// opponent blocks their destination, and with all checkers home they bear
+// off exactly or with a larger die from the rearmost pip. The highest of
+// them is the rearmost. Shifts by the die are multiplications by die_bit,
+// as a shift by a different count in every lane doesn't vectorize.
+void sim_step(SimBatch *batch, const int8_t *die, const uint32_t *die_bit) {
+  uint32_t *occupied = batch->occupied[batch->mover];
+  uint32_t *blocks = batch->blocks[!batch->mover];
+  const uint32_t bar = 1u << SIM_BAR_PIP;
+  const uint32_t outside = ~0u << (SIM_HOME_PIPS + 1);
+
+  uint32_t sources[SIM_LANES];
+  for (int l = 0; l < SIM_LANES; l++) {
+    uint32_t bit = die_bit[l], held = occupied[l];
+    uint32_t moves = held & ~(blocks[l] * bit) & ~(bit * 2 - 1);
+    uint32_t off = (held & bit) | (held & -(uint32_t)(held < bit));
+    uint32_t on_bar = -(uint32_t)((held & bar) != 0);
+    uint32_t home = -(uint32_t)((held & outside) == 0);
+    sources[l] = (moves & (bar | ~on_bar)) | (off & home);
+  }
+
+  for (int l = 0; l < SIM_LANES; l++) {
+    if (sources[l] == 0)
+      continue;
+    int from = 31 - __builtin_clz(sources[l]);
+    sim_move(batch, l, from, from - die[l]);
+  }
+}
+
+// rolls for every active lane and plays the dice, a doublet four times
+void sim_turn(SimBatch *batch) {
+  int8_t dice[MAX_DOUBLET_USES][SIM_LANES];
+  uint32_t dice_bits[MAX_DOUBLET_USES][SIM_LANES];
+  memset(dice, 0, sizeof(dice));
+  memset(dice_bits, 0, sizeof(dice_bits));
+  bool doublets = false;
+  for (int l = 0; l < SIM_LANES; l++) {
+    if (!batch->active[l])
+      continue;
+    DiceRoll roll = rng_dice_roll(&batch->rngs[l]);
+    dice[0][l] = roll.v1 > roll.v2 ? roll.v1 : roll.v2;
+    dice[1][l] = roll.v1 > roll.v2 ? roll.v2 : roll.v1;
+    if (roll.v1 == roll.v2) {
+      dice[2][l] = dice[3][l] = roll.v1;
+      doublets = true;
+    }
+    for (int i = 0; i < MAX_DOUBLET_USES; i++)
+      dice_bits[i][l] = dice[i][l] > 0 ? 1u << dice[i][l] : 0;
+  }
+  for (int i = 0; i < (doublets ? MAX_DOUBLET_USES : 2); i++)
+    sim_step(batch, dice[i], dice_bits[i]);
+}
+
+// loser's checkers on its pips 19-25 are on the bar or in the winner's home
+WinKind sim_win_kind(int8_t (*loser)[SIM_LANES], int lane) {
+  if (loser[0][lane] > 0)
+    return SingleWin;
+  for (int p = SIM_BAR_PIP - SIM_HOME_PIPS; p <= SIM_BAR_PIP; p++) {
+    if (loser[p][lane] > 0)
+      return BackgammonWin;
+  }
+  return GammonWin;
+}
+
+void record_game(SimTotals *totals, SimGame *records, SimStart *start,
+                 SimBatch *batch, int lane, SimGame game) {
+  totals->games++;
+  totals->turns += game.turns;
+  if (game.winner == None)
+    totals->unfinished++;
+  else
+    add_outcome(&totals->outcome, game.winner == start->on_roll,
+                game.win_kind);
+  if (records != NULL)
+    records[batch->game[lane]] = game;
+}
+
+// plays games from start, lane l rolling with its own generator seeded from
+// seed and l, records[i] is filled with game i when records isn't NULL
+void sim_games(SimStart *start, int games, unsigned long long seed,
+               SimGame *records, SimTotals *totals) {
+  static SimBatch batch;
+  memset(&batch, 0, sizeof(batch));
+  memset(totals, 0, sizeof(*totals));
+  int started = 0, done = 0;
+  for (int l = 0; l < SIM_LANES; l++) {
+    batch.rngs[l] = new_rng(seed ^ (l + 1) * RNG_MULTIPLIER);
+    if (started < games)
+      start_lane(&batch, start, l, started++);
+  }
+
+  while (done < games) {
+    sim_turn(&batch);
+
+    int8_t(*own)[SIM_LANES] = batch.checkers[batch.mover];
+    int8_t(*opp)[SIM_LANES] = batch.checkers[!batch.mover];
+    int8_t over[SIM_LANES];
+    for (int l = 0; l < SIM_LANES; l++)
+      over[l] = batch.active[l] & (own[0][l] == start->checkers);
+
+    batch.mover = !batch.mover;
+    for (int l = 0; l < SIM_LANES; l++) {
+      if (!batch.active[l])
+        continue;
+      batch.turns[l]++;
+      if (!over[l] && batch.turns[l] < SIM_MAX_TURNS) {
+        batch.mover_kind[l] = opposite_checker(batch.mover_kind[l]);
+        continue;
+      }
+      SimGame game = {l, batch.turns[l], None, NoWin};
+      if (over[l])
+        game = (SimGame){l, batch.turns[l], batch.mover_kind[l],
+                         sim_win_kind(opp, l)};
+      record_game(totals, records, start, &batch, l, game);
+      done++;
+      batch.active[l] = 0;
+      if (started < games)
+        start_lane(&batch, start, l, started++);
+    }
+  }
+}
+
+// the policy of sim_step played on a GameManager through the rules of
+// game.c, one game at a time
+SimGame reference_game(SimStart *start, Rng *rng) {
+  GameManager state =
+      position_state(&start->board, start->on_roll, rng_dice_roll(rng));
+  for (int turn = 1; turn <= SIM_MAX_TURNS; turn++) {
+    DiceRoll *roll = &state.dice_roll;
+    int high = roll->v1 > roll->v2 ? roll->v1 : roll->v2;
+    int low = roll->v1 > roll->v2 ? roll->v2 : roll->v1;
+    int dice[MAX_DOUBLET_USES] = {high, low, high, high};
+    CheckerKind player = state.curr_player;
+    for (int i = 0; i < (high == low ? MAX_DOUBLET_USES : 2); i++) {
+      // rearmost first, the bar before any point while it has checkers
+      int first = bar_count(&state.board, player) > 0 ? -1 : 0;
+      for (int step = first; step < BOARD_SIZE; step++) {
+        int from = step < 0                ? PLAYER_BAR_POS(player)
+                   : player == White       ? step
+                                           : BOARD_SIZE - 1 - step;
+        if (!is_step_legal_standard(&state, from, dice[i]))
+          continue;
+        move_checker_check_hit(&state, from, dice[i]);
+        use_roll_val(roll, dice[i]);
+        break;
+      }
+    }
+
+    WinKind win_kind;
+    CheckerKind won = check_game_over(&state, &win_kind);
+    if (won != None)
+      return (SimGame){0, turn, won, win_kind};
+    state.curr_player = opposite_checker(player);
+    state.dice_roll = rng_dice_roll(rng);
+  }
+  return (SimGame){0, SIM_MAX_TURNS, None, NoWin};
+}
+
+// replays every game of the batch through reference_game with its lane's
+// dice, the games of a lane come in the order it played them
+bool check_sim_games(SimStart *start, int games, unsigned long long seed,
+                     SimGame *records) {
+  Rng rngs[SIM_LANES];
+  for (int l = 0; l < SIM_LANES; l++)
+    rngs[l] = new_rng(seed ^ (l + 1) * RNG_MULTIPLIER);
+
+  double begin = monotonic_seconds();
+  int mismatches = 0;
+  for (int i = 0; i < games; i++) {
+    SimGame *game = &records[i];
+    SimGame expected = reference_game(start, &rngs[game->lane]);
+    if (expected.turns == game->turns && expected.winner == game->winner &&
+        expected.win_kind == game->win_kind)
+      continue;
+    if (mismatches++ < MAX_SIM_REPORTS)
+      printf("game %d lane %d: batch %d turns winner %d kind %d, "
+             "reference %d turns winner %d kind %d\n",
+             i, game->lane, game->turns, game->winner, game->win_kind,
+             expected.turns, expected.winner, expected.win_kind);
+  }
+  double secs = monotonic_seconds() - begin;
+  printf("scalar: %d games %.3fs %.0f games/s\n", games, secs,
+         secs > 0 ? games / secs : 0);
+  printf("check: %d of %d games differ\n", mismatches, games);
+  return mismatches == 0;
+}
+
+int run_sim(int argc, char **argv) {
+  int games = DEFAULT_SIM_GAMES;
+  unsigned long long seed = 1;
+  Variant variant = Backgammon;
+  const char *id = NULL;
+  bool check = false;
+  bool args_ok = true;
+  for (int i = 1; i < argc && args_ok; i++) {
+    bool has_val = i + 1 < argc;
+    if (strcmp(argv[i], SIM_CHECK_FLAG) == 0)
+      check = true;
+    else if (strcmp(argv[i], SIM_GAMES_FLAG) == 0 && has_val)
+      args_ok = (games = atoi(argv[++i])) > 0;
+    else if (strcmp(argv[i], SIM_SEED_FLAG) == 0 && has_val)
+      seed = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], SIM_VARIANT_FLAG) == 0 && has_val)
+      args_ok = variant_from_name(argv[++i], &variant);
+    else if (strcmp(argv[i], SIM_POSITION_FLAG) == 0 && has_val)
+      id = argv[++i];
+    else
+      args_ok = false;
+  }
+  if (!args_ok) {
+    fprintf(stderr,
+            "usage: %s [%s <n>] [%s <n>] [%s <name>] [%s <position id>] "
+            "[%s]\n",
+            argv[0], SIM_GAMES_FLAG, SIM_SEED_FLAG, SIM_VARIANT_FLAG,
+            SIM_POSITION_FLAG, SIM_CHECK_FLAG);
+    return 1;
+  }
+
+  Board board = variant_board(variant);
+  CheckerKind on_roll = White;
+  if (id != NULL && !position_from_id(id, variant_checker_count(variant),
+                                      &board, &on_roll)) {
+    fprintf(stderr, "bad position id %s\n", id);
+    return 1;
+  }
+  SimStart start;
+  new_sim_start(&start, &board, on_roll);
+
+  SimGame *records = NULL;
+  if (check) {
+    records = malloc(games * sizeof(SimGame));
+    if (records == NULL)
+      exit(NO_HEAP_MEM_EXIT);
+  }
+  SimTotals totals;
+  double begin = monotonic_seconds();
+  sim_games(&start, games, seed, records, &totals);
+  double secs = monotonic_seconds() - begin;
+  printf("batch: %d games %.3fs %.0f games/s\n", games, secs,
+         secs > 0 ? games / secs : 0);
+
+  long long finished = totals.games - totals.unfinished;
+  EvalOutput eval = {0, 0, 0, 0, 0};
+  if (finished > 0)
+    add_weighted_eval(&eval, &totals.outcome, 1.0f / finished);
+  write_eval(stdout, "outcome", &eval);
+  printf("turns %.2f unfinished %lld\n", (double)totals.turns / totals.games,
+         totals.unfinished);
+
+  bool ok = !check || check_sim_games(&start, games, seed, records);
+  free(records);
+  return ok ? 0 : 1;
+}
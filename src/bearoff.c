@@ -0,0 +1,148 @@
+#pragma once
+#include "../headers/bearoff.h"
+#include "game.c"
+#include <pthread.h>
+#include <stdlib.h>
+
+// One-sided bear-off database: for every home board, the distribution of
+// the number of rolls needed to bear everything off when each roll is
+// played to minimise the expected number.
+typedef struct {
+  float rolls[BEAROFF_ROLLS];
+  float mean;
+} BearoffEntry;
+
+BearoffEntry *bearoff_table = NULL;
+pthread_once_t bearoff_once = PTHREAD_ONCE_INIT;
+int bearoff_choose[CHECKER_COUNT + BEAROFF_SLOTS + 1][BEAROFF_SLOTS + 1];
+
+// rank of the home board among all of them: the separators after every
+// slot take increasing places among the 21 of checkers and separators
+int bearoff_index(const int *counts) {
+  int index = 0, place = 0;
+  for (int slot = 0; slot < BEAROFF_SLOTS; slot++) {
+    place += counts[slot];
+    index += bearoff_choose[place + slot][slot + 1];
+  }
+  return index;
+}
+
+int highest_slot(const int *counts) {
+  for (int slot = BEAROFF_SLOTS - 1; slot >= 0; slot--)
+    if (counts[slot] > 0)
+      return slot;
+  return -1;
+}
+
+BearoffEntry *bearoff_entry(int *counts);
+
+// tries every way to play the dice left, a die bigger than needed bears off
+// from the highest slot only. Doublets go through the sources in
+// non-increasing order since their order doesn't change the result.
+void search_bearoff(int *counts, const int *dice, int dice_left,
+                    int max_slot, bool doublet, BearoffEntry **best) {
+  int highest = highest_slot(counts);
+  if (dice_left == 0 || highest == -1) {
+    BearoffEntry *entry = bearoff_entry(counts);
+    if (*best == NULL || entry->mean < (*best)->mean)
+      *best = entry;
+    return;
+  }
+  int die = dice[0];
+  for (int slot = highest < max_slot ? highest : max_slot; slot >= 0;
+       slot--) {
+    int to = slot - die;
+    if (counts[slot] == 0 || (to < -1 && slot != highest))
+      continue;
+    counts[slot]--;
+    if (to >= 0)
+      counts[to]++;
+    search_bearoff(counts, dice + 1, dice_left - 1,
+                   doublet ? slot : BEAROFF_SLOTS - 1, doublet, best);
+    if (to >= 0)
+      counts[to]--;
+    counts[slot]++;
+  }
+}
+
+void fill_bearoff_entry(int *counts, BearoffEntry *entry) {
+  memset(entry->rolls, 0, sizeof(entry->rolls));
+  entry->mean = 0;
+  if (highest_slot(counts) == -1) {
+    entry->rolls[0] = 1;
+    return;
+  }
+  for (int v1 = 1; v1 <= 6; v1++) {
+    for (int v2 = v1; v2 <= 6; v2++) {
+      BearoffEntry *best = NULL;
+      if (v1 == v2) {
+        int dice[] = {v1, v1, v1, v1};
+        search_bearoff(counts, dice, 4, BEAROFF_SLOTS - 1, true, &best);
+      } else {
+        int dice[] = {v1, v2, v1};
+        search_bearoff(counts, dice, 2, BEAROFF_SLOTS - 1, false, &best);
+        search_bearoff(counts, dice + 1, 2, BEAROFF_SLOTS - 1, false, &best);
+      }
+      float weight = (v1 == v2 ? 1 : 2) / 36.0f;
+      for (int n = 0; n < BEAROFF_ROLLS; n++) {
+        int next = n + 1 < BEAROFF_ROLLS ? n + 1 : n;
+        entry->rolls[next] += weight * best->rolls[n];
+      }
+    }
+  }
+  for (int n = 0; n < BEAROFF_ROLLS; n++)
+    entry->mean += n * entry->rolls[n];
+}
+
+// entries are filled on first use, the moves only lower the pip count so
+// the recursion ends
+BearoffEntry *bearoff_entry(int *counts) {
+  BearoffEntry *entry = &bearoff_table[bearoff_index(counts)];
+  if (entry->mean < 0)
+    fill_bearoff_entry(counts, entry);
+  return entry;
+}
+
+void fill_bearoff_slots(int *counts, int slot, int left) {
+  if (slot == BEAROFF_SLOTS) {
+    bearoff_entry(counts);
+    return;
+  }
+  for (int count = 0; count <= left; count++) {
+    counts[slot] = count;
+    fill_bearoff_slots(counts, slot + 1, left - count);
+  }
+  counts[slot] = 0;
+}
+
+void build_bearoff_table() {
+  for (int n = 0; n <= CHECKER_COUNT + BEAROFF_SLOTS; n++) {
+    bearoff_choose[n][0] = 1;
+    for (int k = 1; k <= BEAROFF_SLOTS; k++)
+      bearoff_choose[n][k] =
+          n == 0 ? 0 : bearoff_choose[n - 1][k - 1] + bearoff_choose[n - 1][k];
+  }
+  bearoff_table = malloc(BEAROFF_POSITIONS * sizeof(BearoffEntry));
+  if (bearoff_table == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  for (int i = 0; i < BEAROFF_POSITIONS; i++)
+    bearoff_table[i].mean = -1;
+  int counts[BEAROFF_SLOTS] = {0};
+  fill_bearoff_slots(counts, 0, CHECKER_COUNT);
+}
+
+// chance that the side on roll bears off first, the counts are per home
+// slot with the ace point first. The table is built by the first caller.
+float bearoff_win(const int *me, const int *opp) {
+  pthread_once(&bearoff_once, build_bearoff_table);
+  BearoffEntry *mine = &bearoff_table[bearoff_index(me)];
+  BearoffEntry *theirs = &bearoff_table[bearoff_index(opp)];
+
+  // the side on roll wins when it needs no more rolls than the other one
+  float win = 0, opp_left = 1;
+  for (int n = 0; n < BEAROFF_ROLLS; n++) {
+    win += mine->rolls[n] * opp_left;
+    opp_left -= theirs->rolls[n];
+  }
+  return win;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "../headers/board_text.h"
+#include "game.c"
+#include <stdio.h>
+#include <string.h>
+
+// static part of the board, rendered once and copied before every position
+char board_text_frame[BOARD_TEXT_LEN];
+bool board_text_frame_ready = false;
+
+char *text_cell(char *buf, int y, int x) {
+  return &buf[y * (BOARD_TEXT_WIDTH + 1) + x];
+}
+
+void text_put(void *target, int y, int x, const char *str) {
+  char *buf = target;
+  if (y < 0 || y >= BOARD_TEXT_HEIGHT)
+    return;
+  for (; *str != '\0' && x < BOARD_TEXT_WIDTH; str++, x++) {
+    if (x >= 0)
+      *text_cell(buf, y, x) = *str;
+  }
+}
+
+void text_border(char *buf) {
+  for (int x = 0; x < BOARD_TEXT_WIDTH; x++) {
+    *text_cell(buf, 0, x) = '-';
+    *text_cell(buf, BOARD_TEXT_HEIGHT - 1, x) = '-';
+  }
+  for (int y = 0; y < BOARD_TEXT_HEIGHT; y++) {
+    char c = y == 0 || y == BOARD_TEXT_HEIGHT - 1 ? '+' : '|';
+    *text_cell(buf, y, 0) = c;
+    *text_cell(buf, y, BOARD_TEXT_WIDTH - 1) = c;
+  }
+}
+
+void render_board_text_frame(char *buf) {
+  for (int y = 0; y < BOARD_TEXT_HEIGHT; y++) {
+    memset(text_cell(buf, y, 0), ' ', BOARD_TEXT_WIDTH);
+    *text_cell(buf, y, BOARD_TEXT_WIDTH) = '\n';
+  }
+  buf[BOARD_TEXT_LEN - 1] = '\0';
+  text_border(buf);
+
+  BoardCanvas canvas = {text_put, buf, BOARD_TEXT_WIDTH};
+  draw_board_frame(&canvas);
+}
+
+void init_board_text() {
+  if (board_text_frame_ready)
+    return;
+  render_board_text_frame(board_text_frame);
+  board_text_frame_ready = true;
+}
+
+// buf has to hold at least BOARD_TEXT_LEN chars
+void render_board_text(Board *board, char *buf) {
+  init_board_text();
+  memcpy(buf, board_text_frame, BOARD_TEXT_LEN);
+
+  BoardCanvas canvas = {text_put, buf, BOARD_TEXT_WIDTH};
+  draw_board_checkers(&canvas, board);
+}
+
+bool write_board_text(FILE *fp, const char *buf, BoardTextFormat format) {
+  if (format == PlainText)
+    return fputs(buf, fp) >= 0;
+
+  for (; *buf != '\0'; buf++) {
+    int res;
+    if (*buf == WHITE_CHECKER_CHAR)
+      res = fprintf(fp, ANSI_WHITE "%c" ANSI_RESET, *buf);
+    else if (*buf == RED_CHECKER_CHAR)
+      res = fprintf(fp, ANSI_RED "%c" ANSI_RESET, *buf);
+    else
+      res = fputc(*buf, fp);
+    if (res < 0)
+      return false;
+  }
+  return true;
+}
+
+void write_position_stats(FILE *fp, GameManager *game_manager) {
+  DiceRoll *dice_roll = &game_manager->dice_roll;
+  fprintf(fp, "white out: %02d red out: %02d bar: %d/%d\n",
+          game_manager->board.white_out_count,
+          game_manager->board.red_out_count,
+          game_manager->board.white_bar.checker_count,
+          game_manager->board.red_bar.checker_count);
+  fprintf(fp, "to move: %s roll: %d %d\n",
+          game_manager->curr_player == White ? "White" : "Red", dice_roll->v1,
+          dice_roll->v2);
+}
+
+bool write_position(FILE *fp, GameManager *game_manager,
+                    BoardTextFormat format) {
+  char buf[BOARD_TEXT_LEN];
+  render_board_text(&game_manager->board, buf);
+
+  if (!write_board_text(fp, buf, format))
+    return false;
+  write_position_stats(fp, game_manager);
+  return true;
+}
+
+bool dump_position(FILE *fp, GameManager *game_manager,
+                   BoardTextFormat format) {
+  if (format == AnsiText)
+    fputs(ANSI_CLEAR, fp);
+  return write_position(fp, game_manager, format);
+}
+
+// dumps every position of the game, from the start to the last logged move
+bool dump_game(FILE *fp, GameManager *game_manager, BoardTextFormat format) {
+  if (turn_log_len(&game_manager->turn_log) == 0)
+    return dump_position(fp, game_manager, format);
+
+  GameManager replay = *game_manager;
+  trav_apply_to_start(&replay);
+
+  int frame = 0;
+  while (true) {
+    fputs(format == AnsiText ? ANSI_CLEAR : "\n", fp);
+    fprintf(fp, "frame %d turn %d move %d\n", frame++,
+            replay.turn_log.trav_turn_id + 1, replay.turn_log.trav_move_id + 1);
+    if (!write_position(fp, &replay, format))
+      return false;
+    if (trav_on_end(&replay.turn_log))
+      break;
+    trav_apply_move(&replay, false);
+  }
+  return true;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "../headers/opening_book.h"
+#include "engine.c"
+#include "opening_book.c"
+#include <time.h>
+
+typedef struct {
+  EngineConfig config;
+  int trials, candidates;
+  Rng rng;
+  PlayList plays;
+  Vec entries;
+} BookBuilder;
+
+// rolls out the best 0-ply candidates of White's plays and returns the
+// play with the best rollout equity
+float book_best_play(BookBuilder *builder, Board *board, DiceRoll roll,
+                     Play *best) {
+  GameManager state = position_state(board, White, roll);
+  generate_plays(&state, &builder->plays);
+  int count = play_count(&builder->plays);
+
+  int candidates[MAX_BOOK_CANDIDATES];
+  float equities[MAX_BOOK_CANDIDATES];
+  int candidate_count = 0;
+  for (int i = 0; i < count; i++) {
+    EvalOutput eval;
+    evaluate_play(&builder->config, play_at(&builder->plays, i), White, 0,
+                  &eval);
+    float equity = eval_equity(&eval);
+    // insertion into the sorted list of the best ones so far
+    int pos = candidate_count < builder->candidates ? candidate_count++
+                                                    : candidate_count;
+    while (pos > 0 && equities[pos - 1] < equity) {
+      if (pos < builder->candidates) {
+        candidates[pos] = candidates[pos - 1];
+        equities[pos] = equities[pos - 1];
+      }
+      pos--;
+    }
+    if (pos < builder->candidates) {
+      candidates[pos] = i;
+      equities[pos] = equity;
+    }
+  }
+
+  float best_equity = -4;
+  for (int i = 0; i < candidate_count; i++) {
+    Play *play = play_at(&builder->plays, candidates[i]);
+    EvalOutput eval;
+    parallel_rollout(&builder->config, &play->board, Red, builder->trials,
+                     BOOK_ROLLOUT_TIME_MS, &builder->rng, &eval);
+    invert_eval(&eval);
+    float equity = eval_equity(&eval);
+    if (equity > best_equity) {
+      best_equity = equity;
+      *best = *play;
+    }
+  }
+  return best_equity;
+}
+
+void add_book_entry(BookBuilder *builder, Board *board, DiceRoll roll,
+                    Play *play, float equity) {
+  BookEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  position_key(board, &entry.key);
+  entry.hash = key_hash(&entry.key, White);
+  entry.dice = book_dice(roll.v1, roll.v2);
+  entry.step_count = play->move_count;
+  for (int i = 0; i < play->move_count; i++) {
+    entry.steps[i][0] = play->moves[i].from;
+    entry.steps[i][1] = play->moves[i].by;
+  }
+  entry.equity = equity;
+
+  Vec *entries = &builder->entries;
+  if (entries->len + 1 > entries->cap && vec_extend(entries) == 1)
+    exit(NO_HEAP_MEM_EXIT);
+  ((BookEntry *)entries->data)[entries->len++] = entry;
+}
+
+// White's opening rolls from the starting position, then every roll for
+// White after each of Red's book openings, which are White's mirrored
+int run_book_builder(const char *filename, int trials, int candidates) {
+  static BookBuilder builder;
+  builder.config = default_engine_config();
+  builder.trials = trials > 0 ? trials : DEFAULT_BOOK_TRIALS;
+  builder.candidates = candidates > 0 && candidates <= MAX_BOOK_CANDIDATES
+                           ? candidates
+                           : DEFAULT_BOOK_CANDIDATES;
+  builder.rng = new_rng(time(NULL));
+  new_play_list(&builder.plays);
+  vec_new(&builder.entries, sizeof(BookEntry));
+  if (builder.entries.data == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+
+  DiceRoll rolls[ROLL_COUNT];
+  int weights[ROLL_COUNT];
+  all_rolls(rolls, weights);
+  Board start = default_board();
+  for (int i = 0; i < ROLL_COUNT; i++) {
+    if (rolls[i].v1 == rolls[i].v2)
+      continue;
+    Play opening;
+    float equity = book_best_play(&builder, &start, rolls[i], &opening);
+    add_book_entry(&builder, &start, rolls[i], &opening, equity);
+
+    Board reply;
+    mirror_board(&opening.board, &reply);
+    for (int j = 0; j < ROLL_COUNT; j++) {
+      Play play;
+      equity = book_best_play(&builder, &reply, rolls[j], &play);
+      add_book_entry(&builder, &reply, rolls[j], &play, equity);
+    }
+    fprintf(stderr, "opening %d-%d done, %d entries\n", rolls[i].v1,
+            rolls[i].v2, builder.entries.len);
+  }
+
+  bool saved =
+      save_opening_book(builder.entries.data, builder.entries.len, filename);
+  if (!saved)
+    fprintf(stderr, "can't write %s\n", filename);
+  free_play_list(&builder.plays);
+  vec_free(&builder.entries);
+  return saved ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include "../headers/cube.h"
+#include "eval.c"
+#include "game.c"
+#include "match_equity.c"
+
+// equities are in points for money games and match winning chances in
+// match play, always for the player the analysis is done for
+typedef struct {
+  CubeDecision decision;
+  float no_double;
+  float double_take;
+  float double_pass;
+} CubeAnalysis;
+
+const char *cube_decision_str(CubeDecision decision) {
+  switch (decision) {
+  case NoDouble:
+    return "no-double";
+  case DoubleTake:
+    return "double-take";
+  case DoublePass:
+    return "double-pass";
+  case TooGoodToDouble:
+    return "too-good";
+  }
+  return "";
+}
+
+// money games here always have a live cube, unlike in the UI
+bool cube_available(MatchState *match, CheckerKind player) {
+  if (match->length == MONEY_GAME)
+    return match->cube_owner == None || match->cube_owner == player;
+  return can_double(match, player);
+}
+
+float outcome_value(MatchState *match, CheckerKind player, CheckerKind winner,
+                    int points) {
+  if (match->length == MONEY_GAME)
+    return winner == player ? points : -points;
+  return match_equity_after(match, player, winner, points);
+}
+
+// average value of the games the winner takes at the given cube value,
+// weighted by how often they are gammons and backgammons
+float win_value(MatchState *match, CheckerKind player, CheckerKind winner,
+                EvalOutput *eval, int cube) {
+  bool player_won = winner == player;
+  float wins = player_won ? eval->win : 1 - eval->win;
+  float gammons = player_won ? eval->win_gammon : eval->lose_gammon;
+  float backgammons =
+      player_won ? eval->win_backgammon : eval->lose_backgammon;
+  float single = outcome_value(match, player, winner, cube);
+  if (wins <= 0)
+    return single;
+
+  return ((wins - gammons) * single +
+          (gammons - backgammons) *
+              outcome_value(match, player, winner, 2 * cube) +
+          backgammons * outcome_value(match, player, winner, 3 * cube)) /
+         wins;
+}
+
+// where the straight line from (x0, y0) to (x1, y1) is at x
+float interpolate(float x, float x0, float y0, float x1, float y1) {
+  if (x1 <= x0)
+    return y1;
+  return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+}
+
+float clamp_chance(float p) { return p < 0 ? 0 : p > 1 ? 1 : p; }
+
+// taker's winning chance where taking a double to twice cube is as good
+// as passing, with the doubled cube dead
+float dead_take_point(MatchState *match, CheckerKind taker, EvalOutput *eval,
+                      int cube) {
+  CheckerKind doubler = opposite_checker(taker);
+  float doubled_win = win_value(match, taker, taker, eval, 2 * cube);
+  float doubled_lose = win_value(match, taker, doubler, eval, 2 * cube);
+  float drop = outcome_value(match, taker, doubler, cube);
+  float range = doubled_win - doubled_lose;
+  return range > 0 ? clamp_chance((drop - doubled_lose) / range) : 0;
+}
+
+// The taker owns the doubled cube and can cash with it later, which lowers
+// the take point. With a fully live cube the taker's equity runs straight
+// from losing everything to cashing at the redouble point, the real take
+// point is mixed from both by the cube efficiency.
+float take_point(MatchState *match, CheckerKind taker, EvalOutput *eval,
+                 int cube) {
+  CheckerKind doubler = opposite_checker(taker);
+  float dead = dead_take_point(match, taker, eval, cube);
+  MatchState doubled = *match;
+  doubled.cube_value = 2 * cube;
+  doubled.cube_owner = taker;
+  if (!cube_available(&doubled, taker))
+    return dead;
+
+  EvalOutput doubler_eval = *eval;
+  invert_eval(&doubler_eval);
+  float cash_point =
+      1 - dead_take_point(match, doubler, &doubler_eval, 2 * cube);
+  float doubled_lose = win_value(match, taker, doubler, eval, 2 * cube);
+  float doubled_cash = outcome_value(match, taker, taker, 2 * cube);
+  float drop = outcome_value(match, taker, doubler, cube);
+  float live = dead;
+  if (doubled_cash > doubled_lose)
+    live = cash_point * clamp_chance((drop - doubled_lose) /
+                                     (doubled_cash - doubled_lose));
+  return CUBE_EFFICIENCY * live + (1 - CUBE_EFFICIENCY) * dead;
+}
+
+// Janowski style cubeful equity: a mix of the dead cube equity and an ideal
+// live cube one, which is cashed or dropped at the market window and
+// linear in between
+float cubeful_equity(MatchState *match, CheckerKind player, EvalOutput *eval) {
+  CheckerKind opp = opposite_checker(player);
+  int cube = match->cube_value;
+  float p = eval->win;
+  float win = win_value(match, player, player, eval, cube);
+  float lose = win_value(match, player, opp, eval, cube);
+  float dead = p * win + (1 - p) * lose;
+
+  EvalOutput opp_eval = *eval;
+  invert_eval(&opp_eval);
+  float cash = outcome_value(match, player, player, cube);
+  float drop = outcome_value(match, player, opp, cube);
+  float player_take_point = take_point(match, player, eval, cube);
+  float cash_point = 1 - take_point(match, opp, &opp_eval, cube);
+
+  // the market window points, from losing every game to winning every game
+  float xs[4] = {0}, ys[4] = {lose};
+  int count = 1;
+  if (cube_available(match, opp)) {
+    xs[count] = player_take_point;
+    ys[count++] = drop;
+  }
+  if (cube_available(match, player)) {
+    xs[count] = cash_point > xs[count - 1] ? cash_point : xs[count - 1];
+    ys[count++] = cash;
+  }
+  xs[count] = 1;
+  ys[count++] = win;
+
+  int seg = 0;
+  while (seg < count - 2 && p > xs[seg + 1])
+    seg++;
+  float live = interpolate(p, xs[seg], ys[seg], xs[seg + 1], ys[seg + 1]);
+  return CUBE_EFFICIENCY * live + (1 - CUBE_EFFICIENCY) * dead;
+}
+
+// cube action for player before rolling, eval is the cubeless evaluation
+// of the position from the player's side
+void analyse_cube(MatchState *match, CheckerKind player, EvalOutput *eval,
+                  CubeAnalysis *out) {
+  out->no_double = cubeful_equity(match, player, eval);
+  MatchState doubled = *match;
+  accept_double(&doubled, opposite_checker(player));
+  out->double_take = cubeful_equity(&doubled, player, eval);
+  out->double_pass =
+      outcome_value(match, player, player, match->cube_value);
+
+  bool take = out->double_take <= out->double_pass;
+  float doubled_equity = take ? out->double_take : out->double_pass;
+  if (!cube_available(match, player))
+    out->decision = NoDouble;
+  else if (doubled_equity > out->no_double)
+    out->decision = take ? DoubleTake : DoublePass;
+  else
+    out->decision = take ? NoDouble : TooGoodToDouble;
+}
@@ -0,0 +1,1056 @@
+#pragma once
+#include "../headers/engine.h"
+#include "board_text.c"
+#include "cube.c"
+#include "eval.c"
+#include "game.c"
+#include "match_equity.c"
+#include "movegen.c"
+#include "opening_book.c"
+#include "position.c"
+#include "rng.c"
+#include <ctype.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+// plays passed from one stage of the move filter to the next: at most keep
+// of them, and only those within margin of the stage's best equity
+typedef struct {
+  int keep;
+  float margin;
+} MoveFilter;
+
+typedef struct {
+  int plies;
+  int rollout_trials;
+  int threads;
+  int cube_time_ms;
+  // every position of the search is played by these, see use_game_rules
+  RuleSet rules;
+  Variant variant;
+  // filters[i] prunes the plays scored at i plies before the next stage
+  MoveFilter filters[MAX_PLIES];
+  // budget of a filtered search in ms, 0 runs every stage to the end
+  int move_time_ms;
+  // positions evaluated statically with this config
+  long long nodes;
+  // the running filtered search: its deadline, 0 for none, the node count
+  // at which the clock is read next and whether the deadline has passed
+  double deadline;
+  long long check_at;
+  bool stopped;
+} EngineConfig;
+
+// plays scored, positions evaluated and time taken at each stage of a
+// filtered search, aborted when the deadline cut the last stage short
+typedef struct {
+  int plays[MAX_PLIES + 1];
+  long long nodes[MAX_PLIES + 1];
+  double seconds[MAX_PLIES + 1];
+  int stages;
+  bool aborted;
+} FilterStats;
+
+int online_cpus() {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus < 1)
+    return 1;
+  return cpus < MAX_ENGINE_THREADS ? cpus : MAX_ENGINE_THREADS;
+}
+
+EngineConfig default_engine_config() {
+  EngineConfig config;
+  memset(&config, 0, sizeof(config));
+  config.plies = DEFAULT_PLIES;
+  config.rollout_trials = DEFAULT_ROLLOUT_TRIALS;
+  config.threads = online_cpus();
+  config.cube_time_ms = DEFAULT_CUBE_TIME_MS;
+  for (int i = 0; i < MAX_PLIES; i++)
+    config.filters[i] = (MoveFilter){DEFAULT_FILTER_KEEP >> i,
+                                     DEFAULT_FILTER_MARGIN / (1 << i)};
+  return config;
+}
+
+// arms the deadline of config->move_time_ms for a filtered search
+void start_search(EngineConfig *config) {
+  config->deadline =
+      config->move_time_ms > 0
+          ? monotonic_seconds() + config->move_time_ms / 1000.0
+          : 0;
+  config->check_at = config->nodes;
+  config->stopped = false;
+}
+
+void end_search(EngineConfig *config) {
+  config->deadline = 0;
+  config->stopped = false;
+}
+
+// the cancellation check of the search: once it returns true every level
+// returns at once and the stage being scored is thrown away
+bool search_stopped(EngineConfig *config) {
+  if (config->deadline > 0 && !config->stopped &&
+      config->nodes >= config->check_at) {
+    config->check_at = config->nodes + SEARCH_CHECK_NODES;
+    config->stopped = monotonic_seconds() >= config->deadline;
+  }
+  return config->stopped;
+}
+
+// position, side to move and roll, without a turn log
+GameManager position_state(Board *board, CheckerKind on_roll,
+                           DiceRoll dice_roll) {
+  GameManager state;
+  memset(&state, 0, sizeof(state));
+  state.board = *board;
+  state.curr_player = on_roll;
+  state.dice_roll = dice_roll;
+  return state;
+}
+
+// the search plays by the rules and variant of the game it's asked about
+void use_game_rules(EngineConfig *config, GameManager *game_manager) {
+  config->rules = game_manager->rules;
+  config->variant = game_manager->variant;
+}
+
+// position_state under the rules and variant of the search
+GameManager search_state(EngineConfig *config, Board *board,
+                         CheckerKind on_roll, DiceRoll dice_roll) {
+  GameManager state = position_state(board, on_roll, dice_roll);
+  state.rules = config->rules;
+  state.variant = config->variant;
+  return state;
+}
+
+void evaluate_plies(EngineConfig *config, Board *board, CheckerKind on_roll,
+                    int plies, EvalOutput *out);
+
+// value of a play for the player who made it
+void evaluate_play(EngineConfig *config, Play *play, CheckerKind player,
+                   int plies, EvalOutput *out) {
+  evaluate_plies(config, &play->board, opposite_checker(player), plies, out);
+  invert_eval(out);
+}
+
+// picks the play with the best 0-ply equity and evaluates it at plies
+int choose_play(EngineConfig *config, GameManager *state, PlayList *plays,
+                int plies, EvalOutput *out) {
+  generate_plays(state, plays);
+
+  int best = 0;
+  float best_equity = -4;
+  for (int i = 0; i < play_count(plays); i++) {
+    EvalOutput eval;
+    evaluate_play(config, play_at(plays, i), state->curr_player, 0, &eval);
+    float equity = eval_equity(&eval);
+    if (equity > best_equity) {
+      best_equity = equity;
+      best = i;
+      *out = eval;
+    }
+  }
+  if (plies > 0)
+    evaluate_play(config, play_at(plays, best), state->curr_player, plies, out);
+  return best;
+}
+
+void add_weighted_eval(EvalOutput *sum, EvalOutput *eval, float weight) {
+  sum->win += eval->win * weight;
+  sum->win_gammon += eval->win_gammon * weight;
+  sum->win_backgammon += eval->win_backgammon * weight;
+  sum->lose_gammon += eval->lose_gammon * weight;
+  sum->lose_backgammon += eval->lose_backgammon * weight;
+}
+
+// evaluation for the player on roll, averaged over the next plies rolls
+void evaluate_plies(EngineConfig *config, Board *board, CheckerKind on_roll,
+                    int plies, EvalOutput *out) {
+  evaluate_position(board, on_roll, out);
+  config->nodes++;
+  if (plies <= 0 || out->win == 0 || out->win == 1 || search_stopped(config))
+    return;
+
+  DiceRoll rolls[ROLL_COUNT];
+  int weights[ROLL_COUNT];
+  all_rolls(rolls, weights);
+
+  // every node of the search takes its plays from the scratch arena
+  Arena *arena = scratch_arena();
+  ArenaMark mark = arena_mark(arena);
+  PlayList plays;
+  new_play_list_in(&plays, arena);
+  *out = (EvalOutput){0, 0, 0, 0, 0};
+  for (int i = 0; i < ROLL_COUNT && !config->stopped; i++) {
+    GameManager state = search_state(config, board, on_roll, rolls[i]);
+    EvalOutput eval;
+    choose_play(config, &state, &plays, plies - 1, &eval);
+    add_weighted_eval(out, &eval, (float)weights[i] / ROLL_OUTCOMES);
+  }
+  arena_release(arena, mark);
+}
+
+// the book play for the state, replayed under the rules so a book built
+// for other rules can't produce an illegal play
+bool book_play(GameManager *state, Play *out) {
+  MoveEntry moves[MAX_DOUBLET_USES];
+  int count = book_lookup(opening_book, &state->board, state->curr_player,
+                          &state->dice_roll, moves);
+  if (count < 0)
+    return false;
+
+  GameManager next = *state;
+  out->move_count = 0;
+  for (int i = 0; i < count; i++) {
+    int from = moves[i].from, by = moves[i].by;
+    MoveError error =
+        is_pos_on_bar(from)
+            ? (can_use_roll_val(&next.dice_roll, by) ? enter_error(&next, by)
+                                                     : MoveIllegal)
+            : move_error(&next, from, by);
+    if (error != MoveOk)
+      return false;
+    apply_play_step(&next, out, from, by);
+  }
+  if (!turn_finished(&next))
+    return false;
+  out->board = next.board;
+  position_key(&out->board, &out->key);
+  return true;
+}
+
+typedef struct {
+  int id;
+  float equity;
+  EvalOutput eval;
+} FilterCandidate;
+
+int compare_candidates(const void *a, const void *b) {
+  float ea = ((const FilterCandidate *)a)->equity;
+  float eb = ((const FilterCandidate *)b)->equity;
+  return (ea < eb) - (ea > eb);
+}
+
+// scores every play statically, then rescores the survivors of each stage
+// one ply deeper up to config->plies, so deep search only sees a few plays
+// even on doublets. With a move time the stages are an iterative deepening:
+// the static stage always finishes, a later one cut short by the deadline is
+// dropped and the best play of the stage before it is returned.
+int filter_plays(EngineConfig *config, GameManager *state, PlayList *plays,
+                 FilterStats *stats, EvalOutput *out) {
+  use_game_rules(config, state);
+  generate_plays(state, plays);
+  int count = play_count(plays);
+  memset(stats, 0, sizeof(*stats));
+  if (count == 0)
+    return -1;
+
+  start_search(config);
+  Arena *arena = scratch_arena();
+  ArenaMark mark = arena_mark(arena);
+  FilterCandidate *candidates =
+      arena_alloc(arena, count * sizeof(FilterCandidate));
+  // the order of the last finished stage
+  FilterCandidate *finished =
+      arena_alloc(arena, count * sizeof(FilterCandidate));
+  for (int i = 0; i < count; i++)
+    candidates[i].id = i;
+
+  for (int plies = 0; plies <= config->plies; plies++) {
+    long long nodes = config->nodes;
+    double start = monotonic_seconds();
+    if (plies > 0)
+      memcpy(finished, candidates, count * sizeof(FilterCandidate));
+    int scored = 0;
+    for (; scored < count; scored++) {
+      FilterCandidate *candidate = &candidates[scored];
+      evaluate_play(config, play_at(plays, candidate->id),
+                    state->curr_player, plies, &candidate->eval);
+      if (config->stopped)
+        break;
+      candidate->equity = eval_equity(&candidate->eval);
+    }
+    stats->plays[plies] = scored;
+    stats->nodes[plies] = config->nodes - nodes;
+    stats->seconds[plies] = monotonic_seconds() - start;
+    stats->stages = plies + 1;
+    if (scored < count) {
+      memcpy(candidates, finished, count * sizeof(FilterCandidate));
+      stats->aborted = true;
+      break;
+    }
+    qsort(candidates, count, sizeof(FilterCandidate), compare_candidates);
+    if (plies == config->plies)
+      break;
+
+    MoveFilter *filter = &config->filters[plies];
+    int keep = 1;
+    while (keep < count && keep < filter->keep &&
+           candidates[0].equity - candidates[keep].equity <= filter->margin)
+      keep++;
+    count = keep;
+    if (count == 1)
+      break;
+  }
+
+  int best = candidates[0].id;
+  *out = candidates[0].eval;
+  arena_release(arena, mark);
+  end_search(config);
+  return best;
+}
+
+bool best_play(EngineConfig *config, GameManager *state, Play *best,
+               EvalOutput *eval, FilterStats *stats) {
+  if (book_play(state, best)) {
+    memset(stats, 0, sizeof(*stats));
+    evaluate_play(config, best, state->curr_player, 0, eval);
+    return true;
+  }
+  Arena *arena = scratch_arena();
+  ArenaMark mark = arena_mark(arena);
+  PlayList plays;
+  new_play_list_in(&plays, arena);
+  int id = filter_plays(config, state, &plays, stats, eval);
+  if (id >= 0)
+    *best = *play_at(&plays, id);
+  arena_release(arena, mark);
+  return id >= 0;
+}
+
+void add_outcome(EvalOutput *sum, bool won, WinKind win_kind) {
+  float *wins = won ? &sum->win_gammon : &sum->lose_gammon;
+  float *backgammons = won ? &sum->win_backgammon : &sum->lose_backgammon;
+  sum->win += won;
+  *wins += win_kind >= GammonWin;
+  *backgammons += win_kind >= BackgammonWin;
+}
+
+// plays the position out trials times with the 0-ply policy under the
+// rules of config, a dice_roll with v1 set is used as the first roll of
+// every trial
+void rollout(EngineConfig *config, Board *board, CheckerKind on_roll,
+             DiceRoll *dice_roll, int trials, Rng *rng, EvalOutput *out) {
+  EngineConfig policy = default_engine_config();
+  policy.plies = 0;
+  policy.rules = config->rules;
+  policy.variant = config->variant;
+  Arena *arena = scratch_arena();
+  ArenaMark mark = arena_mark(arena);
+  PlayList plays;
+  new_play_list_in(&plays, arena);
+  *out = (EvalOutput){0, 0, 0, 0, 0};
+
+  for (int trial = 0; trial < trials; trial++) {
+    DiceRoll first = dice_roll->v1 > 0 ? *dice_roll : rng_dice_roll(rng);
+    GameManager state = search_state(&policy, board, on_roll, first);
+
+    for (int turn = 0; turn < MAX_ROLLOUT_TURNS; turn++) {
+      EvalOutput eval;
+      int id = choose_play(&policy, &state, &plays, 0, &eval);
+      state.board = play_at(&plays, id)->board;
+
+      WinKind win_kind;
+      CheckerKind won = check_game_over(&state, &win_kind);
+      if (won != None) {
+        add_outcome(out, won == on_roll, win_kind);
+        break;
+      }
+      state.curr_player = opposite_checker(state.curr_player);
+      state.dice_roll = rng_dice_roll(rng);
+    }
+  }
+  arena_release(arena, mark);
+
+  EvalOutput sum = *out;
+  *out = (EvalOutput){0, 0, 0, 0, 0};
+  if (trials > 0)
+    add_weighted_eval(out, &sum, 1.0f / trials);
+}
+
+typedef struct {
+  // only read for its rules
+  EngineConfig *config;
+  Board board;
+  CheckerKind on_roll;
+  int trials;
+  double deadline;
+  Rng rng;
+  EvalOutput sum;
+  int done;
+} RolloutWorker;
+
+// plays chunks of trials until its share is done or the deadline passed,
+// the first chunk is always played
+void rollout_worker(RolloutWorker *worker) {
+  DiceRoll no_roll = new_dice_roll(0, 0);
+  do {
+    int chunk = worker->trials - worker->done;
+    if (chunk > ROLLOUT_CHUNK)
+      chunk = ROLLOUT_CHUNK;
+    EvalOutput eval;
+    rollout(worker->config, &worker->board, worker->on_roll, &no_roll, chunk,
+            &worker->rng, &eval);
+    add_weighted_eval(&worker->sum, &eval, chunk);
+    worker->done += chunk;
+  } while (worker->done < worker->trials &&
+           monotonic_seconds() < worker->deadline);
+}
+
+// the scratch arena is thread local, so only threads started here free it,
+// the caller's one may still hold marks
+void *rollout_thread(void *arg) {
+  rollout_worker(arg);
+  free_arena(scratch_arena());
+  return NULL;
+}
+
+// rollout before the roll split over config->threads threads, stops early
+// once time_ms has passed and returns the number of trials played
+int parallel_rollout(EngineConfig *config, Board *board, CheckerKind on_roll,
+                     int trials, int time_ms, Rng *rng, EvalOutput *out) {
+  RolloutWorker workers[MAX_ENGINE_THREADS];
+  pthread_t threads[MAX_ENGINE_THREADS];
+  bool started[MAX_ENGINE_THREADS];
+  int count = config->threads;
+  if (count > trials)
+    count = trials;
+  double deadline = monotonic_seconds() + time_ms / 1000.0;
+
+  for (int i = 0; i < count; i++) {
+    workers[i] = (RolloutWorker){config, *board, on_roll,
+                                 trials / count + (i < trials % count),
+                                 deadline, new_rng(rng_next(rng)),
+                                 (EvalOutput){0, 0, 0, 0, 0}, 0};
+    // the last share runs on this thread
+    started[i] = i < count - 1 &&
+                 pthread_create(&threads[i], NULL, rollout_thread,
+                                &workers[i]) == 0;
+  }
+  for (int i = 0; i < count; i++) {
+    if (!started[i])
+      rollout_worker(&workers[i]);
+  }
+
+  EvalOutput sum = {0, 0, 0, 0, 0};
+  int done = 0;
+  for (int i = 0; i < count; i++) {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    add_weighted_eval(&sum, &workers[i].sum, 1);
+    done += workers[i].done;
+  }
+  *out = (EvalOutput){0, 0, 0, 0, 0};
+  if (done > 0)
+    add_weighted_eval(out, &sum, 1.0f / done);
+  return done;
+}
+
+typedef struct {
+  GameManager game_manager;
+  bool has_dice;
+  EngineConfig config;
+  Rng rng;
+  Network network, race_network;
+  OpeningBook book;
+  HyperDatabase hyper;
+  FilterStats last_search;
+  // game clock in ms, spent by bestmove when has_clock is set
+  bool has_clock;
+  double clock_ms, increment_ms;
+  FILE *log;
+} Engine;
+
+void engine_set_position(Engine *engine, Board *board, CheckerKind side) {
+  GameManager *game_manager = &engine->game_manager;
+  game_manager->board = *board;
+  game_manager->curr_player = side;
+  game_manager->dice_roll = new_dice_roll(0, 0);
+  clear_turn_log(&game_manager->turn_log);
+  engine->has_dice = false;
+}
+
+void engine_set_dice(Engine *engine, int v1, int v2) {
+  engine->game_manager.dice_roll = new_dice_roll(v1, v2);
+  clear_turn_log(&engine->game_manager.turn_log);
+  log_new_turn(&engine->game_manager);
+  engine->has_dice = true;
+}
+
+void engine_pass_turn(Engine *engine) {
+  GameManager *game_manager = &engine->game_manager;
+  engine_set_position(engine, &game_manager->board,
+                      opposite_checker(game_manager->curr_player));
+}
+
+void write_eval(FILE *out, const char *name, EvalOutput *eval) {
+  fprintf(out, "%s %.4f %.4f %.4f %.4f %.4f %.4f\n", name, eval_equity(eval),
+          eval->win, eval->win_gammon, eval->win_backgammon, eval->lose_gammon,
+          eval->lose_backgammon);
+}
+
+void write_step(FILE *out, MoveEntry *move) {
+  if (is_pos_on_bar(move->from))
+    fprintf(out, " bar:%d", move->by);
+  else
+    fprintf(out, " %d:%d", move->from + 1, move->by);
+  if (move->hit_enemy)
+    fputc('*', out);
+}
+
+void write_play(FILE *out, Play *play) {
+  fprintf(out, "bestmove");
+  if (play->move_count == 0)
+    fprintf(out, " none");
+  for (int i = 0; i < play->move_count; i++)
+    write_step(out, &play->moves[i]);
+  fputc('\n', out);
+}
+
+void write_id(FILE *out, Engine *engine) {
+  char id[POSITION_ID_LEN + 1];
+  position_id(&engine->game_manager.board, engine->game_manager.curr_player,
+              id);
+  fprintf(out, "id %s\n", id);
+}
+
+bool engine_move_step(Engine *engine, const char *step) {
+  char from[ENGINE_TOKEN_LEN];
+  int by;
+  if (sscanf(step, "%31[^:]:%d", from, &by) < 2)
+    return false;
+  if (strcmp(from, "bar") == 0)
+    return game_enter(&engine->game_manager, by) == MoveOk;
+
+  int from_point;
+  if (sscanf(from, "%d", &from_point) < 1)
+    return false;
+  return game_move(&engine->game_manager, from_point - 1, by) == MoveOk;
+}
+
+void handle_move(FILE *out, Engine *engine, char *steps) {
+  if (!engine->has_dice) {
+    fprintf(out, "error no dice\n");
+    return;
+  }
+  GameManager before = engine->game_manager;
+  char *save = NULL;
+  for (char *step = strtok_r(steps, " \t", &save); step != NULL;
+       step = strtok_r(NULL, " \t", &save)) {
+    if (!engine_move_step(engine, step)) {
+      engine->game_manager = before;
+      fprintf(out, "error illegal step %s\n", step);
+      return;
+    }
+  }
+  if (!turn_finished(&engine->game_manager)) {
+    engine->game_manager = before;
+    fprintf(out, "error incomplete play\n");
+    return;
+  }
+  engine_pass_turn(engine);
+  write_id(out, engine);
+}
+
+// share of the clock for the next move, at least 1 ms so it stays a budget
+int clock_budget(Engine *engine) {
+  double budget = engine->clock_ms / CLOCK_MOVES_LEFT + engine->increment_ms;
+  if (budget > engine->clock_ms / 2 + engine->increment_ms)
+    budget = engine->clock_ms / 2 + engine->increment_ms;
+  if (budget > MAX_MOVE_TIME_MS)
+    budget = MAX_MOVE_TIME_MS;
+  return budget < 1 ? 1 : (int)budget;
+}
+
+void write_search_stats(FILE *out, FilterStats *stats) {
+  fprintf(out, "stats");
+  for (int i = 0; i < stats->stages; i++)
+    fprintf(out, " %d:%d:%lld:%.1f", i, stats->plays[i], stats->nodes[i],
+            stats->seconds[i] * 1000);
+  fprintf(out, stats->aborted ? " aborted\n" : "\n");
+}
+
+void log_search(Engine *engine, int budget_ms, double ms, long long nodes) {
+  char id[POSITION_ID_LEN + 1];
+  GameManager *game_manager = &engine->game_manager;
+  position_id(&game_manager->board, game_manager->curr_player, id);
+  fprintf(engine->log, "%s %d%d budget %d ms %.1f positions %lld ", id,
+          game_manager->dice_roll.v1, game_manager->dice_roll.v2, budget_ms,
+          ms, nodes);
+  write_search_stats(engine->log, &engine->last_search);
+  fflush(engine->log);
+}
+
+void handle_bestmove(FILE *out, Engine *engine, bool make_play) {
+  if (!engine->has_dice) {
+    fprintf(out, "error no dice\n");
+    return;
+  }
+  EngineConfig *config = &engine->config;
+  int move_time_ms = config->move_time_ms;
+  if (engine->has_clock &&
+      (move_time_ms == 0 || clock_budget(engine) < move_time_ms))
+    config->move_time_ms = clock_budget(engine);
+  long long nodes = config->nodes;
+  double start = monotonic_seconds();
+  Play play;
+  EvalOutput eval;
+  bool found = best_play(config, &engine->game_manager, &play, &eval,
+                         &engine->last_search);
+  double ms = (monotonic_seconds() - start) * 1000;
+  if (engine->has_clock) {
+    engine->clock_ms -= ms;
+    if (engine->clock_ms < 0)
+      engine->clock_ms = 0;
+    engine->clock_ms += engine->increment_ms;
+  }
+  if (engine->log != NULL)
+    log_search(engine, config->move_time_ms, ms, config->nodes - nodes);
+  config->move_time_ms = move_time_ms;
+  if (!found) {
+    fprintf(out, "error no play\n");
+    return;
+  }
+  write_play(out, &play);
+  if (!make_play)
+    return;
+  engine->game_manager.board = play.board;
+  engine_pass_turn(engine);
+}
+
+// cube action for the side to move, from a rollout when use_rollout is set
+void handle_double(FILE *out, Engine *engine, bool use_rollout) {
+  GameManager *game_manager = &engine->game_manager;
+  EvalOutput eval;
+  int trials = 0;
+  if (use_rollout)
+    trials = parallel_rollout(&engine->config, &game_manager->board,
+                              game_manager->curr_player,
+                              engine->config.rollout_trials,
+                              engine->config.cube_time_ms, &engine->rng, &eval);
+  else
+    evaluate_plies(&engine->config, &game_manager->board,
+                   game_manager->curr_player, engine->config.plies, &eval);
+
+  CubeAnalysis analysis;
+  analyse_cube(&game_manager->match, game_manager->curr_player, &eval,
+               &analysis);
+  fprintf(out, "double %s %.4f %.4f %.4f %d\n",
+          cube_decision_str(analysis.decision), analysis.no_double,
+          analysis.double_take, analysis.double_pass, trials);
+}
+
+void handle_weights(FILE *out, Engine *engine, const char *filename,
+                    bool race) {
+  Network network;
+  if (!load_network(&network, filename)) {
+    fprintf(out, "error can't load weights\n");
+    return;
+  }
+  if (race) {
+    engine->race_network = network;
+    race_network = &engine->race_network;
+  } else {
+    engine->network = network;
+    eval_network = &engine->network;
+  }
+  fprintf(out, "ok\n");
+}
+
+void write_class_counts(FILE *out, Board *board, CheckerKind on_roll) {
+  fprintf(out, "classes %s",
+          class_names[classify_position(board, on_roll)]);
+  for (int i = 0; i < POSITION_CLASS_COUNT; i++)
+    fprintf(out, " %s:%lld", class_names[i],
+            (long long)atomic_load_explicit(&class_counts[i],
+                                            memory_order_relaxed));
+  fprintf(out, "\n");
+}
+
+void handle_book(FILE *out, Engine *engine, const char *arg) {
+  if (strcmp(arg, "off") == 0) {
+    opening_book = NULL;
+    fprintf(out, "ok\n");
+    return;
+  }
+  OpeningBook book;
+  if (!load_opening_book(&book, arg)) {
+    fprintf(out, "error can't load book\n");
+    return;
+  }
+  opening_book = NULL;
+  free_opening_book(&engine->book);
+  engine->book = book;
+  opening_book = &engine->book;
+  fprintf(out, "ok\n");
+}
+
+void handle_hyper(FILE *out, Engine *engine, const char *arg) {
+  if (strcmp(arg, "off") == 0) {
+    hyper_db = NULL;
+    free_hyper_database(&engine->hyper);
+    fprintf(out, "ok\n");
+    return;
+  }
+  HyperDatabase db;
+  if (!load_hyper_database(&db, arg)) {
+    fprintf(out, "error can't load database\n");
+    return;
+  }
+  hyper_db = NULL;
+  free_hyper_database(&engine->hyper);
+  engine->hyper = db;
+  hyper_db = &engine->hyper;
+  fprintf(out, "ok\n");
+}
+
+void handle_clock(FILE *out, Engine *engine, const char *args) {
+  double clock_ms, increment_ms = 0;
+  char arg[ENGINE_TOKEN_LEN] = "";
+  if (sscanf(args, "%31s", arg) < 1) {
+    if (engine->has_clock)
+      fprintf(out, "clock %.0f\n", engine->clock_ms);
+    else
+      fprintf(out, "clock off\n");
+    return;
+  }
+  if (strcmp(arg, "off") == 0) {
+    engine->has_clock = false;
+  } else if (sscanf(args, "%lf %lf", &clock_ms, &increment_ms) >= 1 &&
+             clock_ms >= 0 && increment_ms >= 0) {
+    engine->has_clock = true;
+    engine->clock_ms = clock_ms;
+    engine->increment_ms = increment_ms;
+  } else {
+    fprintf(out, "error bad clock\n");
+    return;
+  }
+  fprintf(out, "ok\n");
+}
+
+void handle_log(FILE *out, Engine *engine, const char *arg) {
+  FILE *log = NULL;
+  if (strcmp(arg, "off") != 0 && (log = fopen(arg, "a")) == NULL) {
+    fprintf(out, "error can't open log\n");
+    return;
+  }
+  if (engine->log != NULL)
+    fclose(engine->log);
+  engine->log = log;
+  fprintf(out, "ok\n");
+}
+
+// switches the variant and sets up its starting position
+void handle_variant(FILE *out, Engine *engine, const char *arg) {
+  if (!variant_from_name(arg, &engine->game_manager.variant)) {
+    fprintf(out, "error unknown variant\n");
+    return;
+  }
+  Board board = variant_board(engine->game_manager.variant);
+  engine_set_position(engine, &board, White);
+  fprintf(out, "ok\n");
+}
+
+void handle_position(FILE *out, Engine *engine, const char *arg) {
+  Board board;
+  CheckerKind side = White;
+  Variant variant = engine->game_manager.variant;
+  if (strcmp(arg, "start") == 0)
+    board = variant_board(variant);
+  else if (!position_from_id(arg, variant_checker_count(variant), &board,
+                             &side)) {
+    fprintf(out, "error bad position id\n");
+    return;
+  }
+  engine_set_position(engine, &board, side);
+  fprintf(out, "ok\n");
+}
+
+void handle_set(FILE *out, Engine *engine, const char *name, long long val) {
+  if (strcmp(name, "plies") == 0 && val >= 0 && val <= MAX_PLIES)
+    engine->config.plies = val;
+  else if (strcmp(name, "seed") == 0)
+    engine->rng = new_rng(val);
+  else if (strcmp(name, "trials") == 0 && val > 0 && val <= MAX_ROLLOUT_TRIALS)
+    engine->config.rollout_trials = val;
+  else if (strcmp(name, "threads") == 0 && val > 0 &&
+           val <= MAX_ENGINE_THREADS)
+    engine->config.threads = val;
+  else if (strcmp(name, "cubetime") == 0 && val > 0 &&
+           val <= MAX_CUBE_TIME_MS)
+    engine->config.cube_time_ms = val;
+  else if (strcmp(name, "movetime") == 0 && val >= 0 &&
+           val <= MAX_MOVE_TIME_MS)
+    engine->config.move_time_ms = val;
+  else {
+    fprintf(out, "error bad option\n");
+    return;
+  }
+  fprintf(out, "ok\n");
+}
+
+void handle_filter(FILE *out, Engine *engine, const char *args) {
+  int stage, keep;
+  float margin;
+  if (sscanf(args, "%d %d %f", &stage, &keep, &margin) != 3 || stage < 0 ||
+      stage >= MAX_PLIES || keep < 1 || margin < 0) {
+    fprintf(out, "error bad filter\n");
+    return;
+  }
+  engine->config.filters[stage] = (MoveFilter){keep, margin};
+  fprintf(out, "ok\n");
+}
+
+void handle_match(FILE *out, Engine *engine, const char *args) {
+  int length, white_score, red_score;
+  char rule[ENGINE_TOKEN_LEN] = "";
+  int got =
+      sscanf(args, "%d %d %d %31s", &length, &white_score, &red_score, rule);
+  if (got < 3 || length < MONEY_GAME || length > MAX_MATCH_LENGTH ||
+      white_score < 0 || red_score < 0 ||
+      (length != MONEY_GAME &&
+       (white_score >= length || red_score >= length))) {
+    fprintf(out, "error bad match\n");
+    return;
+  }
+
+  MatchState match = new_match_state(length);
+  match.white_score = white_score;
+  match.red_score = red_score;
+  if (strcmp(rule, "crawford") == 0)
+    match.crawford = true;
+  else if (strcmp(rule, "post") == 0)
+    match.post_crawford = true;
+  engine->game_manager.match = match;
+  fprintf(out, "ok\n");
+}
+
+void handle_cube(FILE *out, Engine *engine, const char *args) {
+  int value;
+  char owner;
+  if (sscanf(args, "%d %c", &value, &owner) != 2)
+    owner = '\0';
+  owner = toupper(owner);
+  if (owner == '\0' || value < 1 ||
+      (value & (value - 1)) != 0 ||
+      (owner != NO_OWNER_CHAR && checker_kind_from_char(owner) == None)) {
+    fprintf(out, "error bad cube\n");
+    return;
+  }
+
+  MatchState *match = &engine->game_manager.match;
+  match->cube_value = value;
+  match->cube_owner = checker_kind_from_char(owner);
+  fprintf(out, "ok\n");
+}
+
+// returns false on quit
+bool handle_engine_line(FILE *out, Engine *engine, char *line) {
+  char command[ENGINE_TOKEN_LEN] = "", arg[ENGINE_LINE_LEN] = "";
+  int a = 0, b = 0;
+  long long val = 0;
+  int offset = 0;
+  if (sscanf(line, "%31s%n", command, &offset) < 1)
+    return true;
+  char *rest = line + offset;
+  GameManager *game_manager = &engine->game_manager;
+  // rules and variant are set by earlier lines, every search below uses them
+  use_game_rules(&engine->config, game_manager);
+
+  if (strcmp(command, "quit") == 0) {
+    return false;
+  } else if (strcmp(command, "isready") == 0) {
+    fprintf(out, "readyok\n");
+  } else if (strcmp(command, "position") == 0 &&
+             sscanf(rest, "%255s", arg) == 1) {
+    handle_position(out, engine, arg);
+  } else if (strcmp(command, "id") == 0) {
+    write_id(out, engine);
+  } else if (strcmp(command, "dice") == 0) {
+    if (sscanf(rest, "%d %d", &a, &b) == 2 && a >= 1 && a <= 6 &&
+        b >= 1 && b <= 6) {
+      engine_set_dice(engine, a, b);
+      fprintf(out, "ok\n");
+    } else {
+      fprintf(out, "error bad dice\n");
+    }
+  } else if (strcmp(command, "roll") == 0) {
+    engine_set_dice(engine, rng_die(&engine->rng), rng_die(&engine->rng));
+    fprintf(out, "dice %d %d\n", game_manager->dice_roll.v1,
+            game_manager->dice_roll.v2);
+  } else if (strcmp(command, "eval") == 0) {
+    EvalOutput eval;
+    evaluate_plies(&engine->config, &game_manager->board,
+                   game_manager->curr_player, engine->config.plies, &eval);
+    write_eval(out, "eval", &eval);
+  } else if (strcmp(command, "bestmove") == 0 ||
+             strcmp(command, "play") == 0) {
+    handle_bestmove(out, engine, command[0] == 'p');
+  } else if (strcmp(command, "move") == 0) {
+    handle_move(out, engine, rest);
+  } else if (strcmp(command, "rollout") == 0) {
+    if (sscanf(rest, "%d", &a) < 1 || a <= 0)
+      a = engine->config.rollout_trials;
+    EvalOutput eval;
+    rollout(&engine->config, &game_manager->board, game_manager->curr_player,
+            &game_manager->dice_roll, a, &engine->rng, &eval);
+    char name[ENGINE_TOKEN_LEN];
+    snprintf(name, sizeof(name), "rollout %d", a);
+    write_eval(out, name, &eval);
+  } else if (strcmp(command, "double") == 0) {
+    handle_double(out, engine, sscanf(rest, "%31s", arg) == 1 &&
+                                   strcmp(arg, "rollout") == 0);
+  } else if (strcmp(command, "variant") == 0 &&
+             sscanf(rest, "%31s", arg) == 1) {
+    handle_variant(out, engine, arg);
+  } else if (strcmp(command, "hyper") == 0 &&
+             sscanf(rest, "%255s", arg) == 1) {
+    handle_hyper(out, engine, arg);
+  } else if (strcmp(command, "rules") == 0 &&
+             sscanf(rest, "%31s", arg) == 1) {
+    fprintf(out, rule_set_from_name(arg, &game_manager->rules)
+                     ? "ok\n"
+                     : "error unknown rules\n");
+  } else if (strcmp(command, "filter") == 0) {
+    handle_filter(out, engine, rest);
+  } else if (strcmp(command, "clock") == 0) {
+    handle_clock(out, engine, rest);
+  } else if (strcmp(command, "log") == 0 &&
+             sscanf(rest, "%255s", arg) == 1) {
+    handle_log(out, engine, arg);
+  } else if (strcmp(command, "stats") == 0) {
+    write_search_stats(out, &engine->last_search);
+  } else if (strcmp(command, "match") == 0) {
+    handle_match(out, engine, rest);
+  } else if (strcmp(command, "cube") == 0) {
+    handle_cube(out, engine, rest);
+  } else if (strcmp(command, "met") == 0 &&
+             sscanf(rest, "%d %d", &a, &b) == 2) {
+    fprintf(out, "met %.4f\n", match_equity(a, b, true));
+  } else if (strcmp(command, "mwc") == 0) {
+    EvalOutput eval;
+    evaluate_plies(&engine->config, &game_manager->board,
+                   game_manager->curr_player, engine->config.plies, &eval);
+    if (game_manager->match.length == MONEY_GAME)
+      fprintf(out, "error not a match\n");
+    else
+      fprintf(out, "mwc %.4f\n",
+              eval_match_equity(&eval, &game_manager->match,
+                                game_manager->curr_player));
+  } else if (strcmp(command, "book") == 0 &&
+             sscanf(rest, "%255s", arg) == 1) {
+    handle_book(out, engine, arg);
+  } else if ((strcmp(command, "weights") == 0 ||
+              strcmp(command, "raceweights") == 0) &&
+             sscanf(rest, "%255s", arg) == 1) {
+    handle_weights(out, engine, arg, command[0] == 'r');
+  } else if (strcmp(command, "classes") == 0) {
+    write_class_counts(out, &game_manager->board, game_manager->curr_player);
+  } else if (strcmp(command, "savemet") == 0 &&
+             sscanf(rest, "%255s", arg) == 1) {
+    fprintf(out, save_match_equity(arg) ? "ok\n" : "error can't write\n");
+  } else if (strcmp(command, "set") == 0 &&
+             sscanf(rest, "%31s %lld", arg, &val) == 2) {
+    handle_set(out, engine, arg, val);
+  } else if (strcmp(command, "board") == 0) {
+    dump_position(out, game_manager, PlainText);
+    fprintf(out, ".\n");
+  } else {
+    fprintf(out, "error unknown command '%s'\n", command);
+  }
+  return true;
+}
+
+// reads lines straight from the descriptor, so it knows whether the next
+// command is already buffered
+typedef struct {
+  int fd;
+  char buf[ENGINE_IN_BUF_LEN];
+  int start, end;
+} LineReader;
+
+bool reader_has_line(LineReader *reader) {
+  return memchr(reader->buf + reader->start, '\n',
+                reader->end - reader->start) != NULL;
+}
+
+bool input_pending(LineReader *reader) {
+  if (reader_has_line(reader))
+    return true;
+  struct pollfd pfd = {reader->fd, POLLIN, 0};
+  return poll(&pfd, 1, 0) > 0;
+}
+
+// returns false at the end of input, longer lines are cut to len - 1 chars
+bool read_line(LineReader *reader, char *line, int len) {
+  while (!reader_has_line(reader)) {
+    if (reader->start > 0) {
+      memmove(reader->buf, reader->buf + reader->start,
+              reader->end - reader->start);
+      reader->end -= reader->start;
+      reader->start = 0;
+    }
+    if (reader->end == ENGINE_IN_BUF_LEN)
+      break;
+    ssize_t got = read(reader->fd, reader->buf + reader->end,
+                       ENGINE_IN_BUF_LEN - reader->end);
+    if (got <= 0) {
+      if (reader->end == reader->start)
+        return false;
+      break;
+    }
+    reader->end += got;
+  }
+
+  char *start = reader->buf + reader->start;
+  char *nl = memchr(start, '\n', reader->end - reader->start);
+  int line_len = nl != NULL ? nl - start : reader->end - reader->start;
+  int copy = line_len < len - 1 ? line_len : len - 1;
+  memcpy(line, start, copy);
+  line[copy] = '\0';
+  reader->start += nl != NULL ? line_len + 1 : line_len;
+  return true;
+}
+
+int run_engine(FILE *in, FILE *out) {
+  static char out_buf[ENGINE_OUT_BUF_LEN];
+  setvbuf(out, out_buf, _IOFBF, sizeof(out_buf));
+
+  Engine engine;
+  memset(&engine, 0, sizeof(engine));
+  new_turn_log(&engine.game_manager.turn_log, 0);
+  engine.game_manager.match = new_match_state(MONEY_GAME);
+  init_match_equity();
+  if (load_network(&engine.network, NETWORK_FILE))
+    eval_network = &engine.network;
+  if (load_network(&engine.race_network, RACE_NETWORK_FILE))
+    race_network = &engine.race_network;
+  if (load_opening_book(&engine.book, BOOK_FILE))
+    opening_book = &engine.book;
+  if (load_hyper_database(&engine.hyper, HYPER_FILE))
+    hyper_db = &engine.hyper;
+  engine.config = default_engine_config();
+  engine.rng = new_rng(0);
+  Board board = default_board();
+  engine_set_position(&engine, &board, White);
+
+  static LineReader reader;
+  reader = (LineReader){fileno(in), "", 0, 0};
+  char line[ENGINE_LINE_LEN];
+  while (true) {
+    if (!input_pending(&reader))
+      fflush(out);
+    if (!read_line(&reader, line, sizeof(line)))
+      break;
+    line[strcspn(line, "\r")] = '\0';
+    if (!handle_engine_line(out, &engine, line))
+      break;
+  }
+  fflush(out);
+  if (engine.log != NULL)
+    fclose(engine.log);
+  free_game_manager(&engine.game_manager);
+  return 0;
+}
@@ -0,0 +1,244 @@
+#pragma once
+#include "../headers/eval.h"
+#include "bearoff.c"
+#include "game.c"
+#include "hypergammon.c"
+#include "neural.c"
+#include "position.c"
+#include <math.h>
+#include <stdatomic.h>
+
+#define HOME_SLOTS 6
+#define BAR_SLOT BOARD_SIZE
+
+// trained weights used instead of the heuristic when set
+Network *eval_network = NULL;
+// used for races instead of eval_network when set
+Network *race_network = NULL;
+// a thread playing with its own weights sets these instead of the ones of
+// the process, like the tournament's players
+_Thread_local Network *thread_eval_network = NULL;
+_Thread_local Network *thread_race_network = NULL;
+
+// positions evaluated per class since the start
+atomic_llong class_counts[POSITION_CLASS_COUNT];
+const char *class_names[POSITION_CLASS_COUNT] = {"over", "bearoff", "race",
+                                                 "crashed", "contact"};
+
+typedef struct {
+  int counts[POSITION_SLOT_COUNT];
+  int back, pips, off, outside_pips;
+} SideView;
+
+// checkers of one side seen from its own home, slot 0 is the ace point
+void side_view(Board *board, CheckerKind side, SideView *view) {
+  view->back = -1;
+  view->pips = 0;
+  view->outside_pips = 0;
+  for (int slot = 0; slot < POSITION_SLOT_COUNT; slot++) {
+    int count = slot_count(board, side, slot);
+    view->counts[slot] = count;
+    if (count == 0)
+      continue;
+    view->back = slot;
+    view->pips += count * (slot + 1);
+    if (slot >= HOME_SLOTS)
+      view->outside_pips += count * (slot - HOME_SLOTS + 1);
+  }
+  view->off = side == White ? board->white_out_count : board->red_out_count;
+}
+
+int pip_count(Board *board, CheckerKind side) {
+  SideView view;
+  side_view(board, side, &view);
+  return view.pips;
+}
+
+bool views_in_contact(SideView *a, SideView *b) {
+  return a->back + b->back > BOARD_SIZE - 1;
+}
+
+bool in_contact(Board *board) {
+  SideView white, red;
+  side_view(board, White, &white);
+  side_view(board, Red, &red);
+  return views_in_contact(&white, &red);
+}
+
+float logistic(float x) { return 1.0f / (1.0f + expf(-x)); }
+
+float eval_equity(EvalOutput *out) {
+  return 2 * out->win - 1 + out->win_gammon - out->lose_gammon +
+         out->win_backgammon - out->lose_backgammon;
+}
+
+// switches the point of view to the other player
+void invert_eval(EvalOutput *out) {
+  EvalOutput inverted = {1 - out->win, out->lose_gammon, out->lose_backgammon,
+                         out->win_gammon, out->win_backgammon};
+  *out = inverted;
+}
+
+// chance that a side which hasn't borne off anything gets gammoned
+float gammon_chance(SideView *loser, SideView *winner) {
+  if (loser->off > 0)
+    return 0;
+  return logistic((loser->outside_pips - winner->pips / 2.0f) /
+                  GAMMON_PIP_SCALE);
+}
+
+void evaluate_race(SideView *me, SideView *opp, EvalOutput *out) {
+  float diff = opp->pips - me->pips + RACE_ROLL_PIPS;
+  out->win = logistic(diff * RACE_SCALE / sqrtf(me->pips + opp->pips + 1));
+  out->win_gammon = out->win * gammon_chance(opp, me);
+  out->lose_gammon = (1 - out->win) * gammon_chance(me, opp);
+  out->win_backgammon = 0;
+  out->lose_backgammon = 0;
+}
+
+int home_points(SideView *view) {
+  int count = 0;
+  for (int slot = 0; slot < HOME_SLOTS; slot++)
+    count += view->counts[slot] >= 2;
+  return count;
+}
+
+int longest_prime(SideView *view) {
+  int best = 0, len = 0;
+  for (int slot = 0; slot < BOARD_SIZE; slot++) {
+    len = view->counts[slot] >= 2 ? len + 1 : 0;
+    if (len > best)
+      best = len;
+  }
+  return best;
+}
+
+int blot_count(SideView *view) {
+  int count = 0;
+  for (int slot = 0; slot < BOARD_SIZE; slot++)
+    count += view->counts[slot] == 1;
+  return count;
+}
+
+// points held in the opponent's home board
+int anchor_count(SideView *view) {
+  int count = 0;
+  for (int slot = BOARD_SIZE - HOME_SLOTS; slot < BOARD_SIZE; slot++)
+    count += view->counts[slot] >= 2;
+  return count;
+}
+
+void evaluate_contact(SideView *me, SideView *opp, EvalOutput *out) {
+  int bar_diff = opp->counts[BAR_SLOT] - me->counts[BAR_SLOT];
+  float score =
+      CONTACT_PIP_WEIGHT * (opp->pips - me->pips + RACE_ROLL_PIPS) +
+      CONTACT_HOME_POINT_WEIGHT * (home_points(me) - home_points(opp)) +
+      CONTACT_BLOT_WEIGHT * (blot_count(opp) - blot_count(me)) +
+      CONTACT_BAR_WEIGHT * bar_diff +
+      CONTACT_PRIME_WEIGHT * (longest_prime(me) - longest_prime(opp)) +
+      CONTACT_ANCHOR_WEIGHT * (anchor_count(me) - anchor_count(opp));
+  out->win = logistic(score);
+
+  float me_trapped =
+      me->counts[BAR_SLOT] + me->outside_pips / GAMMON_PIP_SCALE;
+  float opp_trapped =
+      opp->counts[BAR_SLOT] + opp->outside_pips / GAMMON_PIP_SCALE;
+  out->win_gammon = out->win * CONTACT_GAMMON_RATE *
+                    logistic(opp_trapped - me_trapped) * (opp->off == 0);
+  out->lose_gammon = (1 - out->win) * CONTACT_GAMMON_RATE *
+                     logistic(me_trapped - opp_trapped) * (me->off == 0);
+  out->win_backgammon =
+      out->win_gammon * opp->counts[BAR_SLOT] / CHECKER_COUNT;
+  out->lose_backgammon =
+      out->lose_gammon * me->counts[BAR_SLOT] / CHECKER_COUNT;
+}
+
+// checkers left on the bar or in the winner's home board
+bool backgammoned(SideView *loser) {
+  return loser->back >= BOARD_SIZE - HOME_SLOTS;
+}
+
+// one side has borne off everything
+void evaluate_finished(SideView *me, SideView *opp, EvalOutput *out) {
+  bool won = me->back == -1;
+  SideView *loser = won ? opp : me;
+  bool gammon = loser->off == 0;
+  bool backgammon = gammon && backgammoned(loser);
+
+  if (won)
+    *out = (EvalOutput){1, gammon, backgammon, 0, 0};
+  else
+    *out = (EvalOutput){0, 0, 0, gammon, backgammon};
+}
+
+// both sides bear off without contact, exact up to gammons
+void evaluate_bearoff(SideView *me, SideView *opp, EvalOutput *out) {
+  out->win = bearoff_win(me->counts, opp->counts);
+  out->win_gammon = out->win * gammon_chance(opp, me);
+  out->lose_gammon = (1 - out->win) * gammon_chance(me, opp);
+  out->win_backgammon = 0;
+  out->lose_backgammon = 0;
+}
+
+// few checkers left in play besides the ones buried on the lowest points
+bool crashed(SideView *view) {
+  int left = 0;
+  for (int slot = 0; slot < POSITION_SLOT_COUNT; slot++)
+    left += view->counts[slot];
+  return left - view->counts[0] - view->counts[1] <= CRASHED_CHECKERS;
+}
+
+PositionClass classify_views(SideView *me, SideView *opp) {
+  if (me->back == -1 || opp->back == -1)
+    return ClassOver;
+  if (!views_in_contact(me, opp))
+    return me->back < HOME_SLOTS && opp->back < HOME_SLOTS ? ClassBearoff
+                                                           : ClassRace;
+  return crashed(me) || crashed(opp) ? ClassCrashed : ClassContact;
+}
+
+PositionClass classify_position(Board *board, CheckerKind on_roll) {
+  SideView me, opp;
+  side_view(board, on_roll, &me);
+  side_view(board, opposite_checker(on_roll), &opp);
+  return classify_views(&me, &opp);
+}
+
+// routes the position to the cheapest evaluator that handles its class:
+// the bear-off table, the race network and then the general one. Positions
+// in the hypergammon database are exact and skip the classes.
+void evaluate_position(Board *board, CheckerKind on_roll, EvalOutput *out) {
+  if (hyper_db != NULL && hyper_evaluate(hyper_db, board, on_roll, out))
+    return;
+  SideView me, opp;
+  side_view(board, on_roll, &me);
+  side_view(board, opposite_checker(on_roll), &opp);
+  PositionClass class = classify_views(&me, &opp);
+  atomic_fetch_add_explicit(&class_counts[class], 1, memory_order_relaxed);
+  Network *network =
+      thread_eval_network != NULL ? thread_eval_network : eval_network;
+  Network *race =
+      thread_race_network != NULL ? thread_race_network : race_network;
+
+  switch (class) {
+  case ClassOver:
+    evaluate_finished(&me, &opp, out);
+    break;
+  case ClassBearoff:
+    evaluate_bearoff(&me, &opp, out);
+    break;
+  case ClassRace:
+    if (race != NULL)
+      network_evaluate(race, board, on_roll, out);
+    else if (network != NULL)
+      network_evaluate(network, board, on_roll, out);
+    else
+      evaluate_race(&me, &opp, out);
+    break;
+  default:
+    if (network != NULL)
+      network_evaluate(network, board, on_roll, out);
+    else
+      evaluate_contact(&me, &opp, out);
+  }
+}
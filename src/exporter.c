@@ -0,0 +1,186 @@
+#pragma once
+#include "../headers/exporter.h"
+#include "engine.c"
+#include "game.c"
+#include "position_stream.c"
+#include "rng.c"
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  long long games, positions, failed;
+} ExportStats;
+
+// positions of one game are held back until its result is known
+void push_game_record(Vec *records, PositionRecord *record) {
+  if (records->len + 1 > records->cap && vec_extend(records) == 1)
+    exit(NO_HEAP_MEM_EXIT);
+  PositionRecord *data = records->data;
+  data[records->len++] = *record;
+}
+
+bool write_game_records(PositionWriter *writer, Vec *records, Board *end,
+                        int cube_value, ExportStats *stats) {
+  GameManager state;
+  memset(&state, 0, sizeof(state));
+  state.board = *end;
+  WinKind win_kind;
+  CheckerKind winner = check_game_over(&state, &win_kind);
+  int result = winner == None ? NO_RESULT : win_kind * cube_value;
+  if (winner == Red)
+    result = -result;
+
+  PositionRecord *data = records->data;
+  for (int i = 0; i < records->len; i++) {
+    data[i].result = result;
+    if (!write_position_record(writer, &data[i]))
+      return false;
+  }
+  stats->games++;
+  stats->positions += records->len;
+  records->len = 0;
+  return true;
+}
+
+bool push_turn_record(void *records, GameManager *game, TurnEntry *turn,
+                      int t) {
+  PositionRecord record = new_position_record(
+      &game->board, game->variant, game->curr_player, turn->dice1,
+      turn->dice2, t);
+  push_game_record(records, &record);
+  return true;
+}
+
+// one record at the start of every turn of a save file
+bool export_saved_game(PositionWriter *writer, const char *filename,
+                       Vec *records, ExportStats *stats) {
+  GameManager game;
+  ReplayHooks hooks = {push_turn_record, NULL, records};
+  bool success = replay_saved_game(filename, &game, &hooks) &&
+                 (records->len == 0 ||
+                  write_game_records(writer, records, &game.board,
+                                     game.match.cube_value, stats));
+  records->len = 0;
+  return success;
+}
+
+// games of the 0-ply engine against itself
+bool export_selfplay(PositionWriter *writer, long long games, Vec *records,
+                     ExportStats *stats) {
+  EngineConfig policy = default_engine_config();
+  policy.plies = 0;
+  Rng rng = new_rng(time(NULL));
+  PlayList plays;
+  new_play_list(&plays);
+
+  bool success = true;
+  for (long long game = 0; game < games && success; game++) {
+    DiceRoll roll;
+    do {
+      roll = rng_dice_roll(&rng);
+    } while (roll.v1 == roll.v2);
+    Board board = default_board();
+    GameManager state =
+        position_state(&board, roll.v1 < roll.v2 ? Red : White, roll);
+
+    for (int turn = 0; turn < MAX_EXPORT_TURNS; turn++) {
+      PositionRecord record =
+          new_position_record(&state.board, Backgammon, state.curr_player,
+                              state.dice_roll.v1, state.dice_roll.v2, turn);
+      push_game_record(records, &record);
+      EvalOutput eval;
+      int id = choose_play(&policy, &state, &plays, 0, &eval);
+      state.board = play_at(&plays, id)->board;
+      if (check_game_over(&state, NULL) != None)
+        break;
+      state.curr_player = opposite_checker(state.curr_player);
+      state.dice_roll = rng_dice_roll(&rng);
+    }
+    success = write_game_records(writer, records, &state.board, 1, stats);
+  }
+  free_play_list(&plays);
+  return success;
+}
+
+// decodes every chunk through the index and checks every board against the
+// checker count of its record's variant
+int check_position_stream(const char *filename) {
+  static PositionReader reader;
+  static PositionRecord records[RECORDS_PER_CHUNK];
+  if (!open_position_reader(&reader, filename)) {
+    fprintf(stderr, "can't read %s\n", filename);
+    return 1;
+  }
+
+  long long positions = 0, finished = 0, bad = 0;
+  for (uint32_t chunk = 0; chunk < reader.chunk_count; chunk++) {
+    int count = read_position_chunk(&reader, chunk, records);
+    if (count < 0) {
+      fprintf(stderr, "chunk %u is corrupt\n", chunk);
+      close_position_reader(&reader);
+      return 1;
+    }
+    for (int i = 0; i < count; i++) {
+      Board board;
+      Variant variant = records[i].variant;
+      bad += variant > Hypergammon ||
+             !board_from_key(&records[i].key, variant_checker_count(variant),
+                             &board);
+      finished += records[i].result != NO_RESULT;
+    }
+    positions += count;
+  }
+  close_position_reader(&reader);
+  printf("chunks %u positions %lld with result %lld bad boards %lld\n",
+         reader.chunk_count, positions, finished, bad);
+  return bad > 0;
+}
+
+// usage: export <out> [--selfplay <games>] [save file]...
+//        export --check <file>
+int run_exporter(int argc, char **argv) {
+  if (argc == 3 && strcmp(argv[1], EXPORT_CHECK_FLAG) == 0)
+    return check_position_stream(argv[2]);
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <out> [%s <games>] [save file]...\n"
+                    "       %s %s <file>\n",
+            argv[0], EXPORT_SELFPLAY_FLAG, argv[0], EXPORT_CHECK_FLAG);
+    return 1;
+  }
+
+  static PositionWriter writer;
+  if (!open_position_writer(&writer, argv[1])) {
+    fprintf(stderr, "can't write %s\n", argv[1]);
+    return 1;
+  }
+  Vec records;
+  vec_new(&records, sizeof(PositionRecord));
+  if (records.data == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+
+  ExportStats stats = {0, 0, 0};
+  double start = (double)clock() / CLOCKS_PER_SEC;
+  bool write_ok = true;
+  for (int i = 2; i < argc && write_ok; i++) {
+    if (strcmp(argv[i], EXPORT_SELFPLAY_FLAG) == 0 && i + 1 < argc) {
+      write_ok = export_selfplay(&writer, atoll(argv[++i]), &records, &stats);
+    } else if (!export_saved_game(&writer, argv[i], &records, &stats)) {
+      fprintf(stderr, "skipping %s\n", argv[i]);
+      stats.failed++;
+    }
+  }
+  vec_free(&records);
+  write_ok = close_position_writer(&writer) && write_ok;
+
+  double secs = (double)clock() / CLOCKS_PER_SEC - start;
+  printf("games %lld positions %lld failed %lld bytes %llu (%.2f per "
+         "position) %.2fs %.0f positions/s\n",
+         stats.games, stats.positions, stats.failed,
+         (unsigned long long)writer.packed_bytes,
+         stats.positions > 0 ? (double)writer.packed_bytes / stats.positions
+                             : 0,
+         secs, secs > 0 ? stats.positions / secs : 0);
+  if (!write_ok)
+    fprintf(stderr, "can't write %s\n", argv[1]);
+  return write_ok ? 0 : 1;
+}
@@ -1,13 +1,20 @@
+#pragma once
 #include "../headers/game.h"
+#include "../headers/hint.h"
 #include "../headers/vec.h"
 #include "../headers/window.h"
 #include "../headers/window_manager.h"
 
+#include "autosave.c"
 #include "hall_of_fame.c"
+#include "journal.c"
+#include <ctype.h>
 #include <ncurses.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #define FILE_HEADER "BOARD"
@@ -15,7 +22,17 @@
 
 #define MAX_DOUBLET_USES 4
 
-#define WHITE_HOME_START BOARD_SIZE - 5
+// a logged move is its from + MOVE_FROM_OFFSET, its die and whether it hit
+#define MOVE_FROM_BITS 5
+#define MOVE_DIE_BITS 3
+#define MOVE_BITS (MOVE_FROM_BITS + MOVE_DIE_BITS + 1)
+#define MOVE_FROM_OFFSET 8
+// a turn's index word holds its first move above the dice and move count
+#define TURN_FIELD_BITS 3
+#define TURN_FIRST_SHIFT (3 * TURN_FIELD_BITS)
+#define MAX_LOGGED_MOVES (1 << (32 - TURN_FIRST_SHIFT))
+
+#define WHITE_HOME_START BOARD_SIZE - 6
 #define RED_HOME_START 5
 #define home_start(player) player == White ? WHITE_HOME_START : RED_HOME_START
 
@@ -34,9 +51,18 @@
 
 #define CHECKER_COUNT 15
 #define BAR_WIDTH 3
+// "%02d" of the checkers past the ones a point has room for
+#define OVERFLOW_TEXT_LEN 12
 
 #define MAX_FILENAME_LEN 100
 
+#define MONEY_GAME 0
+#define NACKGAMMON_CHECKER_COUNT 15
+#define HYPERGAMMON_CHECKER_COUNT 3
+#define HOUSE_RULES_NAME "house"
+#define STANDARD_RULES_NAME "standard"
+#define NO_OWNER_CHAR '-'
+
 #define STATS_LINES_COUNT 3
 #define STATS_GAP 3
 #define STATS_TOP_BOT_MARGIN                                                   \
@@ -45,6 +71,8 @@
 #define STATS_WHITE_Y SIDE_WIN_HEIGHT - STATS_TOP_BOT_MARGIN - STATS_LINES_COUNT
 #define STATS_RED_Y STATS_TOP_BOT_MARGIN
 
+#define STATS_MATCH_Y STATS_RED_Y + STATS_LINES_COUNT + 1
+
 #define STATS_ROLL_X 4
 #define STATS_ROLL_DOUBLET_X 1
 
@@ -54,6 +82,13 @@
 #define checker_char(checker_kind)                                             \
   checker_kind == White ? WHITE_CHECKER_CHAR : RED_CHECKER_CHAR
 
+// wall time for budgets and timings, unaffected by clock changes
+double monotonic_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 typedef enum { None, White, Red } CheckerKind;
 
 CheckerKind opposite_checker(CheckerKind checker_kind) {
@@ -142,10 +177,23 @@ BoardPoint new_board_point(CheckerKind checker_kind, int checker_count) {
   return res;
 }
 
-void print_overflowing_checkers(WinWrapper *win_wrapper,
-                                BoardPoint *board_point, int y, int x) {
-  mv_printf_yx(win_wrapper, y, x, "%02d",
-               board_point->checker_count - BOARD_ROW_COUNT);
+// Where the board is drawn, the ncurses window or a text buffer. put writes
+// a string at y, x of the target and width is the target's width.
+typedef struct {
+  void (*put)(void *target, int y, int x, const char *str);
+  void *target;
+  int width;
+} BoardCanvas;
+
+void canvas_put_char(BoardCanvas *canvas, int y, int x, char c) {
+  char str[2] = {c, '\0'};
+  canvas->put(canvas->target, y, x, str);
+}
+
+// same placement as mv_printf_centered
+void canvas_put_centered(BoardCanvas *canvas, int y, const char *str) {
+  int margin = (canvas->width - (int)strlen(str) - 1) / 2;
+  canvas->put(canvas->target, y, margin + 1, str);
 }
 
 void get_yx_for_print_point(int id, int *y, int *x_out, int *move_by_out) {
@@ -169,8 +217,14 @@ void get_yx_for_print_point(int id, int *y, int *x_out, int *move_by_out) {
   }
 }
 
-void print_point_checkers(WinWrapper *win_wrapper, BoardPoint *board_point,
-                          int *y, int x, int move_by) {
+// a point with more checkers than fit draws one less and the number of the
+// ones past BOARD_ROW_COUNT after them
+void draw_board_point(BoardCanvas *canvas, BoardPoint *board_point, int id) {
+  if (board_point->checker_count == 0 || board_point->checker_kind == None)
+    return;
+
+  int x, y, move_by;
+  get_yx_for_print_point(id, &y, &x, &move_by);
 
   char out = checker_char(board_point->checker_kind);
   int draw_count = board_point->checker_count;
@@ -178,29 +232,21 @@ void print_point_checkers(WinWrapper *win_wrapper, BoardPoint *board_point,
     draw_count = BOARD_ROW_COUNT - 1;
 
   for (int i = 0; i < draw_count; i++) {
-    mv_printf_yx(win_wrapper, *y, x, "%c", out);
-    *y += move_by;
+    canvas_put_char(canvas, y, x, out);
+    y += move_by;
   }
-}
-
-void print_board_point(WinWrapper *win_wrapper, BoardPoint *board_point,
-                       int id) {
-
-  if (board_point->checker_count == 0 || board_point->checker_kind == None)
-    return;
-
-  int x, y, move_by;
-  get_yx_for_print_point(id, &y, &x, &move_by);
-
-  print_point_checkers(win_wrapper, board_point, &y, x, move_by);
 
   if (x > BOARD_WIDTH / 2)
     x -= 1;
-  if (board_point->checker_count > BOARD_ROW_COUNT)
-    print_overflowing_checkers(win_wrapper, board_point, y, x);
+  if (board_point->checker_count > BOARD_ROW_COUNT) {
+    char overflow[OVERFLOW_TEXT_LEN];
+    snprintf(overflow, sizeof(overflow), "%02d",
+             board_point->checker_count - BOARD_ROW_COUNT);
+    canvas->put(canvas->target, y, x, overflow);
+  }
 }
 
-void print_checkers_on_bar(WinWrapper *win_wrapper, BoardPoint *board_point) {
+void draw_checkers_on_bar(BoardCanvas *canvas, BoardPoint *board_point) {
   if (board_point->checker_count == 0 || board_point->checker_kind == None)
     return;
 
@@ -218,8 +264,8 @@ void print_checkers_on_bar(WinWrapper *win_wrapper, BoardPoint *board_point) {
     int col = i % BAR_WIDTH;
     int row = i / BAR_WIDTH;
 
-    mv_printf_yx(win_wrapper, start_y + row * move_dir, BOARD_WIDTH / 2 + col,
-                 "%c", out);
+    canvas_put_char(canvas, start_y + row * move_dir, BOARD_WIDTH / 2 + col,
+                    out);
   }
 }
 
@@ -275,53 +321,190 @@ void turn_entry_add_move(TurnEntry *turn_entry, int from, int by,
   turn_entry->move_count++;
 }
 
+// whether the turn can be packed into a TurnLog
+bool turn_entry_fits(TurnEntry *turn_entry) {
+  int field_max = (1 << TURN_FIELD_BITS) - 1;
+  if (turn_entry->dice1 < 0 || turn_entry->dice1 > field_max ||
+      turn_entry->dice2 < 0 || turn_entry->dice2 > field_max ||
+      turn_entry->move_count < 0)
+    return false;
+  for (int i = 0; i < turn_entry->move_count; i++) {
+    MoveEntry *move = &turn_entry->moves[i];
+    if (move->from < -MOVE_FROM_OFFSET || move->from >= BOARD_SIZE ||
+        move->by < 0 || move->by >= 1 << MOVE_DIE_BITS)
+      return false;
+  }
+  return true;
+}
+
+// Turns are kept packed, a game of 60 turns takes well under a kilobyte.
+// Every turn has an index word with its first move, dice and move count,
+// the moves of all turns follow each other in a stream of MOVE_BITS fields.
 typedef struct {
-  Vec vec;
+  Vec turns;
+  Vec move_words;
+  int move_len;
   int trav_turn_id, trav_move_id;
 } TurnLog;
 
+void new_turn_log_in(TurnLog *turn_log_out, int cap, Arena *arena) {
+  Vec turns, move_words;
+  vec_in_arena(&turns, sizeof(uint32_t), cap > 0 ? cap : DEFAULT_CAP, arena);
+  vec_in_arena(&move_words, sizeof(uint64_t), DEFAULT_CAP, arena);
+  if (turns.data == NULL || move_words.data == NULL) {
+    exit(NO_HEAP_MEM_EXIT);
+  }
+  *turn_log_out = (TurnLog){turns, move_words, 0, 0, -1};
+}
+
 void new_turn_log(TurnLog *turn_log_out, int cap) {
-  Vec vec;
-  if (cap <= 0) {
-    vec_new(&vec, sizeof(TurnEntry));
-  } else {
-    vec_with_cap(&vec, sizeof(TurnEntry), cap);
+  new_turn_log_in(turn_log_out, cap, NULL);
+}
+
+void free_turn_log(TurnLog *turn_log) {
+  if (turn_log->turns.data != NULL)
+    vec_free(&turn_log->turns);
+  if (turn_log->move_words.data != NULL)
+    vec_free(&turn_log->move_words);
+  turn_log->move_len = 0;
+}
+
+void clear_turn_log(TurnLog *turn_log) {
+  turn_log->turns.len = 0;
+  turn_log->move_words.len = 0;
+  turn_log->move_len = 0;
+}
+
+int turn_log_len(TurnLog *turn_log) { return turn_log->turns.len; }
+
+// bytes the log takes in memory, without the spare capacity
+size_t turn_log_bytes(TurnLog *turn_log) {
+  return sizeof(TurnLog) + turn_log->turns.len * sizeof(uint32_t) +
+         turn_log->move_words.len * sizeof(uint64_t);
+}
+
+uint32_t pack_turn(int first_move, int dice1, int dice2, int move_count) {
+  return (uint32_t)first_move << TURN_FIRST_SHIFT |
+         dice1 << (2 * TURN_FIELD_BITS) | dice2 << TURN_FIELD_BITS |
+         move_count;
+}
+
+uint32_t turn_word(TurnLog *turn_log, int id) {
+  uint32_t *data = turn_log->turns.data;
+  return data[id];
+}
+
+int turn_first_move(uint32_t word) { return word >> TURN_FIRST_SHIFT; }
+
+int turn_field(uint32_t word, int field) {
+  return word >> (field * TURN_FIELD_BITS) & ((1 << TURN_FIELD_BITS) - 1);
+}
+
+int turn_move_count(TurnLog *turn_log, int id) {
+  if (id < 0 || id >= turn_log->turns.len)
+    return 0;
+  return turn_field(turn_word(turn_log, id), 0);
+}
+
+uint32_t pack_move(int from, int by, bool hit_enemy) {
+  return (uint32_t)(from + MOVE_FROM_OFFSET) |
+         by << MOVE_FROM_BITS | hit_enemy << (MOVE_FROM_BITS + MOVE_DIE_BITS);
+}
+
+MoveEntry unpack_move(uint32_t bits) {
+  return (MoveEntry){(int)(bits & ((1 << MOVE_FROM_BITS) - 1)) -
+                         MOVE_FROM_OFFSET,
+                     bits >> MOVE_FROM_BITS & ((1 << MOVE_DIE_BITS) - 1),
+                     bits >> (MOVE_FROM_BITS + MOVE_DIE_BITS) & 1};
+}
+
+// a field can straddle two words
+uint32_t move_bits_at(TurnLog *turn_log, int id) {
+  uint64_t *words = turn_log->move_words.data;
+  long long bit = (long long)id * MOVE_BITS;
+  int word = bit / 64, shift = bit % 64;
+  uint64_t bits = words[word] >> shift;
+  if (shift + MOVE_BITS > 64)
+    bits |= words[word + 1] << (64 - shift);
+  return bits & ((1 << MOVE_BITS) - 1);
+}
+
+void push_move_bits(TurnLog *turn_log, uint32_t bits) {
+  long long bit = (long long)turn_log->move_len * MOVE_BITS;
+  int words_needed = (bit + MOVE_BITS + 63) / 64;
+  Vec *move_words = &turn_log->move_words;
+  while (move_words->cap < words_needed) {
+    if (vec_extend(move_words) == 1)
+      exit(NO_HEAP_MEM_EXIT);
   }
-  if (vec.data == NULL) {
+  uint64_t *words = move_words->data;
+  while (move_words->len < words_needed)
+    words[move_words->len++] = 0;
+
+  int word = bit / 64, shift = bit % 64;
+  words[word] |= (uint64_t)bits << shift;
+  if (shift + MOVE_BITS > 64)
+    words[word + 1] |= (uint64_t)bits >> (64 - shift);
+  turn_log->move_len++;
+}
+
+// drops the moves from move_len on, the freed bits have to read as zero
+void truncate_moves(TurnLog *turn_log, int move_len) {
+  long long bit = (long long)move_len * MOVE_BITS;
+  int word = bit / 64, shift = bit % 64;
+  uint64_t *words = turn_log->move_words.data;
+  turn_log->move_words.len = word + (shift > 0);
+  if (shift > 0)
+    words[word] &= ((uint64_t)1 << shift) - 1;
+  turn_log->move_len = move_len;
+}
+
+void turn_log_add_move(TurnLog *turn_log, int from, int by, bool hit_enemy) {
+  int last = turn_log->turns.len - 1;
+  if (last < 0 || turn_log->move_len >= MAX_LOGGED_MOVES)
     exit(NO_HEAP_MEM_EXIT);
-  }
-  *turn_log_out = (TurnLog){vec, 0, -1};
+  uint32_t word = turn_word(turn_log, last);
+  push_move_bits(turn_log, pack_move(from, by, hit_enemy));
+  uint32_t *data = turn_log->turns.data;
+  data[last] = word + 1;
 }
 
 void push_to_turn_log(TurnLog *turn_log, TurnEntry *turn_entry) {
-  if (turn_log->vec.len + 1 > turn_log->vec.cap) {
-    if (vec_extend(&turn_log->vec) == 1) {
+  if (turn_log->turns.len + 1 > turn_log->turns.cap) {
+    if (vec_extend(&turn_log->turns) == 1) {
       exit(NO_HEAP_MEM_EXIT);
       return;
     }
   }
 
-  TurnEntry *data = turn_log->vec.data;
-  data[turn_log->vec.len] = *turn_entry;
-  turn_log->vec.len++;
-}
-
-TurnEntry *turn_at(TurnLog *turn_log, int id) {
-  if (id < 0 || id >= turn_log->vec.len)
-    return NULL;
-  TurnEntry *data = turn_log->vec.data;
-  return &data[id];
+  uint32_t *data = turn_log->turns.data;
+  data[turn_log->turns.len] =
+      pack_turn(turn_log->move_len, turn_entry->dice1, turn_entry->dice2, 0);
+  turn_log->turns.len++;
+  for (int i = 0; i < turn_entry->move_count; i++) {
+    MoveEntry *move = &turn_entry->moves[i];
+    turn_log_add_move(turn_log, move->from, move->by, move->hit_enemy);
+  }
 }
 
-TurnEntry *turn_log_last_turn(TurnLog *turn_log) {
-  int id = turn_log->vec.len - 1;
-  return turn_at(turn_log, id);
+// unpacks turn id into turn_entry, false if there is no such turn
+bool turn_at(TurnLog *turn_log, int id, TurnEntry *turn_entry) {
+  if (id < 0 || id >= turn_log->turns.len)
+    return false;
+  uint32_t word = turn_word(turn_log, id);
+  turn_entry->dice1 = turn_field(word, 2);
+  turn_entry->dice2 = turn_field(word, 1);
+  turn_entry->move_count = turn_field(word, 0);
+  for (int i = 0; i < turn_entry->move_count; i++)
+    turn_entry->moves[i] =
+        unpack_move(move_bits_at(turn_log, turn_first_move(word) + i));
+  return true;
 }
 
 bool trav_on_end(TurnLog *turn_log) {
-  return turn_log->trav_turn_id + 1 >= turn_log->vec.len &&
+  return turn_log->trav_turn_id + 1 >= turn_log->turns.len &&
          turn_log->trav_move_id + 1 >=
-             turn_at(turn_log, turn_log->trav_turn_id)->move_count;
+             turn_move_count(turn_log, turn_log->trav_turn_id);
 }
 
 bool trav_on_start(TurnLog *turn_log) {
@@ -342,8 +525,8 @@ bool trav_next_move(TurnLog *turn_log) {
 
   turn_log->trav_move_id++;
 
-  TurnEntry *curr_turn = turn_at(turn_log, turn_log->trav_turn_id);
-  bool new_turn = turn_log->trav_move_id >= curr_turn->move_count;
+  bool new_turn = turn_log->trav_move_id >=
+                  turn_move_count(turn_log, turn_log->trav_turn_id);
 
   if (new_turn) {
     turn_log->trav_turn_id++;
@@ -361,23 +544,23 @@ bool trav_prev_move(TurnLog *turn_log) {
 
   if (new_turn) {
     turn_log->trav_turn_id--;
-    TurnEntry *turn_entry = turn_at(turn_log, turn_log->trav_turn_id);
-    turn_log->trav_move_id = turn_entry->move_count - 1;
+    turn_log->trav_move_id =
+        turn_move_count(turn_log, turn_log->trav_turn_id) - 1;
   }
 
   return new_turn;
 }
 
-MoveEntry *trav_curr_move(TurnLog *turn_log) {
-  TurnEntry *turn_entry = turn_at(turn_log, turn_log->trav_turn_id);
-  return &turn_entry->moves[turn_log->trav_move_id];
+MoveEntry trav_curr_move(TurnLog *turn_log) {
+  uint32_t word = turn_word(turn_log, turn_log->trav_turn_id);
+  return unpack_move(
+      move_bits_at(turn_log, turn_first_move(word) + turn_log->trav_move_id));
 }
 
 void trav_goto_end(TurnLog *turn_log) {
-  if (turn_log->vec.len > 0)
-    turn_log->trav_turn_id = turn_log->vec.len - 1;
-  turn_log->trav_move_id =
-      turn_at(turn_log, turn_log->trav_turn_id)->move_count;
+  if (turn_log->turns.len > 0)
+    turn_log->trav_turn_id = turn_log->turns.len - 1;
+  turn_log->trav_move_id = turn_move_count(turn_log, turn_log->trav_turn_id);
   if (turn_log->trav_move_id >= 0)
     turn_log->trav_move_id--;
 }
@@ -388,9 +571,11 @@ void trav_goto_start(TurnLog *turn_log) {
 }
 
 void serialize_turn_log(TurnLog *turn_log, FILE *fp) {
-  fprintf(fp, "\n%s len:%d\n", TURN_LOG_HEADER, turn_log->vec.len);
-  for (int i = 0; i < turn_log->vec.len; i++) {
-    serialize_turn_entry(turn_at(turn_log, i), fp);
+  fprintf(fp, "\n%s len:%d\n", TURN_LOG_HEADER, turn_log->turns.len);
+  TurnEntry turn_entry;
+  for (int i = 0; i < turn_log->turns.len; i++) {
+    turn_at(turn_log, i, &turn_entry);
+    serialize_turn_entry(&turn_entry, fp);
   }
 }
 
@@ -401,12 +586,17 @@ bool deserialize_turn_log(TurnLog *turn_log, FILE *fp) {
   if (scanned < 2 || strcmp(header, TURN_LOG_HEADER) != 0)
     return false;
   new_turn_log(turn_log, len);
-  turn_log->vec.len = len;
 
+  TurnEntry turn_entry;
   for (int i = 0; i < len; i++) {
-    if (!deserialize_turn_entry(turn_at(turn_log, i), fp))
+    if (!deserialize_turn_entry(&turn_entry, fp) ||
+        !turn_entry_fits(&turn_entry))
       return false;
+    push_to_turn_log(turn_log, &turn_entry);
   }
+  // a loaded log rarely grows much, so it only keeps what it uses
+  if (vec_shrink(&turn_log->move_words) == 1)
+    exit(NO_HEAP_MEM_EXIT);
   return true;
 }
 
@@ -446,20 +636,76 @@ void add_checker_to_bar(Board *board, CheckerKind checker_kind) {
     board->white_bar.checker_count++;
 }
 
-Board default_board() {
+// the same checkers on every point and bar, an empty point may still hold
+// the kind it had last
+bool same_board(Board *a, Board *b) {
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    BoardPoint *x = &a->board_points[i], *y = &b->board_points[i];
+    if (x->checker_count != y->checker_count ||
+        (x->checker_count > 0 && x->checker_kind != y->checker_kind))
+      return false;
+  }
+  return a->white_bar.checker_count == b->white_bar.checker_count &&
+         a->red_bar.checker_count == b->red_bar.checker_count;
+}
+
+typedef enum { Backgammon, Nackgammon, Hypergammon } Variant;
+
+const char *variant_names[] = {"backgammon", "nackgammon", "hypergammon"};
+
+bool variant_from_name(const char *name, Variant *variant) {
+  for (int i = Backgammon; i <= Hypergammon; i++) {
+    if (strcmp(name, variant_names[i]) == 0) {
+      *variant = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+int variant_checker_count(Variant variant) {
+  switch (variant) {
+  case Nackgammon:
+    return NACKGAMMON_CHECKER_COUNT;
+  case Hypergammon:
+    return HYPERGAMMON_CHECKER_COUNT;
+  default:
+    return CHECKER_COUNT;
+  }
+}
+
+// White's starting points and counts, Red's are mirrored
+Board mirrored_start_board(const int *positions, const int *counts,
+                           int len) {
   Board board = empty_board();
+  for (int i = 0; i < len; i++) {
+    set_checkers(&board, positions[i], White, counts[i]);
+    set_checkers(&board, BOARD_SIZE - positions[i] - 1, Red, counts[i]);
+  }
+  return board;
+}
+
+Board default_board() {
   int default_board_positions[] = {0, 11, 16, 18};
   int default_board_checker_counts[] = {2, 5, 3, 5};
   int len =
       sizeof(default_board_positions) / sizeof(default_board_positions[0]);
+  return mirrored_start_board(default_board_positions,
+                              default_board_checker_counts, len);
+}
 
-  for (int i = 0; i < len; i++) {
-    set_checkers(&board, default_board_positions[i], White,
-                 default_board_checker_counts[i]);
-    set_checkers(&board, BOARD_SIZE - default_board_positions[i] - 1, Red,
-                 default_board_checker_counts[i]);
+Board variant_board(Variant variant) {
+  if (variant == Nackgammon) {
+    int positions[] = {0, 1, 11, 16, 18};
+    int counts[] = {2, 2, 4, 3, 4};
+    return mirrored_start_board(positions, counts, 5);
   }
-  return board;
+  if (variant == Hypergammon) {
+    int positions[] = {0, 1, 2};
+    int counts[] = {1, 1, 1};
+    return mirrored_start_board(positions, counts, 3);
+  }
+  return default_board();
 }
 
 void add_to_point(Board *board, int pos, CheckerKind checker_kind,
@@ -487,14 +733,56 @@ void add_to_out(Board *board, CheckerKind checker_kind, int d_count) {
     board->white_out_count += d_count;
 }
 
+typedef enum { NoWin, SingleWin, GammonWin, BackgammonWin } WinKind;
+
+// score and cube of the match the game belongs to, length is MONEY_GAME for
+// a single game without a match
 typedef struct {
+  int length;
+  int white_score, red_score;
+
+  int cube_value;
+  // None while the cube is in the middle
+  CheckerKind cube_owner;
+
+  bool crawford, post_crawford;
+} MatchState;
+
+MatchState new_match_state(int length) {
+  return (MatchState){length, 0, 0, 1, None, false, false};
+}
+
+// house rules force hitting a blot the roll reaches and bearing off when
+// possible, standard rules force using both dice, or else the larger one
+typedef enum { HouseRules, StandardRules } RuleSet;
+
+struct GameManager {
   Board board;
 
   CheckerKind curr_player;
   DiceRoll dice_roll;
 
   TurnLog turn_log;
-} GameManager;
+  MatchState match;
+  RuleSet rules;
+  Variant variant;
+  // the side the computer plays, None when two people play
+  CheckerKind computer;
+};
+
+const char *rule_set_name(RuleSet rules) {
+  return rules == StandardRules ? STANDARD_RULES_NAME : HOUSE_RULES_NAME;
+}
+
+bool rule_set_from_name(const char *name, RuleSet *rules) {
+  if (strcmp(name, HOUSE_RULES_NAME) == 0)
+    *rules = HouseRules;
+  else if (strcmp(name, STANDARD_RULES_NAME) == 0)
+    *rules = StandardRules;
+  else
+    return false;
+  return true;
+}
 
 GameManager new_game_manager() {
   CheckerKind curr_player = White;
@@ -509,22 +797,87 @@ GameManager new_game_manager() {
   TurnLog turn_log;
   new_turn_log(&turn_log, 0);
 
-  GameManager game_manager = {default_board(), curr_player, dice_roll,
-                              turn_log};
+  GameManager game_manager = {default_board(), curr_player,
+                              dice_roll,       turn_log,
+                              new_match_state(MONEY_GAME), HouseRules,
+                              Backgammon,      None};
   return game_manager;
 }
 
 void free_game_manager(GameManager *game_manager) {
-  vec_free(&game_manager->turn_log.vec);
+  free_turn_log(&game_manager->turn_log);
+}
+
+int match_score(MatchState *match, CheckerKind player) {
+  return player == White ? match->white_score : match->red_score;
+}
+
+// points the player still needs, only meaningful in match play
+int match_away(MatchState *match, CheckerKind player) {
+  return match->length - match_score(match, player);
+}
+
+bool match_over(MatchState *match) {
+  return match->length != MONEY_GAME &&
+         (match->white_score >= match->length ||
+          match->red_score >= match->length);
+}
+
+bool can_double(MatchState *match, CheckerKind player) {
+  if (match->length == MONEY_GAME || match->crawford || match_over(match))
+    return false;
+  if (match->cube_owner != None && match->cube_owner != player)
+    return false;
+  // the player already wins the match with the current cube
+  return match_away(match, player) > match->cube_value;
+}
+
+void accept_double(MatchState *match, CheckerKind taker) {
+  match->cube_value *= 2;
+  match->cube_owner = taker;
+}
+
+int game_points(MatchState *match, WinKind win_kind) {
+  return match->cube_value * win_kind;
+}
+
+// scores the game and sets up the cube and the Crawford rule for the next one
+void award_points(MatchState *match, CheckerKind winner, int points) {
+  bool was_one_away = match->length != MONEY_GAME &&
+                      (match_away(match, White) == 1 ||
+                       match_away(match, Red) == 1);
+  if (winner == White)
+    match->white_score += points;
+  else
+    match->red_score += points;
+
+  match->cube_value = 1;
+  match->cube_owner = None;
+  if (match->crawford) {
+    match->crawford = false;
+    match->post_crawford = true;
+  } else if (!was_one_away && !match->post_crawford &&
+             (match_away(match, White) == 1 || match_away(match, Red) == 1)) {
+    match->crawford = true;
+  }
+}
+
+// next game of the match, the current one has to be scored already
+void new_match_game(GameManager *game_manager) {
+  MatchState match = game_manager->match;
+  RuleSet rules = game_manager->rules;
+  Variant variant = game_manager->variant;
+  free_game_manager(game_manager);
+  *game_manager = new_game_manager();
+  game_manager->match = match;
+  game_manager->rules = rules;
+  game_manager->variant = variant;
+  game_manager->board = variant_board(variant);
 }
 
 void game_add_move_entry(GameManager *game_manager, int from, int by,
                          bool hit_enemy) {
-  TurnEntry *turn_entry = turn_log_last_turn(&game_manager->turn_log);
-  if (turn_entry == NULL)
-    exit(NO_HEAP_MEM_EXIT);
-
-  turn_entry_add_move(turn_entry, from, by, hit_enemy);
+  turn_log_add_move(&game_manager->turn_log, from, by, hit_enemy);
 }
 
 bool serialize_board_points(Board *board, FILE *fp) {
@@ -564,12 +917,21 @@ void serialize_player_roll(GameManager *game_manager, FILE *fp) {
           dice_roll->used1, dice_roll->used2, dice_roll->doublet_times_used);
 }
 
-bool serialize_game(GameManager *game_manager, char *filename) {
-  FILE *fp = fopen(filename, "w");
+char owner_char(CheckerKind checker_kind) {
+  if (checker_kind == None)
+    return NO_OWNER_CHAR;
+  return checker_char(checker_kind);
+}
 
-  if (fp == NULL)
-    return false;
+void serialize_match(MatchState *match, FILE *fp) {
+  fprintf(fp, "match len:%d score:%d:%d cube:%d owner:%c crawford:%d:%d\n",
+          match->length, match->white_score, match->red_score,
+          match->cube_value, owner_char(match->cube_owner), match->crawford,
+          match->post_crawford);
+}
 
+// writes a whole save file
+bool write_game(GameManager *game_manager, FILE *fp) {
   Board *board = &game_manager->board;
   fprintf(fp, "%s\n", FILE_HEADER);
 
@@ -577,13 +939,108 @@ bool serialize_game(GameManager *game_manager, char *filename) {
     return false;
 
   serialize_player_roll(game_manager, fp);
+  serialize_match(&game_manager->match, fp);
+  if (game_manager->rules == StandardRules)
+    fprintf(fp, "rules %s\n", STANDARD_RULES_NAME);
+  if (game_manager->variant != Backgammon)
+    fprintf(fp, "variant %s\n", variant_names[game_manager->variant]);
+  if (game_manager->computer != None)
+    fprintf(fp, "computer %c\n", checker_char(game_manager->computer));
 
   serialize_turn_log(&game_manager->turn_log, fp);
+  return true;
+}
 
+bool serialize_game(GameManager *game_manager, char *filename) {
+  FILE *fp = fopen(filename, "w");
+
+  if (fp == NULL)
+    return false;
+
+  bool success = write_game(game_manager, fp);
   fclose(fp);
+  return success;
+}
+
+// writes the saves of the UI, started with the first one
+Autosave game_autosave;
+
+// Serializes the game in memory and queues it for the writer thread. A
+// save the player asked for waits for a free slot, an autosave is dropped
+// when the writer is behind. Failures of the write show up later through
+// report_save_failure.
+bool queue_game_save(GameManager *game_manager, char *filename, bool wait) {
+  if (!game_autosave.running && !start_autosave(&game_autosave))
+    return !wait || serialize_game(game_manager, filename);
+  if (strlen(filename) >= MAX_SAVE_PATH)
+    return false;
+  SaveSlot *slot = take_save_slot(&game_autosave, wait);
+  if (slot == NULL)
+    return true;
+
+  char *data = NULL;
+  size_t len = 0;
+  FILE *fp = open_memstream(&data, &len);
+  if (fp == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  bool ok = write_game(game_manager, fp);
+  fclose(fp);
+  if (!ok) {
+    free(data);
+    submit_free_slot(&game_autosave, slot);
+    return false;
+  }
+  free(slot->data);
+  slot->data = data;
+  slot->len = len;
+  strcpy(slot->filename, filename);
+  submit_save_slot(&game_autosave, slot);
   return true;
 }
 
+void report_save_failure(WinManager *win_manager) {
+  char filename[MAX_SAVE_PATH];
+  if (take_save_failure(&game_autosave, filename))
+    printf_centered_nl(&win_manager->io_win, "Failed to access '%s'",
+                       filename);
+}
+
+// the game played in the UI, see headers/journal.h
+Journal game_journal;
+
+// starts the journal over from the game as it is, resume tells whether
+// the current turn is already in its log
+void journal_game(GameManager *game_manager, bool resume) {
+  if (!game_journal.open && !open_journal(&game_journal, JOURNAL_FILE))
+    return;
+  FILE *fp = start_journal_snapshot(&game_journal);
+  if (fp == NULL)
+    return;
+  fprintf(fp, "%s resume:%d\n", JOURNAL_HEADER, resume);
+  bool ok = write_game(game_manager, fp);
+  fprintf(fp, "\n");
+  if (!commit_journal_snapshot(&game_journal, fp) || !ok)
+    close_journal(&game_journal, false);
+}
+
+void journal_turn(GameManager *game_manager) {
+  if (game_journal.open)
+    journal_append(&game_journal, "turn %c %d %d\n",
+                   checker_char(game_manager->curr_player),
+                   game_manager->dice_roll.v1, game_manager->dice_roll.v2);
+}
+
+void journal_move(int from, int by) {
+  if (game_journal.open)
+    journal_append(&game_journal, "move %d %d\n", from, by);
+}
+
+void journal_cube(MatchState *match) {
+  if (game_journal.open)
+    journal_append(&game_journal, "cube %d %c\n", match->cube_value,
+                   owner_char(match->cube_owner));
+}
+
 CheckerKind checker_kind_from_char(char c) {
   switch (c) {
   case WHITE_CHECKER_CHAR:
@@ -688,6 +1145,54 @@ bool scan_player_roll(GameManager *game_manager, FILE *fp) {
   return true;
 }
 
+// saves from before match play have no match line and are money games
+bool scan_match(MatchState *match, FILE *fp) {
+  *match = new_match_state(MONEY_GAME);
+  int crawford, post_crawford;
+  char owner;
+  int scanned = fscanf(fp, "match len:%d score:%d:%d cube:%d owner:%c "
+                           "crawford:%d:%d\n",
+                       &match->length, &match->white_score, &match->red_score,
+                       &match->cube_value, &owner, &crawford, &post_crawford);
+  if (scanned <= 0)
+    return true;
+  if (scanned < 7 || match->cube_value < 1)
+    return false;
+
+  match->cube_owner = checker_kind_from_char(owner);
+  match->crawford = crawford;
+  match->post_crawford = post_crawford;
+  return owner == NO_OWNER_CHAR || match->cube_owner != None;
+}
+
+// saves without a rules line are played under the house rules
+bool scan_rules(RuleSet *rules, FILE *fp) {
+  char name[MAX_INPUT_LEN];
+  *rules = HouseRules;
+  if (fscanf(fp, "rules %19s\n", name) <= 0)
+    return true;
+  return rule_set_from_name(name, rules);
+}
+
+// saves without a variant line are backgammon
+bool scan_variant(Variant *variant, FILE *fp) {
+  char name[MAX_INPUT_LEN];
+  *variant = Backgammon;
+  if (fscanf(fp, "variant %19s\n", name) <= 0)
+    return true;
+  return variant_from_name(name, variant);
+}
+
+// saves without a computer line are between two people
+bool scan_computer(CheckerKind *computer, FILE *fp) {
+  char c;
+  *computer = None;
+  if (fscanf(fp, "computer %c\n", &c) <= 0)
+    return true;
+  *computer = checker_kind_from_char(c);
+  return *computer != None;
+}
+
 bool scan_game_board(GameManager *game_manager, FILE *fp) {
   Board board = empty_board();
 
@@ -706,9 +1211,24 @@ bool scan_game_board(GameManager *game_manager, FILE *fp) {
     return false;
   if (!scan_player_roll(game_manager, fp))
     return false;
+  if (!scan_match(&game_manager->match, fp))
+    return false;
+  if (!scan_rules(&game_manager->rules, fp))
+    return false;
+  if (!scan_variant(&game_manager->variant, fp))
+    return false;
+  if (!scan_computer(&game_manager->computer, fp))
+    return false;
   game_manager->board = board;
 
-  return white_count + red_count == 2 * CHECKER_COUNT;
+  int checkers = variant_checker_count(game_manager->variant);
+  return white_count == checkers && red_count == checkers;
+}
+
+// reads a whole save file, without reporting anything
+bool read_game(GameManager *out_game, FILE *fp) {
+  return scan_game_board(out_game, fp) &&
+         deserialize_turn_log(&out_game->turn_log, fp);
 }
 
 bool deserialize_game(WinManager *win_manager, GameManager *out_game,
@@ -722,10 +1242,7 @@ bool deserialize_game(WinManager *win_manager, GameManager *out_game,
     return false;
   }
 
-  int success = scan_game_board(out_game, fp) &&
-                deserialize_turn_log(&out_game->turn_log, fp);
-  // new_turn_log(&out_game->turn_log, 0);
-
+  bool success = read_game(out_game, fp);
   fclose(fp);
 
   if (!success) {
@@ -864,26 +1381,25 @@ bool check_fhit(GameManager *game_manager, int dest) {
   return pos != -1 && pos == dest;
 }
 
-bool can_player_bear_off(GameManager *game_manager) {
-  int sum = 0;
-  Board *board = &game_manager->board;
-  if (game_manager->curr_player == White) {
-    sum += board->white_out_count;
-    for (int i = WHITE_HOME_START; i < WHITE_OUT_START; i++) {
-      if (board->board_points[i].checker_kind != game_manager->curr_player)
-        continue;
-      sum += board->board_points[i].checker_count;
-    }
-  } else {
-    sum += board->red_out_count;
-    for (int i = RED_HOME_START; i > RED_OUT_START; i--) {
-      if (board->board_points[i].checker_kind != game_manager->curr_player)
-        continue;
+// checkers on the bar or on points from start to end, inclusive
+int checkers_between(Board *board, CheckerKind checker_kind, int start,
+                     int end) {
+  int sum = checker_kind == White ? board->white_bar.checker_count
+                                  : board->red_bar.checker_count;
+  for (int i = start; i <= end; i++) {
+    if (board->board_points[i].checker_kind == checker_kind)
       sum += board->board_points[i].checker_count;
-    }
   }
+  return sum;
+}
 
-  return sum == CHECKER_COUNT;
+// nothing left outside the home board, whatever the number of checkers
+bool can_player_bear_off(GameManager *game_manager) {
+  Board *board = &game_manager->board;
+  if (game_manager->curr_player == White)
+    return checkers_between(board, White, 0, WHITE_HOME_START - 1) == 0;
+  return checkers_between(board, Red, RED_HOME_START + 1, BOARD_SIZE - 1) ==
+         0;
 }
 
 // dont check if player can bear off at all
@@ -898,6 +1414,14 @@ bool can_player_move_to_point(GameManager *game_manager, int dest) {
          game_manager->board.board_points[dest].checker_count <= 1;
 }
 
+int bar_count(Board *board, CheckerKind checker_kind) {
+  if (checker_kind == White)
+    return board->white_bar.checker_count;
+  if (checker_kind == Red)
+    return board->red_bar.checker_count;
+  return -1;
+}
+
 // check if move from point is legal
 bool is_move_legal_basic(GameManager *game_manager, int from, int move_by) {
   Board *board = &game_manager->board;
@@ -916,8 +1440,34 @@ bool is_move_legal_basic(GameManager *game_manager, int from, int move_by) {
   return can_player_move_to_point(game_manager, dest);
 }
 
-bool check_passes_forced(WinManager *win_manager, GameManager *game_manager,
-                         int dest) {
+typedef enum {
+  MoveOk,
+  MoveIllegal,
+  MoveMustHit,
+  MoveMustBearOff,
+  MoveMustUseBoth,
+  MoveMustUseLarger
+} MoveError;
+
+const char *move_error_str(MoveError move_error) {
+  switch (move_error) {
+  case MoveOk:
+    return "ok";
+  case MoveMustHit:
+    return "you have to hit";
+  case MoveMustBearOff:
+    return "you have to bear off";
+  case MoveMustUseBoth:
+    return "you have to use both dice";
+  case MoveMustUseLarger:
+    return "you have to use the larger die";
+  default:
+    return "illegal move";
+  }
+}
+
+// house rules: hit the forced blot if there is one, bear off if possible
+MoveError forced_move_error(GameManager *game_manager, int dest) {
   int fpos = fhit_pos(game_manager);
   bool hits_fhit = fpos == dest && dest != -1;
   bool passes_fhit = fpos == -1 || hits_fhit;
@@ -926,28 +1476,18 @@ bool check_passes_forced(WinManager *win_manager, GameManager *game_manager,
   bool passes_f_out = !can_player_bear_off(game_manager) || bears_off;
 
   if ((passes_fhit && passes_f_out) || hits_fhit || bears_off)
-    return true;
-
+    return MoveOk;
   if (!passes_fhit)
-    printf_centered_nl(&win_manager->io_win, "you have to hit #%d pos",
-                       fpos + 1);
-  if (!passes_f_out)
-    printf_centered_nl(&win_manager->io_win, "you have to bear off");
-  return false;
+    return MoveMustHit;
+  return MoveMustBearOff;
 }
 
-bool is_move_legal_forced(WinManager *win_manager, GameManager *game_manager,
-                          int from, int move_by) {
-  clear_win(&win_manager->io_win);
-
-  Board *board = &game_manager->board;
+MoveError house_move_error(GameManager *game_manager, int from,
+                           int move_by) {
+  if (!is_move_legal_basic(game_manager, from, move_by))
+    return MoveIllegal;
   int dest = move_dest(game_manager, from, move_by);
-  if (!is_move_legal_basic(game_manager, from, move_by)) {
-    printf_centered_nl(&win_manager->io_win, "illegal move");
-    return false;
-  }
-
-  return check_passes_forced(win_manager, game_manager, dest);
+  return forced_move_error(game_manager, dest);
 }
 
 bool is_enter_legal_basic(GameManager *game_manager, int move_by) {
@@ -958,22 +1498,150 @@ bool is_enter_legal_basic(GameManager *game_manager, int move_by) {
   return can_player_move_to_point(game_manager, pos);
 }
 
-bool is_enter_legal_forced(WinManager *win_manager, GameManager *game_manager,
-                           int move_by) {
-  clear_win(&win_manager->io_win);
+MoveError house_enter_error(GameManager *game_manager, int move_by) {
+  if (!is_enter_legal_basic(game_manager, move_by))
+    return MoveIllegal;
 
-  if (!is_enter_legal_basic(game_manager, move_by)) {
-    printf_centered_nl(&win_manager->io_win, "illegal move");
-    return false;
-  }
   int dest = enter_dest(game_manager->curr_player, move_by);
-
   int fpos = fhit_pos_enter(game_manager);
-  bool passes_fhit = fpos == -1 || fpos == dest;
-  if (passes_fhit)
+  if (fpos == -1 || fpos == dest)
+    return MoveOk;
+  return MoveMustHit;
+}
+
+// standard rules only bear off with a bigger die than needed from the
+// farthest checker, the house rules allow it from any point
+bool is_bear_off_standard(GameManager *game_manager, int from, int move_by) {
+  CheckerKind player = game_manager->curr_player;
+  int dest = move_dest(game_manager, from, move_by);
+  if (!is_pos_out(dest) || dest == (out_start(player)))
     return true;
+  int dir = CHECKER_DIR(player);
+  for (int i = home_start(player); i != from; i += dir) {
+    if (checker_kind_at(&game_manager->board, i) == player)
+      return false;
+  }
+  return true;
+}
+
+// a single step under the standard rules, without looking at the dice left
+bool is_step_legal_standard(GameManager *game_manager, int from,
+                            int move_by) {
+  if (!is_pos_on_bar(from))
+    return bar_count(&game_manager->board, game_manager->curr_player) == 0 &&
+           is_move_legal_basic(game_manager, from, move_by) &&
+           is_bear_off_standard(game_manager, from, move_by);
+  return can_use_roll_val(&game_manager->dice_roll, move_by) &&
+         is_enter_legal_basic(game_manager, move_by);
+}
+
+int dice_left(DiceRoll *dice_roll) {
+  if (dice_roll->v1 == dice_roll->v2)
+    return MAX_DOUBLET_USES - dice_roll->doublet_times_used;
+  return !dice_roll->used1 + !dice_roll->used2;
+}
+
+bool move_checker_check_hit(GameManager *game_manager, int from, int move_by);
 
-  printf_centered_nl(&win_manager->io_win, "you have to hit #%d pos", fpos + 1);
+// most dice the player can still use this turn under the standard rules
+int max_dice_usable(GameManager *game_manager) {
+  DiceRoll *dice_roll = &game_manager->dice_roll;
+  CheckerKind player = game_manager->curr_player;
+  bool on_bar = bar_count(&game_manager->board, player) > 0;
+  int left = dice_left(dice_roll);
+  int best = 0;
+  int vals[] = {dice_roll->v1, dice_roll->v2};
+  int val_count = dice_roll->v1 == dice_roll->v2 ? 1 : 2;
+
+  for (int i = 0; i < val_count && best < left; i++) {
+    for (int from = on_bar ? PLAYER_BAR_POS(player) : 0;
+         from < BOARD_SIZE && best < left; from = on_bar ? BOARD_SIZE
+                                                         : from + 1) {
+      if (!is_step_legal_standard(game_manager, from, vals[i]))
+        continue;
+      GameManager next = *game_manager;
+      move_checker_check_hit(&next, from, vals[i]);
+      use_roll_val(&next.dice_roll, vals[i]);
+      int used = 1 + max_dice_usable(&next);
+      if (used > best)
+        best = used;
+    }
+  }
+  return best;
+}
+
+// standard rules: use as many dice as possible, the larger one when only
+// one of them can be used
+MoveError standard_step_error(GameManager *game_manager, int from,
+                              int move_by) {
+  if (!is_step_legal_standard(game_manager, from, move_by))
+    return MoveIllegal;
+
+  int most = max_dice_usable(game_manager);
+  GameManager next = *game_manager;
+  move_checker_check_hit(&next, from, move_by);
+  use_roll_val(&next.dice_roll, move_by);
+  if (1 + max_dice_usable(&next) < most)
+    return MoveMustUseBoth;
+
+  DiceRoll *dice_roll = &game_manager->dice_roll;
+  int larger = dice_roll->v1 > dice_roll->v2 ? dice_roll->v1 : dice_roll->v2;
+  if (most > 1 || move_by == larger || !can_use_roll_val(dice_roll, larger))
+    return MoveOk;
+  // while on the bar only entering is legal, no board point would be
+  CheckerKind player = game_manager->curr_player;
+  if (bar_count(&game_manager->board, player) > 0)
+    return is_step_legal_standard(game_manager, PLAYER_BAR_POS(player), larger)
+               ? MoveMustUseLarger
+               : MoveOk;
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    if (is_step_legal_standard(game_manager, i, larger))
+      return MoveMustUseLarger;
+  }
+  return MoveOk;
+}
+
+MoveError move_error(GameManager *game_manager, int from, int move_by) {
+  if (game_manager->rules == StandardRules)
+    return standard_step_error(game_manager, from, move_by);
+  return house_move_error(game_manager, from, move_by);
+}
+
+MoveError enter_error(GameManager *game_manager, int move_by) {
+  if (game_manager->rules == StandardRules)
+    return standard_step_error(
+        game_manager, PLAYER_BAR_POS(game_manager->curr_player), move_by);
+  return house_enter_error(game_manager, move_by);
+}
+
+void print_move_error(WinManager *win_manager, MoveError error,
+                      int fhit_pos) {
+  if (error == MoveMustHit)
+    printf_centered_nl(&win_manager->io_win, "you have to hit #%d pos",
+                       fhit_pos + 1);
+  else
+    printf_centered_nl(&win_manager->io_win, "%s", move_error_str(error));
+}
+
+bool is_move_legal_forced(WinManager *win_manager, GameManager *game_manager,
+                          int from, int move_by) {
+  clear_win(&win_manager->io_win);
+
+  MoveError error = move_error(game_manager, from, move_by);
+  if (error == MoveOk)
+    return true;
+  print_move_error(win_manager, error, fhit_pos(game_manager));
+  return false;
+}
+
+bool is_enter_legal_forced(WinManager *win_manager, GameManager *game_manager,
+                           int move_by) {
+  clear_win(&win_manager->io_win);
+
+  MoveError error = enter_error(game_manager, move_by);
+  if (error == MoveOk)
+    return true;
+  print_move_error(win_manager, error, fhit_pos_enter(game_manager));
   return false;
 }
 
@@ -1056,18 +1724,66 @@ void apply_turn_entry(TurnEntry *turn_entry, GameManager *game_manager) {
   game_manager->dice_roll = new_dice_roll(turn_entry->dice1, turn_entry->dice2);
 }
 
+// Callbacks of replay_saved_game, either can be NULL. on_turn runs at the
+// start of every turn and on_move before every move, both with the game as
+// it stands then; returning false stops the replay and fails the game.
+typedef struct {
+  bool (*on_turn)(void *ctx, GameManager *game, TurnEntry *turn, int t);
+  bool (*on_move)(void *ctx, GameManager *game, TurnEntry *turn, int t,
+                  int m);
+  void *ctx;
+} ReplayHooks;
+
+// replays the turn log of a save file from the starting position of its
+// variant and leaves the game at the end of it, without the log; a log that
+// doesn't lead to the saved board fails the game
+bool replay_saved_game(const char *filename, GameManager *game,
+                       ReplayHooks *hooks) {
+  FILE *fp = fopen(filename, "r");
+  if (fp == NULL)
+    return false;
+  memset(game, 0, sizeof(*game));
+  bool success = read_game(game, fp);
+  fclose(fp);
+
+  TurnLog *turn_log = &game->turn_log;
+  Board saved = game->board;
+  game->board = variant_board(game->variant);
+  TurnEntry turn;
+  for (int t = 0; success && t < turn_log_len(turn_log); t++) {
+    turn_at(turn_log, t, &turn);
+    if (t == 0)
+      game->curr_player = turn.dice1 < turn.dice2 ? Red : White;
+    else
+      game->curr_player = opposite_checker(game->curr_player);
+    game->dice_roll = new_dice_roll(turn.dice1, turn.dice2);
+    success =
+        hooks->on_turn == NULL || hooks->on_turn(hooks->ctx, game, &turn, t);
+
+    for (int m = 0; success && m < turn.move_count; m++) {
+      success = hooks->on_move == NULL ||
+                hooks->on_move(hooks->ctx, game, &turn, t, m);
+      apply_move_entry(&turn.moves[m], game, false);
+    }
+  }
+  free_turn_log(turn_log);
+  return success && same_board(&game->board, &saved);
+}
+
 void trav_apply_reverse_move(GameManager *game_manager, TurnLog *turn_log) {
   if (trav_on_start(&game_manager->turn_log))
     return;
   if (!trav_on_new_turn(turn_log)) {
-    apply_move_entry(trav_curr_move(turn_log), game_manager, true);
+    MoveEntry move = trav_curr_move(turn_log);
+    apply_move_entry(&move, game_manager, true);
     trav_prev_move(turn_log);
     return;
   }
   trav_prev_move(turn_log);
-  TurnEntry *prev_turn = turn_at(turn_log, turn_log->trav_turn_id);
-  apply_turn_entry(prev_turn, game_manager);
-  synch_prev_turn_dice(prev_turn, game_manager);
+  TurnEntry prev_turn;
+  turn_at(turn_log, turn_log->trav_turn_id, &prev_turn);
+  apply_turn_entry(&prev_turn, game_manager);
+  synch_prev_turn_dice(&prev_turn, game_manager);
 }
 
 void trav_apply_next_move(GameManager *game_manager, TurnLog *turn_log) {
@@ -1075,10 +1791,13 @@ void trav_apply_next_move(GameManager *game_manager, TurnLog *turn_log) {
     return;
   bool new_turn = trav_next_move(turn_log);
   if (new_turn) {
-    apply_turn_entry(turn_at(turn_log, turn_log->trav_turn_id), game_manager);
+    TurnEntry turn;
+    turn_at(turn_log, turn_log->trav_turn_id, &turn);
+    apply_turn_entry(&turn, game_manager);
     return;
   }
-  apply_move_entry(trav_curr_move(turn_log), game_manager, false);
+  MoveEntry move = trav_curr_move(turn_log);
+  apply_move_entry(&move, game_manager, false);
 }
 
 void trav_apply_move(GameManager *game_manager, bool reverse) {
@@ -1092,8 +1811,10 @@ void trav_apply_move(GameManager *game_manager, bool reverse) {
 void trav_apply_to_start(GameManager *game_manager) {
   trav_goto_start(&game_manager->turn_log);
 
-  game_manager->board = default_board();
-  apply_turn_entry(turn_at(&game_manager->turn_log, 0), game_manager);
+  game_manager->board = variant_board(game_manager->variant);
+  TurnEntry first_turn;
+  turn_at(&game_manager->turn_log, 0, &first_turn);
+  apply_turn_entry(&first_turn, game_manager);
 
   if (game_manager->dice_roll.v1 < game_manager->dice_roll.v2) {
     game_manager->curr_player = Red;
@@ -1108,9 +1829,14 @@ void trav_apply_to_end(GameManager *game_manager, GameManager *end_game) {
 }
 
 void trav_delete_next_moves(TurnLog *turn_log) {
-  turn_log->vec.len = turn_log->trav_turn_id + 1;
-  TurnEntry *curr_turn = turn_at(turn_log, turn_log->trav_turn_id);
-  curr_turn->move_count = turn_log->trav_move_id + 1;
+  turn_log->turns.len = turn_log->trav_turn_id + 1;
+  uint32_t *turns = turn_log->turns.data;
+  uint32_t word = turns[turn_log->trav_turn_id];
+  int move_count = turn_log->trav_move_id + 1;
+  turns[turn_log->trav_turn_id] = pack_turn(
+      turn_first_move(word), turn_field(word, 2), turn_field(word, 1),
+      move_count);
+  truncate_moves(turn_log, turn_first_move(word) + move_count);
 }
 
 // returns whether move was legal
@@ -1121,6 +1847,7 @@ bool player_move(WinManager *win_manager, GameManager *game_manager, int from,
 
   int hit_enemy = move_checker_check_hit(game_manager, from, move_by);
   game_add_move_entry(game_manager, from, move_by, hit_enemy);
+  journal_move(from, move_by);
 
   return true;
 }
@@ -1133,18 +1860,11 @@ bool player_enter(WinManager *win_manager, GameManager *game_manager,
   int from = PLAYER_BAR_POS(game_manager->curr_player);
   int hit_enemy = move_checker_check_hit(game_manager, from, move_by);
   game_add_move_entry(game_manager, from, move_by, hit_enemy);
+  journal_move(from, move_by);
 
   return true;
 }
 
-int bar_count(Board *board, CheckerKind checker_kind) {
-  if (checker_kind == White)
-    return board->white_bar.checker_count;
-  if (checker_kind == Red)
-    return board->red_bar.checker_count;
-  return -1;
-}
-
 int legal_enters_count(GameManager *game_manager) {
   if (game_manager->curr_player == None)
     return 0;
@@ -1190,31 +1910,111 @@ bool any_move_legal(GameManager *game_manager) {
   return false;
 }
 
-void print_board_ui(WinWrapper *win_wrapper) {
-  mv_printf_yx(win_wrapper, CONTENT_Y_START, CONTENT_X_START,
-               "12  11  10  09  08  07 |   | 06  05  04  03  02  01");
-  mv_printf_yx(win_wrapper, CONTENT_Y_START + BOARD_HEIGHT / 2, CONTENT_X_START,
-               "---------------------- |BAR| ----------------- HOME");
-  mv_printf_yx(win_wrapper, CONTENT_Y_END, CONTENT_X_START,
-               "13  14  15  16  17  18 |   | 19  20  21  22  23  24");
+bool any_enter_allowed(GameManager *game_manager) {
+  DiceRoll *dice_roll = &game_manager->dice_roll;
+  return (can_use_roll_val(dice_roll, dice_roll->v1) &&
+          enter_error(game_manager, dice_roll->v1) == MoveOk) ||
+         (can_use_roll_val(dice_roll, dice_roll->v2) &&
+          enter_error(game_manager, dice_roll->v2) == MoveOk);
+}
+
+// like any_move_legal, but under the rules of the game. Any legal step
+// leaves some play under the standard rules, so they skip the look ahead.
+bool any_move_allowed(GameManager *game_manager) {
+  if (!any_move_legal(game_manager))
+    return false;
+
+  int v1 = game_manager->dice_roll.v1;
+  int v2 = game_manager->dice_roll.v2;
+  bool standard = game_manager->rules == StandardRules;
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    if (checker_kind_at(&game_manager->board, i) != game_manager->curr_player)
+      continue;
+    for (int j = 0; j < (v1 == v2 ? 1 : 2); j++) {
+      int by = j == 0 ? v1 : v2;
+      if (standard ? is_step_legal_standard(game_manager, i, by)
+                   : house_move_error(game_manager, i, by) == MoveOk)
+        return true;
+    }
+  }
+  return false;
+}
+
+bool turn_finished(GameManager *game_manager) {
+  if (dice_roll_used(&game_manager->dice_roll))
+    return true;
+  if (bar_count(&game_manager->board, game_manager->curr_player) > 0)
+    return !any_enter_allowed(game_manager);
+  return !any_move_allowed(game_manager);
+}
+
+// headless counterpart of make_move_loop, the move is logged when it's legal
+MoveError game_move(GameManager *game_manager, int from, int move_by) {
+  // the UI only offers entering while checkers are on the bar
+  CheckerKind player = game_manager->curr_player;
+  if (bar_count(&game_manager->board, player) > 0 &&
+      !is_pos_on_bar(from))
+    return MoveIllegal;
+
+  MoveError error = move_error(game_manager, from, move_by);
+  if (error != MoveOk)
+    return error;
+
+  int hit_enemy = move_checker_check_hit(game_manager, from, move_by);
+  game_add_move_entry(game_manager, from, move_by, hit_enemy);
+  use_roll_val(&game_manager->dice_roll, move_by);
+  return MoveOk;
+}
+
+// headless counterpart of make_enter_move_loop
+MoveError game_enter(GameManager *game_manager, int move_by) {
+  if (!can_use_roll_val(&game_manager->dice_roll, move_by) ||
+      bar_count(&game_manager->board, game_manager->curr_player) <= 0)
+    return MoveIllegal;
+
+  MoveError error = enter_error(game_manager, move_by);
+  if (error != MoveOk)
+    return error;
+
+  int from = PLAYER_BAR_POS(game_manager->curr_player);
+  int hit_enemy = move_checker_check_hit(game_manager, from, move_by);
+  game_add_move_entry(game_manager, from, move_by, hit_enemy);
+  use_roll_val(&game_manager->dice_roll, move_by);
+  return MoveOk;
+}
+
+void draw_board_frame(BoardCanvas *canvas) {
+  canvas->put(canvas->target, CONTENT_Y_START, CONTENT_X_START,
+              "12  11  10  09  08  07 |   | 06  05  04  03  02  01");
+  canvas->put(canvas->target, CONTENT_Y_START + BOARD_HEIGHT / 2,
+              CONTENT_X_START,
+              "---------------------- |BAR| ----------------- HOME");
+  canvas->put(canvas->target, CONTENT_Y_END, CONTENT_X_START,
+              "13  14  15  16  17  18 |   | 19  20  21  22  23  24");
 
   for (int i = 0; i < BOARD_ROW_COUNT; i++) {
-    mv_printf_centered(win_wrapper, CONTENT_Y_START + i + 1, "|   |");
-    mv_printf_centered(win_wrapper, CONTENT_Y_END - i - 1, "|   |");
+    canvas_put_centered(canvas, CONTENT_Y_START + i + 1, "|   |");
+    canvas_put_centered(canvas, CONTENT_Y_END - i - 1, "|   |");
   }
 }
 
-void print_board_checkers(WinWrapper *win_wrapper, Board *board) {
+void draw_board_checkers(BoardCanvas *canvas, Board *board) {
   for (int i = 0; i < BOARD_SIZE; i++) {
-    print_board_point(win_wrapper, &board->board_points[i], i);
+    draw_board_point(canvas, &board->board_points[i], i);
   }
+  draw_checkers_on_bar(canvas, &board->red_bar);
+  draw_checkers_on_bar(canvas, &board->white_bar);
+}
+
+void window_put(void *target, int y, int x, const char *str) {
+  WinWrapper *win_wrapper = target;
+  mvwaddstr(win_wrapper->win, y, x, str);
 }
 
 void print_board(Board *board, WinWrapper *win_wrapper) {
-  print_board_ui(win_wrapper);
-  print_board_checkers(win_wrapper, board);
-  print_checkers_on_bar(win_wrapper, &board->red_bar);
-  print_checkers_on_bar(win_wrapper, &board->white_bar);
+  BoardCanvas canvas = {window_put, win_wrapper, win_wrapper->width};
+  draw_board_frame(&canvas);
+  draw_board_checkers(&canvas, board);
 }
 
 void display_board(WinWrapper *win_wrapper, Board *board) {
@@ -1256,8 +2056,22 @@ void print_stats_header(WinWrapper *win_wrapper, GameManager *game_manager) {
                      game_manager->board.red_out_count);
 }
 
+void print_stats_match(WinWrapper *win_wrapper, MatchState *match) {
+  if (match->length == MONEY_GAME)
+    return;
+  mv_printf_centered(win_wrapper, STATS_MATCH_Y, "to %d cube %d%c",
+                     match->length, match->cube_value,
+                     match->cube_owner == None ? ' '
+                                               : owner_char(match->cube_owner));
+  printf_centered_nl(win_wrapper, "R %d W %d", match->red_score,
+                     match->white_score);
+  if (match->crawford)
+    printf_centered_nl(win_wrapper, "crawford");
+}
+
 void print_stats(WinWrapper *win_wrapper, GameManager *game_manager) {
   print_stats_header(win_wrapper, game_manager);
+  print_stats_match(win_wrapper, &game_manager->match);
 
   int y = STATS_LINES_COUNT - 1;
   if (game_manager->curr_player == White)
@@ -1292,13 +2106,35 @@ int input_int(WinWrapper *io_wrapper, const char *prompt) {
   return res;
 }
 
+// int_prompt_input_untill that shows the hint for HINT_INPUT, true means
+// user wants to quit
+bool move_prompt_input(WinManager *win_manager, const char *prompt,
+                       int *res) {
+  WinWrapper *io_wrapper = &win_manager->io_win;
+  *res = -1;
+  while (*res <= -1) {
+    char input[MAX_INPUT_LEN + 1] = "";
+    prompt_input(io_wrapper, prompt, input);
+    if (check_for_quit_input(input))
+      return true;
+    str_to_lower(input);
+    if (strcmp(input, HINT_INPUT) == 0) {
+      show_hints(win_manager);
+      continue;
+    }
+    sscanf(input, "%d", res);
+    if (*res <= -1)
+      clear_curr_line(io_wrapper);
+  }
+  return false;
+}
+
 bool move_input(WinManager *win_manager, int *from, int *by) {
-  bool quit =
-      int_prompt_input_untill(&win_manager->io_win, "Move from: ", from);
+  bool quit = move_prompt_input(win_manager, "Move from: ", from);
   if (quit)
     return true;
   (*from)--;
-  quit = int_prompt_input_untill(&win_manager->io_win, "Move by: ", by);
+  quit = move_prompt_input(win_manager, "Move by: ", by);
   return quit;
 }
 
@@ -1326,8 +2162,7 @@ bool make_enter_move_loop(WinManager *win_manager, GameManager *game_manager) {
   int val;
   while (!legal) {
     val = -1;
-    bool quit = int_prompt_input_untill(&win_manager->io_win,
-                                        "Enter using value: ", &val);
+    bool quit = move_prompt_input(win_manager, "Enter using value: ", &val);
     if (quit)
       return true;
 
@@ -1347,21 +2182,38 @@ void log_new_turn(GameManager *game_manager) {
   push_to_turn_log(&game_manager->turn_log, &turn_entry);
 }
 
+// headless counterpart of the end of play_turn
+void game_next_turn(GameManager *game_manager) {
+  swap_players(game_manager);
+  log_new_turn(game_manager);
+}
+
 bool play_turn(WinManager *win_manager, GameManager *game_manager,
                bool resume) {
   if (!resume) {
     log_new_turn(game_manager);
+    journal_turn(game_manager);
+    // the turn is logged, so the autosave loads like a game saved mid-turn
+    queue_game_save(game_manager, AUTOSAVE_FILE, false);
   }
 
+  char play_text[MAX_PLAY_TEXT_LEN] = "";
+  bool computer = game_manager->curr_player == game_manager->computer;
+  if (computer)
+    computer_turn(win_manager, game_manager, play_text);
+
+  // the background analysis follows the moves of the turn
   int count = legal_enters_count(game_manager);
   for (int i = 0; i < count; i++) {
+    analyse_position(game_manager);
     if (make_enter_move_loop(win_manager, game_manager))
       return true;
 
     display_game(win_manager, game_manager);
   }
 
-  while (any_move_legal(game_manager)) {
+  while (!turn_finished(game_manager)) {
+    analyse_position(game_manager);
     if (make_move_loop(win_manager, game_manager))
       return true;
 
@@ -1369,34 +2221,145 @@ bool play_turn(WinManager *win_manager, GameManager *game_manager,
   }
 
   clear_refresh_win(&win_manager->io_win);
+  if (computer)
+    printf_centered_nl(&win_manager->io_win, "Computer played %s",
+                       play_text);
   swap_players(game_manager);
 
   return false;
 }
 
-CheckerKind check_game_over(GameManager *game_manager) {
-  if (game_manager->board.white_out_count >= CHECKER_COUNT)
-    return White;
-  if (game_manager->board.red_out_count >= CHECKER_COUNT)
-    return Red;
-  return None;
+bool has_checkers_in_range(Board *board, CheckerKind checker_kind, int start,
+                           int end) {
+  for (int i = start; i <= end; i++) {
+    if (board->board_points[i].checker_kind == checker_kind &&
+        board->board_points[i].checker_count > 0)
+      return true;
+  }
+  return false;
 }
 
-bool check_handle_win(WinManager *win_manager, GameManager *game_manager) {
-  CheckerKind won = check_game_over(game_manager);
-  if (won == None)
-    return false;
+WinKind win_kind(Board *board, CheckerKind winner) {
+  CheckerKind loser = opposite_checker(winner);
+  int loser_out =
+      loser == White ? board->white_out_count : board->red_out_count;
+  if (loser_out > 0)
+    return SingleWin;
+
+  bool in_winner_home =
+      winner == White
+          ? has_checkers_in_range(board, loser, WHITE_HOME_START,
+                                  WHITE_OUT_START - 1)
+          : has_checkers_in_range(board, loser, RED_OUT_START + 1,
+                                  RED_HOME_START);
+  if (bar_count(board, loser) > 0 || in_winner_home)
+    return BackgammonWin;
+  return GammonWin;
+}
+
+// win_kind_out can be NULL, it's NoWin while the game goes on
+CheckerKind check_game_over(GameManager *game_manager, WinKind *win_kind_out) {
+  CheckerKind winner = None;
+  Board *board = &game_manager->board;
+  if (board->white_out_count > 0 &&
+      checkers_between(board, White, 0, BOARD_SIZE - 1) == 0)
+    winner = White;
+  else if (board->red_out_count > 0 &&
+           checkers_between(board, Red, 0, BOARD_SIZE - 1) == 0)
+    winner = Red;
+
+  if (win_kind_out != NULL)
+    *win_kind_out =
+        winner == None ? NoWin : win_kind(&game_manager->board, winner);
+  return winner;
+}
+
+const char *win_kind_str(WinKind win_kind) {
+  switch (win_kind) {
+  case GammonWin:
+    return "a gammon";
+  case BackgammonWin:
+    return "a backgammon";
+  default:
+    return "the game";
+  }
+}
+
+void show_game_over(WinManager *win_manager, GameManager *game_manager,
+                    CheckerKind won, WinKind win_kind, int points) {
+  MatchState *match = &game_manager->match;
+  award_points(match, won, points);
 
   clear_refresh_win(&win_manager->content_win);
   mv_printf_centered(&win_manager->content_win, CONTENT_Y_END / 2,
                      "Game Over!");
 
-  if (won == White)
-    printf_centered_nl(&win_manager->content_win, "White Wins!");
-  else
-    printf_centered_nl(&win_manager->content_win, "Red Wins!");
+  printf_centered_nl(&win_manager->content_win, "%s wins %s, %d point(s)",
+                     won == White ? "White" : "Red", win_kind_str(win_kind),
+                     points);
+  if (match->length != MONEY_GAME)
+    printf_centered_nl(&win_manager->content_win, "White %d : %d Red, to %d",
+                       match->white_score, match->red_score, match->length);
+  if (match_over(match))
+    printf_centered_nl(&win_manager->content_win, "%s wins the match!",
+                       won == White ? "White" : "Red");
 
   win_char_input(&win_manager->io_win);
+}
+
+bool check_handle_win(WinManager *win_manager, GameManager *game_manager) {
+  WinKind win_kind;
+  CheckerKind won = check_game_over(game_manager, &win_kind);
+  if (won == None)
+    return false;
+
+  show_game_over(win_manager, game_manager, won, win_kind,
+                 game_points(&game_manager->match, win_kind));
+  return true;
+}
+
+// returns true if the player wants to quit, passed is set when the
+// opponent drops the double and so loses the game
+bool cube_action(WinManager *win_manager, GameManager *game_manager,
+                 bool *passed) {
+  *passed = false;
+  CheckerKind player = game_manager->curr_player;
+  if (!can_double(&game_manager->match, player))
+    return false;
+
+  bool answer = false;
+  clear_curr_line(&win_manager->io_win);
+  if (player == game_manager->computer)
+    answer = computer_doubles(game_manager);
+  else if (yes_no_prompt_input(&win_manager->io_win, "Double? (y/n): ",
+                               &answer))
+    return true;
+  if (!answer)
+    return false;
+
+  clear_curr_line(&win_manager->io_win);
+  if (player == game_manager->computer)
+    printf_centered_nl(&win_manager->io_win, "Computer doubles");
+  if (opposite_checker(player) == game_manager->computer)
+    answer = computer_takes(game_manager);
+  else if (yes_no_prompt_input(&win_manager->io_win, "Take? (y/n): ",
+                               &answer))
+    return true;
+  if (answer) {
+    accept_double(&game_manager->match, opposite_checker(player));
+    journal_cube(&game_manager->match);
+  } else
+    *passed = true;
+  clear_refresh_win(&win_manager->io_win);
+  return false;
+}
+
+// starts the next game of a match, false when there is none
+bool continue_match(GameManager *game_manager) {
+  MatchState *match = &game_manager->match;
+  if (match->length == MONEY_GAME || match_over(match))
+    return false;
+  new_match_game(game_manager);
   return true;
 }
 
@@ -1405,7 +2368,7 @@ void save_game(WinManager *win_manager, GameManager *game_manager) {
   prompt_input(&win_manager->io_win, "Save to file: ", filename);
   if (filename[0] == '\0')
     return;
-  if (!serialize_game(game_manager, filename)) {
+  if (!queue_game_save(game_manager, filename, true)) {
     printf_centered_nl(&win_manager->io_win, "Failed to access '%s'", filename);
   }
 }
@@ -1414,33 +2377,130 @@ void game_loop(WinManager *win_manager, GameManager *game_manager,
                bool resume) {
   enable_cursor();
   clear_refresh_win(&win_manager->io_win);
+  journal_game(game_manager, resume);
 
   bool save = false;
   while (true) {
+    report_save_failure(win_manager);
+    bool passed = false;
+    // the opening roll is already on the board and can't be doubled before
+    bool opening = turn_log_len(&game_manager->turn_log) == 0;
+    if (!resume && !opening &&
+        cube_action(win_manager, game_manager, &passed)) {
+      log_new_turn(game_manager);
+      save = true;
+      break;
+    }
+    if (passed) {
+      show_game_over(win_manager, game_manager, game_manager->curr_player,
+                     SingleWin, game_manager->match.cube_value);
+      if (!continue_match(game_manager))
+        break;
+      journal_game(game_manager, false);
+      continue;
+    }
+
     display_game(win_manager, game_manager);
     if (play_turn(win_manager, game_manager, resume)) {
       save = true;
       break;
     }
-    if (check_handle_win(win_manager, game_manager))
-      break;
     resume = false;
+    if (check_game_over(game_manager, NULL) == None)
+      continue;
+    if (check_handle_win(win_manager, game_manager) &&
+        !continue_match(game_manager))
+      break;
+    journal_game(game_manager, false);
   }
 
   clear_refresh_win(&win_manager->io_win);
   clear_refresh_win(&win_manager->stats_win);
   clear_refresh_win(&win_manager->content_win);
 
+  stop_analysis();
   if (save)
     save_game(win_manager, game_manager);
+  // quitting is on purpose, only a crash leaves the journal behind
+  close_journal(&game_journal, false);
 
   disable_cursor();
 
   free_game_manager(game_manager);
 }
 
+// Rebuilds the game kept in the journal, false if there is none. A line
+// that doesn't parse or a move that isn't legal, like a record cut off by
+// the crash, ends the replay.
+bool recover_journal(GameManager *out, bool *resume) {
+  FILE *fp = fopen(JOURNAL_FILE, "r");
+  if (fp == NULL)
+    return false;
+  memset(out, 0, sizeof(*out));
+  int flag = 0;
+  bool ok = fscanf(fp, JOURNAL_HEADER " resume:%d\n", &flag) == 1 &&
+            read_game(out, fp);
+  *resume = flag;
+
+  char line[MAX_INPUT_LEN * 2];
+  while (ok && fgets(line, sizeof(line), fp) != NULL &&
+         strchr(line, '\n') != NULL) {
+    char c;
+    int a, b;
+    if (line[0] == '\n')
+      continue;
+    if (sscanf(line, "turn %c %d %d", &c, &a, &b) == 3 &&
+        checker_kind_from_char(c) != None) {
+      out->curr_player = checker_kind_from_char(c);
+      out->dice_roll = new_dice_roll(a, b);
+      log_new_turn(out);
+      *resume = true;
+    } else if (sscanf(line, "move %d %d", &a, &b) == 2) {
+      MoveError error =
+          is_pos_on_bar(a) ? game_enter(out, b) : game_move(out, a, b);
+      if (error != MoveOk)
+        break;
+    } else if (sscanf(line, "cube %d %c", &a, &c) == 2) {
+      out->match.cube_value = a;
+      out->match.cube_owner = checker_kind_from_char(c);
+    } else {
+      break;
+    }
+  }
+  fclose(fp);
+  if (!ok) {
+    free_turn_log(&out->turn_log);
+    unlink(JOURNAL_FILE);
+  }
+  return ok;
+}
+
+// offers to go on with the game a crash left in the journal
+void recover_game_menu(WinManager *win_manager) {
+  GameManager game_manager;
+  bool resume;
+  if (!recover_journal(&game_manager, &resume))
+    return;
+
+  enable_cursor();
+  clear_refresh_win(&win_manager->io_win);
+  bool answer = false;
+  bool quit = yes_no_prompt_input(
+      &win_manager->io_win, "Recover the unfinished game? (y/n): ", &answer);
+  clear_refresh_win(&win_manager->io_win);
+  disable_cursor();
+  if (quit || !answer) {
+    if (!quit)
+      unlink(JOURNAL_FILE);
+    free_game_manager(&game_manager);
+    return;
+  }
+  game_loop(win_manager, &game_manager, resume);
+}
+
 void print_play_menu(WinWrapper *win_wrapper) {
-  mv_printf_centered(win_wrapper, CONTENT_Y_END / 2, "New game");
+  mv_printf_centered(win_wrapper, CONTENT_Y_END / 2 - 2, "New game");
+  mv_printf_centered(win_wrapper, CONTENT_Y_END / 2, "New match");
   mv_printf_centered(win_wrapper, CONTENT_Y_END / 2 + 2, "Load game");
 }
 
@@ -1476,10 +2536,88 @@ bool play_load_game(WinManager *win_manager) {
   return true;
 }
 
+// true means user wants to quit
+bool rules_input(WinManager *win_manager, RuleSet *rules) {
+  bool standard = false;
+  if (yes_no_prompt_input(&win_manager->io_win,
+                          "Standard rules, no forced hits? (y/n): ",
+                          &standard))
+    return true;
+  *rules = standard ? StandardRules : HouseRules;
+  return false;
+}
+
+// true means user wants to quit, anything unknown is backgammon
+bool variant_input(WinManager *win_manager, Variant *variant) {
+  char input[MAX_INPUT_LEN] = "";
+  prompt_input(&win_manager->io_win,
+               "Variant, backgammon nackgammon hypergammon (b/n/h): ", input);
+  if (check_for_quit_input(input))
+    return true;
+  char c = tolower(input[0]);
+  *variant = c == 'n' ? Nackgammon : c == 'h' ? Hypergammon : Backgammon;
+  return false;
+}
+
+// true means user wants to quit, the computer plays red
+bool computer_input(WinManager *win_manager, CheckerKind *computer) {
+  bool against = false;
+  if (yes_no_prompt_input(&win_manager->io_win,
+                          "Play against the computer? (y/n): ", &against))
+    return true;
+  *computer = against ? Red : None;
+  return false;
+}
+
+// rules, variant and opponent of a new game, true means user wants to quit
+bool new_game_input(WinManager *win_manager, GameManager *game_manager) {
+  RuleSet rules;
+  Variant variant;
+  CheckerKind computer;
+  if (rules_input(win_manager, &rules) ||
+      variant_input(win_manager, &variant) ||
+      computer_input(win_manager, &computer))
+    return true;
+  game_manager->rules = rules;
+  game_manager->variant = variant;
+  game_manager->computer = computer;
+  game_manager->board = variant_board(variant);
+  return false;
+}
+
 bool play_new_game(WinManager *win_manager) {
   enable_cursor();
+  clear_refresh_win(&win_manager->io_win);
+
+  GameManager game_manager = new_game_manager();
+  if (new_game_input(win_manager, &game_manager)) {
+    free_game_manager(&game_manager);
+    disable_cursor();
+    return false;
+  }
+  game_loop(win_manager, &game_manager, false);
+
+  return true;
+}
+
+bool play_new_match(WinManager *win_manager) {
+  enable_cursor();
+  clear_refresh_win(&win_manager->io_win);
 
+  int length = -1;
+  if (int_prompt_input_untill(&win_manager->io_win, "Match length: ",
+                              &length) ||
+      length <= 0) {
+    disable_cursor();
+    return false;
+  }
   GameManager game_manager = new_game_manager();
+  if (new_game_input(win_manager, &game_manager)) {
+    free_game_manager(&game_manager);
+    disable_cursor();
+    return false;
+  }
+  game_manager.match = new_match_state(length);
   game_loop(win_manager, &game_manager, false);
 
   return true;
@@ -1548,6 +2686,10 @@ void play_menu_loop(WinManager *win_manager) {
     case 'n':
       play_new_game(win_manager);
       return;
+    case 'm':
+      if (play_new_match(win_manager))
+        return;
+      break;
     case 'a':
       break;
     case 'q':
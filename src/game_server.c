@@ -0,0 +1,619 @@
+#pragma once
+#include "../headers/game_server.h"
+#include "board_text.c"
+#include "game.c"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define UNIX_ADDRESS_PREFIX "unix:"
+
+typedef struct ServerGame ServerGame;
+
+typedef struct {
+  int fd;
+  char in[SERVER_LINE_LEN];
+  int in_len;
+  // the rest of a line that was too long is dropped up to its newline
+  bool discarding;
+  Vec out;
+  int out_start;
+  bool wants_write;
+
+  ServerGame *game;
+  // None means the session plays both sides
+  CheckerKind side;
+} Session;
+
+struct ServerGame {
+  int id;
+  GameManager game_manager;
+  Session *seats[2];
+  bool over;
+};
+
+typedef struct {
+  int epoll_fd, listen_fd;
+  Vec sessions;
+  Vec games;
+  Vec free_game_ids;
+  // descriptors of sessions with pending output
+  Vec dirty_fds;
+  int session_count, game_count;
+} Server;
+
+volatile sig_atomic_t server_stop = 0;
+
+void handle_server_stop(int sig) {
+  (void)sig;
+  server_stop = 1;
+}
+
+void vec_push_elem(Vec *vec, const void *elem) {
+  if (vec->len + 1 > vec->cap) {
+    if (vec_extend(vec) == 1)
+      exit(NO_HEAP_MEM_EXIT);
+  }
+  memcpy((char *)vec->data + vec->len * vec->elem_size, elem, vec->elem_size);
+  vec->len++;
+}
+
+void vec_push_bytes(Vec *vec, const char *bytes, int len) {
+  while (vec->len + len > vec->cap) {
+    if (vec_extend(vec) == 1)
+      exit(NO_HEAP_MEM_EXIT);
+  }
+  memcpy((char *)vec->data + vec->len, bytes, len);
+  vec->len += len;
+}
+
+char side_char(CheckerKind checker_kind) {
+  return checker_kind == White ? 'w' : 'r';
+}
+
+bool set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+Session **session_slot(Server *server, int fd) {
+  while (server->sessions.cap <= fd) {
+    if (vec_extend(&server->sessions) == 1)
+      exit(NO_HEAP_MEM_EXIT);
+  }
+  Session **data = server->sessions.data;
+  while (server->sessions.len <= fd)
+    data[server->sessions.len++] = NULL;
+  return &data[fd];
+}
+
+void update_session_events(Server *server, Session *session, bool write) {
+  if (session->wants_write == write)
+    return;
+  struct epoll_event event = {EPOLLIN | (write ? EPOLLOUT : 0),
+                              {.fd = session->fd}};
+  epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, session->fd, &event);
+  session->wants_write = write;
+}
+
+// returns false if the connection is broken
+bool flush_session(Server *server, Session *session) {
+  char *data = session->out.data;
+  while (session->out_start < session->out.len) {
+    ssize_t written = write(session->fd, data + session->out_start,
+                            session->out.len - session->out_start);
+    if (written < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        update_session_events(server, session, true);
+        return true;
+      }
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    session->out_start += written;
+  }
+  session->out.len = 0;
+  session->out_start = 0;
+  update_session_events(server, session, false);
+  return true;
+}
+
+void mark_dirty(Server *server, Session *session) {
+  if (session->out.len == 0)
+    vec_push_elem(&server->dirty_fds, &session->fd);
+}
+
+void session_send(Server *server, Session *session, const char *fmt, ...) {
+  char buf[SERVER_REPLY_LEN];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+
+  if (len >= (int)sizeof(buf))
+    len = sizeof(buf) - 1;
+  mark_dirty(server, session);
+  vec_push_bytes(&session->out, buf, len);
+  vec_push_bytes(&session->out, "\n", 1);
+}
+
+void game_broadcast(Server *server, ServerGame *game, const char *fmt,
+                    const char *arg) {
+  for (int i = 0; i < 2; i++) {
+    Session *seat = game->seats[i];
+    if (seat == NULL || (i == 1 && seat == game->seats[0]))
+      continue;
+    session_send(server, seat, fmt, arg);
+  }
+}
+
+ServerGame *new_server_game(Server *server) {
+  ServerGame *game = malloc(sizeof(ServerGame));
+  if (game == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+
+  int id;
+  if (server->free_game_ids.len > 0) {
+    int *ids = server->free_game_ids.data;
+    id = ids[--server->free_game_ids.len];
+  } else {
+    id = server->games.len;
+    ServerGame *empty = NULL;
+    vec_push_elem(&server->games, &empty);
+  }
+
+  *game = (ServerGame){id, new_game_manager(), {NULL, NULL}, false};
+  log_new_turn(&game->game_manager);
+
+  ServerGame **games = server->games.data;
+  games[id] = game;
+  server->game_count++;
+  return game;
+}
+
+ServerGame *find_server_game(Server *server, int id) {
+  if (id < 0 || id >= server->games.len)
+    return NULL;
+  ServerGame **games = server->games.data;
+  return games[id];
+}
+
+void free_server_game(Server *server, ServerGame *game) {
+  ServerGame **games = server->games.data;
+  games[game->id] = NULL;
+  vec_push_elem(&server->free_game_ids, &game->id);
+  free_game_manager(&game->game_manager);
+  free(game);
+  server->game_count--;
+}
+
+void leave_game(Server *server, Session *session) {
+  ServerGame *game = session->game;
+  if (game == NULL)
+    return;
+
+  for (int i = 0; i < 2; i++) {
+    if (game->seats[i] == session)
+      game->seats[i] = NULL;
+  }
+  session->game = NULL;
+
+  if (game->seats[0] == NULL && game->seats[1] == NULL) {
+    free_server_game(server, game);
+    return;
+  }
+  game->over = true;
+  game_broadcast(server, game, "LEFT %s", "opponent");
+}
+
+void send_turn(Server *server, ServerGame *game) {
+  GameManager *game_manager = &game->game_manager;
+  char turn[SERVER_REPLY_LEN];
+  snprintf(turn, sizeof(turn), "%c %d %d",
+           side_char(game_manager->curr_player), game_manager->dice_roll.v1,
+           game_manager->dice_roll.v2);
+  game_broadcast(server, game, "TURN %s", turn);
+}
+
+// passes the turn on as long as the player to move has nothing to play, a
+// game where neither side gets to move for too long ends without a winner
+void advance_game(Server *server, ServerGame *game) {
+  GameManager *game_manager = &game->game_manager;
+  WinKind win_kind;
+  CheckerKind won = check_game_over(game_manager, &win_kind);
+  if (won != None) {
+    char result[SERVER_REPLY_LEN];
+    snprintf(result, sizeof(result), "%c %d", side_char(won),
+             game_points(&game_manager->match, win_kind));
+    game->over = true;
+    game_broadcast(server, game, "OVER %s", result);
+    return;
+  }
+
+  if (!turn_finished(game_manager))
+    return;
+  int passes = 0;
+  do {
+    game_next_turn(game_manager);
+  } while (turn_finished(game_manager) && ++passes < SERVER_MAX_PASSES);
+  if (passes == SERVER_MAX_PASSES) {
+    game->over = true;
+    game_broadcast(server, game, "OVER %s", "- 0");
+    return;
+  }
+  send_turn(server, game);
+}
+
+void send_state(Server *server, Session *session, GameManager *game_manager) {
+  Board *board = &game_manager->board;
+  session_send(server, session, "OK state %c roll %d %d out %d %d bar %d %d",
+               side_char(game_manager->curr_player),
+               game_manager->dice_roll.v1, game_manager->dice_roll.v2,
+               board->white_out_count, board->red_out_count,
+               board->white_bar.checker_count, board->red_bar.checker_count);
+}
+
+void send_board(Server *server, Session *session, GameManager *game_manager) {
+  char buf[BOARD_TEXT_LEN];
+  render_board_text(&game_manager->board, buf);
+  mark_dirty(server, session);
+  vec_push_bytes(&session->out, buf, strlen(buf));
+  vec_push_bytes(&session->out, ".\n", 2);
+}
+
+// returns the game if the session may play now, replies with an error if not
+ServerGame *playing_game(Server *server, Session *session) {
+  ServerGame *game = session->game;
+  if (game == NULL) {
+    session_send(server, session, "ERR not in a game");
+    return NULL;
+  }
+  if (game->over) {
+    session_send(server, session, "ERR game is over");
+    return NULL;
+  }
+  if (game->seats[0] == NULL || game->seats[1] == NULL) {
+    session_send(server, session, "ERR waiting for opponent");
+    return NULL;
+  }
+  if (session->side != None &&
+      session->side != game->game_manager.curr_player) {
+    session_send(server, session, "ERR not your turn");
+    return NULL;
+  }
+  return game;
+}
+
+void reply_move(Server *server, Session *session, ServerGame *game,
+                MoveError error) {
+  if (error != MoveOk) {
+    session_send(server, session, "ERR %s", move_error_str(error));
+    return;
+  }
+  session_send(server, session, "OK");
+  advance_game(server, game);
+}
+
+void handle_new(Server *server, Session *session, const char *arg) {
+  leave_game(server, session);
+  ServerGame *game = new_server_game(server);
+  session->game = game;
+
+  if (strcmp(arg, "solo") == 0) {
+    session->side = None;
+    game->seats[0] = game->seats[1] = session;
+    session_send(server, session, "OK game %d solo", game->id);
+    send_turn(server, game);
+    return;
+  }
+  session->side = White;
+  game->seats[0] = session;
+  session_send(server, session, "OK game %d w", game->id);
+}
+
+void handle_join(Server *server, Session *session, int id) {
+  ServerGame *game = find_server_game(server, id);
+  if (game != NULL && game == session->game) {
+    session_send(server, session, "ERR already in game %d", id);
+    return;
+  }
+  if (game == NULL || game->over || game->seats[1] != NULL) {
+    session_send(server, session, "ERR no free seat in game %d", id);
+    return;
+  }
+  leave_game(server, session);
+
+  session->game = game;
+  session->side = Red;
+  game->seats[1] = session;
+  session_send(server, session, "OK game %d r", game->id);
+  send_turn(server, game);
+}
+
+void handle_line(Server *server, Session *session, char *line) {
+  char command[SERVER_LINE_LEN] = "", arg[SERVER_LINE_LEN] = "";
+  int a = -1, b = -1;
+  sscanf(line, "%s", command);
+  str_to_lower(command);
+
+  if (strcmp(command, "ping") == 0) {
+    session_send(server, session, "OK pong");
+  } else if (strcmp(command, "new") == 0) {
+    sscanf(line, "%*s %s", arg);
+    str_to_lower(arg);
+    handle_new(server, session, arg);
+  } else if (strcmp(command, "join") == 0) {
+    sscanf(line, "%*s %d", &a);
+    handle_join(server, session, a);
+  } else if (strcmp(command, "leave") == 0) {
+    leave_game(server, session);
+    session_send(server, session, "OK");
+  } else if (strcmp(command, "state") == 0 || strcmp(command, "board") == 0) {
+    if (session->game == NULL) {
+      session_send(server, session, "ERR not in a game");
+    } else if (command[0] == 's') {
+      send_state(server, session, &session->game->game_manager);
+    } else {
+      send_board(server, session, &session->game->game_manager);
+    }
+  } else if (strcmp(command, "move") == 0) {
+    ServerGame *game = playing_game(server, session);
+    if (game == NULL)
+      return;
+    if (sscanf(line, "%*s %d %d", &a, &b) < 2) {
+      session_send(server, session, "ERR usage: MOVE <from> <by>");
+      return;
+    }
+    reply_move(server, session, game, game_move(&game->game_manager, a - 1, b));
+  } else if (strcmp(command, "enter") == 0) {
+    ServerGame *game = playing_game(server, session);
+    if (game == NULL)
+      return;
+    if (sscanf(line, "%*s %d", &a) < 1) {
+      session_send(server, session, "ERR usage: ENTER <by>");
+      return;
+    }
+    reply_move(server, session, game, game_enter(&game->game_manager, a));
+  } else if (command[0] != '\0') {
+    session_send(server, session, "ERR unknown command '%s'", command);
+  }
+}
+
+void close_session(Server *server, Session *session) {
+  leave_game(server, session);
+  epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, session->fd, NULL);
+  close(session->fd);
+  *session_slot(server, session->fd) = NULL;
+  vec_free(&session->out);
+  free(session);
+  server->session_count--;
+}
+
+// returns false if the session should be closed
+bool read_session(Server *server, Session *session) {
+  while (true) {
+    ssize_t got = read(session->fd, session->in + session->in_len,
+                       SERVER_LINE_LEN - session->in_len);
+    if (got == 0)
+      return false;
+    if (got < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    session->in_len += got;
+
+    int start = 0;
+    for (int i = 0; i < session->in_len; i++) {
+      if (session->in[i] != '\n')
+        continue;
+      session->in[i] = '\0';
+      if (i > start && session->in[i - 1] == '\r')
+        session->in[i - 1] = '\0';
+      if (!session->discarding)
+        handle_line(server, session, session->in + start);
+      session->discarding = false;
+      start = i + 1;
+    }
+    session->in_len -= start;
+    memmove(session->in, session->in + start, session->in_len);
+
+    if (session->in_len >= SERVER_LINE_LEN) {
+      if (!session->discarding)
+        session_send(server, session, "ERR line too long");
+      session->in_len = 0;
+      session->discarding = true;
+    }
+  }
+}
+
+void accept_sessions(Server *server) {
+  while (true) {
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0)
+      return;
+    Session *session = malloc(sizeof(Session));
+    if (session == NULL || !set_nonblocking(fd)) {
+      close(fd);
+      free(session);
+      continue;
+    }
+    *session = (Session){fd, "", 0, false, {}, 0, false, NULL, None};
+    vec_new(&session->out, sizeof(char));
+    if (session->out.data == NULL)
+      exit(NO_HEAP_MEM_EXIT);
+
+    struct epoll_event event = {EPOLLIN, {.fd = fd}};
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    *session_slot(server, fd) = session;
+    server->session_count++;
+  }
+}
+
+void handle_session_event(Server *server, Session *session,
+                          struct epoll_event *event) {
+  bool alive = !(event->events & (EPOLLERR | EPOLLHUP)) ||
+               (event->events & EPOLLIN);
+  if (alive && (event->events & EPOLLIN))
+    alive = read_session(server, session);
+  if (alive && (event->events & EPOLLOUT))
+    alive = flush_session(server, session);
+
+  if (!alive)
+    close_session(server, session);
+}
+
+// replies can go to the opponent as well, so output is flushed per batch.
+// Closing a session can tell its opponent and grow the list, so the data
+// pointer is read again for every descriptor.
+void flush_dirty_sessions(Server *server) {
+  for (int i = 0; i < server->dirty_fds.len; i++) {
+    int fd = ((int *)server->dirty_fds.data)[i];
+    Session *session = *session_slot(server, fd);
+    if (session != NULL && session->out.len > 0 &&
+        !flush_session(server, session))
+      close_session(server, session);
+  }
+  server->dirty_fds.len = 0;
+}
+
+int listen_unix(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return -1;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// address is "host:port" or just "port"
+int listen_tcp(const char *address) {
+  char host[SERVER_REPLY_LEN] = "127.0.0.1";
+  int port = SERVER_DEFAULT_PORT;
+  if (address != NULL && strchr(address, ':') != NULL)
+    sscanf(address, "%127[^:]:%d", host, &port);
+  else if (address != NULL)
+    sscanf(address, "%d", &port);
+
+  struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    return -1;
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  int reuse = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// every session needs a descriptor, so allow as many as the system lets us
+void raise_fd_limit() {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    return;
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+bool init_server(Server *server, const char *address) {
+  int prefix_len = strlen(UNIX_ADDRESS_PREFIX);
+  if (address != NULL && strncmp(address, UNIX_ADDRESS_PREFIX, prefix_len) == 0)
+    server->listen_fd = listen_unix(address + prefix_len);
+  else
+    server->listen_fd = listen_tcp(address);
+  if (server->listen_fd < 0 || !set_nonblocking(server->listen_fd) ||
+      listen(server->listen_fd, SERVER_BACKLOG) < 0)
+    return false;
+
+  server->epoll_fd = epoll_create1(0);
+  struct epoll_event event = {EPOLLIN, {.fd = server->listen_fd}};
+  if (server->epoll_fd < 0 ||
+      epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event) < 0)
+    return false;
+
+  vec_new(&server->sessions, sizeof(Session *));
+  vec_new(&server->games, sizeof(ServerGame *));
+  vec_new(&server->free_game_ids, sizeof(int));
+  vec_new(&server->dirty_fds, sizeof(int));
+  if (server->sessions.data == NULL || server->games.data == NULL ||
+      server->free_game_ids.data == NULL || server->dirty_fds.data == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  server->session_count = server->game_count = 0;
+  return true;
+}
+
+void free_server(Server *server) {
+  Session **sessions = server->sessions.data;
+  for (int i = 0; i < server->sessions.len; i++) {
+    if (sessions[i] != NULL)
+      close_session(server, sessions[i]);
+  }
+  vec_free(&server->sessions);
+  vec_free(&server->games);
+  vec_free(&server->free_game_ids);
+  vec_free(&server->dirty_fds);
+  close(server->epoll_fd);
+  close(server->listen_fd);
+}
+
+int run_server(const char *address) {
+  Server server;
+  raise_fd_limit();
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, handle_server_stop);
+  signal(SIGTERM, handle_server_stop);
+  init_board_text();
+
+  if (!init_server(&server, address)) {
+    perror("cannot start server");
+    return 1;
+  }
+
+  struct epoll_event events[SERVER_MAX_EVENTS];
+  while (!server_stop) {
+    int count = epoll_wait(server.epoll_fd, events, SERVER_MAX_EVENTS, -1);
+    if (count < 0 && errno != EINTR)
+      break;
+
+    for (int i = 0; i < count; i++) {
+      int fd = events[i].data.fd;
+      if (fd == server.listen_fd) {
+        accept_sessions(&server);
+        continue;
+      }
+      Session *session = *session_slot(&server, fd);
+      if (session != NULL)
+        handle_session_event(&server, session, &events[i]);
+    }
+    flush_dirty_sessions(&server);
+  }
+
+  free_server(&server);
+  return 0;
+}
@@ -0,0 +1,253 @@
+#pragma once
+#include "../headers/game_stats.h"
+#include "eval.c"
+#include "game.c"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+// Totals over a set of games. Every worker keeps its own and they're added
+// up at the end, so the workers share nothing but the file counter.
+typedef struct {
+  long long games, failed, finished, turns, moves, hits;
+  // turns of the finished games only, saves of games quit midway would
+  // shorten the average game
+  long long finished_turns;
+  long long win_kinds[BackgammonWin + 1];
+  // finished games by the opening roll, smaller die first, and the ones
+  // the opener won
+  long long openings[DIE_FACES][DIE_FACES], opener_wins[DIE_FACES][DIE_FACES];
+  // finished games that turned into a race and the turns the race took
+  long long races, race_turns;
+} GameStats;
+
+typedef struct {
+  char **files;
+  int file_count;
+  atomic_int next_file;
+  GameStats partials[MAX_STATS_THREADS];
+} StatsRun;
+
+typedef struct {
+  StatsRun *run;
+  GameStats *stats;
+} StatsWorker;
+
+void merge_game_stats(GameStats *into, GameStats *from) {
+  into->games += from->games;
+  into->failed += from->failed;
+  into->finished += from->finished;
+  into->turns += from->turns;
+  into->finished_turns += from->finished_turns;
+  into->moves += from->moves;
+  into->hits += from->hits;
+  for (int i = 0; i <= BackgammonWin; i++)
+    into->win_kinds[i] += from->win_kinds[i];
+  for (int i = 0; i < DIE_FACES; i++) {
+    for (int j = 0; j < DIE_FACES; j++) {
+      into->openings[i][j] += from->openings[i][j];
+      into->opener_wins[i][j] += from->opener_wins[i][j];
+    }
+  }
+  into->races += from->races;
+  into->race_turns += from->race_turns;
+}
+
+// what a replayed game adds up before it's known to be good
+typedef struct {
+  CheckerKind opener;
+  int lo, hi, turns, race_start;
+  long long moves, hits;
+} StatsReplay;
+
+bool add_replayed_turn(void *ctx, GameManager *game, TurnEntry *turn,
+                       int t) {
+  StatsReplay *replay = ctx;
+  if (t == 0) {
+    replay->opener = game->curr_player;
+    replay->lo = turn->dice1 < turn->dice2 ? turn->dice1 : turn->dice2;
+    replay->hi = turn->dice1 < turn->dice2 ? turn->dice2 : turn->dice1;
+    // the log format fits die values the opening table has no row for
+    if (replay->lo < 1 || replay->hi > DIE_FACES)
+      return false;
+  }
+  if (replay->race_start < 0 && !in_contact(&game->board))
+    replay->race_start = t;
+  replay->turns++;
+  replay->moves += turn->move_count;
+  for (int m = 0; m < turn->move_count; m++)
+    replay->hits += turn->moves[m].hit_enemy;
+  return true;
+}
+
+// a game whose log doesn't lead to the saved board isn't counted
+bool add_saved_game(GameStats *stats, const char *filename) {
+  StatsReplay replay = {None, 1, 1, 0, -1, 0, 0};
+  ReplayHooks hooks = {add_replayed_turn, NULL, &replay};
+  GameManager game;
+  if (!replay_saved_game(filename, &game, &hooks))
+    return false;
+  if (replay.turns == 0)
+    return true;
+
+  stats->games++;
+  stats->turns += replay.turns;
+  stats->moves += replay.moves;
+  stats->hits += replay.hits;
+  WinKind kind;
+  CheckerKind winner = check_game_over(&game, &kind);
+  if (winner != None) {
+    int lo = replay.lo - 1, hi = replay.hi - 1;
+    stats->finished++;
+    stats->finished_turns += replay.turns;
+    stats->openings[lo][hi]++;
+    stats->opener_wins[lo][hi] += winner == replay.opener;
+    stats->win_kinds[kind]++;
+    if (replay.race_start >= 0) {
+      stats->races++;
+      stats->race_turns += replay.turns - replay.race_start;
+    }
+  }
+  return true;
+}
+
+// files are handed out one at a time like in the importer
+void *stats_worker(void *arg) {
+  StatsWorker *worker = arg;
+  StatsRun *run = worker->run;
+  int id;
+  while ((id = atomic_fetch_add(&run->next_file, 1)) < run->file_count) {
+    if (!add_saved_game(worker->stats, run->files[id])) {
+      fprintf(stderr, "skipping %s\n", run->files[id]);
+      worker->stats->failed++;
+    }
+  }
+  return NULL;
+}
+
+double stats_ratio(long long part, long long whole) {
+  return whole > 0 ? (double)part / whole : 0;
+}
+
+void print_stats_csv(GameStats *stats) {
+  printf("stat,value\n");
+  printf("games,%lld\nfailed,%lld\nfinished,%lld\nunfinished,%lld\n",
+         stats->games, stats->failed, stats->finished,
+         stats->games - stats->finished);
+  printf("average_turns,%.3f\n",
+         stats_ratio(stats->finished_turns, stats->finished));
+  printf("hits_per_turn,%.4f\n", stats_ratio(stats->hits, stats->turns));
+  printf("hits_per_move,%.4f\n", stats_ratio(stats->hits, stats->moves));
+  printf("single_rate,%.4f\n",
+         stats_ratio(stats->win_kinds[SingleWin], stats->finished));
+  printf("gammon_rate,%.4f\n",
+         stats_ratio(stats->win_kinds[GammonWin], stats->finished));
+  printf("backgammon_rate,%.4f\n",
+         stats_ratio(stats->win_kinds[BackgammonWin], stats->finished));
+  printf("races,%lld\n", stats->races);
+  printf("average_race_turns,%.3f\n",
+         stats_ratio(stats->race_turns, stats->races));
+
+  printf("\nopening,games,opener_wins,opener_win_rate\n");
+  for (int i = 0; i < DIE_FACES; i++) {
+    for (int j = i + 1; j < DIE_FACES; j++)
+      printf("%d%d,%lld,%lld,%.4f\n", j + 1, i + 1, stats->openings[i][j],
+             stats->opener_wins[i][j],
+             stats_ratio(stats->opener_wins[i][j], stats->openings[i][j]));
+  }
+}
+
+void print_stats_json(GameStats *stats) {
+  printf("{\"games\": %lld, \"failed\": %lld, \"finished\": %lld, "
+         "\"unfinished\": %lld,\n",
+         stats->games, stats->failed, stats->finished,
+         stats->games - stats->finished);
+  printf(" \"average_turns\": %.3f, \"hits_per_turn\": %.4f, "
+         "\"hits_per_move\": %.4f,\n",
+         stats_ratio(stats->finished_turns, stats->finished),
+         stats_ratio(stats->hits, stats->turns),
+         stats_ratio(stats->hits, stats->moves));
+  printf(" \"single_rate\": %.4f, \"gammon_rate\": %.4f, "
+         "\"backgammon_rate\": %.4f,\n",
+         stats_ratio(stats->win_kinds[SingleWin], stats->finished),
+         stats_ratio(stats->win_kinds[GammonWin], stats->finished),
+         stats_ratio(stats->win_kinds[BackgammonWin], stats->finished));
+  printf(" \"races\": %lld, \"average_race_turns\": %.3f,\n", stats->races,
+         stats_ratio(stats->race_turns, stats->races));
+  printf(" \"openings\": {");
+  bool first = true;
+  for (int i = 0; i < DIE_FACES; i++) {
+    for (int j = i + 1; j < DIE_FACES; j++) {
+      printf("%s\n  \"%d%d\": {\"games\": %lld, \"opener_wins\": %lld, "
+             "\"opener_win_rate\": %.4f}",
+             first ? "" : ",", j + 1, i + 1, stats->openings[i][j],
+             stats->opener_wins[i][j],
+             stats_ratio(stats->opener_wins[i][j], stats->openings[i][j]));
+      first = false;
+    }
+  }
+  printf("}}\n");
+}
+
+// usage: stats [-j threads] [--json] <save file>...
+int run_game_stats(int argc, char **argv) {
+  int arg = 1;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  bool json = false;
+  while (arg < argc) {
+    if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+      threads = atoi(argv[arg + 1]);
+      arg += 2;
+    } else if (strcmp(argv[arg], STATS_JSON_FLAG) == 0) {
+      json = true;
+      arg++;
+    } else {
+      break;
+    }
+  }
+  if (arg == argc) {
+    fprintf(stderr, "usage: %s [-j threads] [%s] <save file>...\n", argv[0],
+            STATS_JSON_FLAG);
+    return 1;
+  }
+  if (threads < 1)
+    threads = 1;
+  if (threads > MAX_STATS_THREADS)
+    threads = MAX_STATS_THREADS;
+
+  static StatsRun run;
+  run.files = argv + arg;
+  run.file_count = argc - arg;
+  atomic_init(&run.next_file, 0);
+  if (threads > run.file_count)
+    threads = run.file_count;
+
+  double start = monotonic_seconds();
+  pthread_t handles[MAX_STATS_THREADS];
+  StatsWorker workers[MAX_STATS_THREADS];
+  bool started[MAX_STATS_THREADS] = {false};
+  for (int i = 0; i < threads; i++) {
+    workers[i] = (StatsWorker){&run, &run.partials[i]};
+    if (i > 0)
+      started[i] = pthread_create(&handles[i], NULL, stats_worker,
+                                  &workers[i]) == 0;
+  }
+  stats_worker(&workers[0]);
+  GameStats total;
+  memset(&total, 0, sizeof(total));
+  for (int i = 0; i < threads; i++) {
+    if (i > 0 && started[i])
+      pthread_join(handles[i], NULL);
+    merge_game_stats(&total, &run.partials[i]);
+  }
+  double secs = monotonic_seconds() - start;
+
+  if (json)
+    print_stats_json(&total);
+  else
+    print_stats_csv(&total);
+  fprintf(stderr, "%d files %.2fs %.0f games/s\n", run.file_count, secs,
+          secs > 0 ? total.games / secs : 0);
+  return 0;
+}
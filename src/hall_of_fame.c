@@ -18,6 +18,12 @@ void push_player(HallOfFame *h, PlayerEntry *player) {
   data[h->vec.len++] = *player;
 }
 
+char *copy_name(HallOfFame *h, const char *name) {
+  char *copy = arena_alloc(&h->arena, strlen(name) + 1);
+  strcpy(copy, name);
+  return copy;
+}
+
 void add_player(HallOfFame *h, PlayerEntry *player) {
   for (int i = 0; i < h->vec.len; i++) {
     PlayerEntry *data = h->vec.data;
@@ -27,15 +33,13 @@ void add_player(HallOfFame *h, PlayerEntry *player) {
       return;
     }
   }
-  push_player(h, player);
+  PlayerEntry entry = {player->points, copy_name(h, player->name)};
+  push_player(h, &entry);
 }
 
 void free_entries(HallOfFame *h) {
-  PlayerEntry *data = h->vec.data;
-  for (int i = 0; i < h->vec.len; i++) {
-    free(data[i].name);
-  }
   vec_free(&h->vec);
+  free_arena(&h->arena);
 }
 
 int compare_players(const PlayerEntry *a, const PlayerEntry *b) {
@@ -47,25 +51,23 @@ int compare_players(const PlayerEntry *a, const PlayerEntry *b) {
 }
 
 void sort_players(HallOfFame *h) {
-  qsort(h->vec.data, sizeof(PlayerEntry), h->vec.len,
+  qsort(h->vec.data, h->vec.len, sizeof(PlayerEntry),
         (int (*)(const void *, const void *))compare_players);
 }
 
-bool deserialize_player(FILE *fp, PlayerEntry *player) {
-  char *name = malloc(MAX_INPUT_LEN * sizeof(char));
+bool deserialize_player(HallOfFame *h, FILE *fp, PlayerEntry *player) {
+  char name[MAX_INPUT_LEN];
   int points;
-  if (name == NULL) {
-    exit(NO_HEAP_MEM_EXIT);
-  }
   if (fscanf(fp, "%s %d\n", name, &points) != 2)
     return false;
 
-  *player = (PlayerEntry){points, name};
+  *player = (PlayerEntry){points, copy_name(h, name)};
   return true;
 }
 
 bool deserialize_entries(HallOfFame *h, FILE *fp) {
-  vec_new(&h->vec, sizeof(PlayerEntry));
+  h->arena = (Arena){NULL, NULL, NULL};
+  vec_in_arena(&h->vec, sizeof(PlayerEntry), DEFAULT_CAP, &h->arena);
 
   if (h->vec.data == NULL) {
     exit(NO_HEAP_MEM_EXIT);
@@ -77,7 +79,7 @@ bool deserialize_entries(HallOfFame *h, FILE *fp) {
   if (fscanf(fp, "%s\n", header) != 1 || strcmp(header, FAME_HEADER) != 0)
     return false;
 
-  while (deserialize_player(fp, &player)) {
+  while (deserialize_player(h, fp, &player)) {
     push_player(h, &player);
   }
 
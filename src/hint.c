@@ -0,0 +1,410 @@
+#pragma once
+#include "../headers/hint.h"
+#include "engine.c"
+#include <pthread.h>
+#include <string.h>
+
+typedef struct {
+  Play play;
+  float equity;
+} HintPlay;
+
+// Analysis running on all cores while the UI waits for input. The position
+// of the human's turn is scored for the hint, and against the computer its
+// replies to every roll are searched from the end of the human's turn the
+// hint predicts. Every new position or prediction bumps a generation, so
+// the work still running on an old one is dropped when it's done.
+typedef struct {
+  pthread_t threads[MAX_ENGINE_THREADS];
+  int thread_count;
+  bool started, stop;
+  pthread_mutex_t lock;
+  // wake tells the threads about new work, done the UI about a reply
+  pthread_cond_t wake, done;
+  EngineConfig config;
+  Network network, race_network;
+  OpeningBook book;
+  HyperDatabase hyper;
+
+  unsigned generation;
+  GameManager position;
+  bool has_position, hint_taken;
+  HintPlay hints[MAX_HINT_PLAYS];
+  // plies of the hints shown, -1 before the first stage is done
+  int hint_count, hint_plies;
+
+  unsigned ponder_generation;
+  bool pondering;
+  GameManager ponder_state;
+  int next_roll;
+  bool ponder_done[ROLL_COUNT], ponder_found[ROLL_COUNT];
+  Play ponder_plays[ROLL_COUNT];
+} Analyst;
+
+Analyst analyst;
+
+int roll_index(int v1, int v2) {
+  DiceRoll rolls[ROLL_COUNT];
+  int weights[ROLL_COUNT];
+  all_rolls(rolls, weights);
+  for (int i = 0; i < ROLL_COUNT; i++) {
+    if ((rolls[i].v1 == v1 && rolls[i].v2 == v2) ||
+        (rolls[i].v1 == v2 && rolls[i].v2 == v1))
+      return i;
+  }
+  return -1;
+}
+
+bool same_dice(DiceRoll *a, DiceRoll *b) {
+  return a->v1 == b->v1 && a->v2 == b->v2 && a->used1 == b->used1 &&
+         a->used2 == b->used2 &&
+         a->doublet_times_used == b->doublet_times_used;
+}
+
+// the position of a game without its turn log
+GameManager analysis_state(GameManager *game_manager, Board *board,
+                           CheckerKind on_roll, DiceRoll dice_roll) {
+  GameManager state = position_state(board, on_roll, dice_roll);
+  state.match = game_manager->match;
+  state.rules = game_manager->rules;
+  state.variant = game_manager->variant;
+  state.computer = game_manager->computer;
+  return state;
+}
+
+// the computer's replies after the predicted end of the human's turn, kept
+// when the prediction doesn't change; called with the lock held
+void start_pondering(Analyst *a, Board *board) {
+  CheckerKind side = opposite_checker(a->position.curr_player);
+  if (a->pondering && a->ponder_state.curr_player == side &&
+      same_board(&a->ponder_state.board, board))
+    return;
+  a->ponder_generation++;
+  a->pondering = true;
+  a->ponder_state =
+      analysis_state(&a->position, board, side, new_dice_roll(0, 0));
+  a->next_roll = 0;
+  memset(a->ponder_done, 0, sizeof(a->ponder_done));
+  pthread_cond_broadcast(&a->wake);
+}
+
+// keeps a stage of the hint unless the position changed meanwhile
+bool publish_hints(Analyst *a, unsigned generation, PlayList *plays,
+                   FilterCandidate *candidates, int count, int plies) {
+  pthread_mutex_lock(&a->lock);
+  bool current = generation == a->generation;
+  if (current) {
+    a->hint_count = count < MAX_HINT_PLAYS ? count : MAX_HINT_PLAYS;
+    for (int i = 0; i < a->hint_count; i++)
+      a->hints[i] =
+          (HintPlay){*play_at(plays, candidates[i].id), candidates[i].equity};
+    a->hint_plies = plies;
+    if (plies == HINT_PLIES && a->position.computer != None)
+      start_pondering(a, count > 0 ? &a->hints[0].play.board
+                                   : &a->position.board);
+  }
+  pthread_mutex_unlock(&a->lock);
+  return current;
+}
+
+// filter_plays keeping the best plays of every stage instead of one
+void analyse_hints(Analyst *a, GameManager *state, EngineConfig *config,
+                   unsigned generation) {
+  use_game_rules(config, state);
+  Arena *arena = scratch_arena();
+  ArenaMark mark = arena_mark(arena);
+  PlayList plays;
+  new_play_list_in(&plays, arena);
+  generate_plays(state, &plays);
+  int count = play_count(&plays);
+  FilterCandidate *candidates =
+      arena_alloc(arena, (count + 1) * sizeof(FilterCandidate));
+  for (int i = 0; i < count; i++)
+    candidates[i].id = i;
+
+  for (int plies = 0; plies <= HINT_PLIES; plies++) {
+    for (int i = 0; i < count; i++) {
+      FilterCandidate *candidate = &candidates[i];
+      evaluate_play(config, play_at(&plays, candidate->id),
+                    state->curr_player, plies, &candidate->eval);
+      candidate->equity = eval_equity(&candidate->eval);
+    }
+    qsort(candidates, count, sizeof(FilterCandidate), compare_candidates);
+    if (!publish_hints(a, generation, &plays, candidates, count, plies))
+      break;
+    if (count > HINT_CANDIDATES)
+      count = HINT_CANDIDATES;
+  }
+  arena_release(arena, mark);
+}
+
+void ponder_roll(Analyst *a, GameManager *state, EngineConfig *config,
+                 int roll, unsigned generation) {
+  DiceRoll rolls[ROLL_COUNT];
+  int weights[ROLL_COUNT];
+  all_rolls(rolls, weights);
+  state->dice_roll = rolls[roll];
+  Play play;
+  EvalOutput eval;
+  FilterStats stats;
+  bool found = best_play(config, state, &play, &eval, &stats);
+
+  pthread_mutex_lock(&a->lock);
+  if (generation == a->ponder_generation) {
+    a->ponder_found[roll] = found;
+    a->ponder_plays[roll] = play;
+    a->ponder_done[roll] = true;
+    pthread_cond_broadcast(&a->done);
+  }
+  pthread_mutex_unlock(&a->lock);
+}
+
+// the hint goes first, then the rolls to ponder one at a time
+void *analyst_worker(void *arg) {
+  Analyst *a = arg;
+  pthread_mutex_lock(&a->lock);
+  while (!a->stop) {
+    EngineConfig config = a->config;
+    if (a->has_position && !a->hint_taken) {
+      a->hint_taken = true;
+      GameManager state = a->position;
+      unsigned generation = a->generation;
+      config.plies = HINT_PLIES;
+      pthread_mutex_unlock(&a->lock);
+      analyse_hints(a, &state, &config, generation);
+      pthread_mutex_lock(&a->lock);
+    } else if (a->pondering && a->next_roll < ROLL_COUNT) {
+      int roll = a->next_roll++;
+      GameManager state = a->ponder_state;
+      unsigned generation = a->ponder_generation;
+      pthread_mutex_unlock(&a->lock);
+      ponder_roll(a, &state, &config, roll, generation);
+      pthread_mutex_lock(&a->lock);
+    } else {
+      pthread_cond_wait(&a->wake, &a->lock);
+    }
+  }
+  pthread_mutex_unlock(&a->lock);
+  free_arena(scratch_arena());
+  return NULL;
+}
+
+// loads what the engine loads at startup, the first time it's needed
+void start_analyst(Analyst *a) {
+  if (a->started)
+    return;
+  a->started = true;
+  init_match_equity();
+  if (load_network(&a->network, NETWORK_FILE))
+    eval_network = &a->network;
+  if (load_network(&a->race_network, RACE_NETWORK_FILE))
+    race_network = &a->race_network;
+  if (load_opening_book(&a->book, BOOK_FILE))
+    opening_book = &a->book;
+  if (load_hyper_database(&a->hyper, HYPER_FILE))
+    hyper_db = &a->hyper;
+  a->config = default_engine_config();
+  a->config.plies = COMPUTER_PLIES;
+  pthread_mutex_init(&a->lock, NULL);
+  pthread_cond_init(&a->wake, NULL);
+  pthread_cond_init(&a->done, NULL);
+  for (int i = 0; i < online_cpus(); i++) {
+    if (pthread_create(&a->threads[a->thread_count], NULL, analyst_worker,
+                       a) == 0)
+      a->thread_count++;
+  }
+}
+
+// the human is to move in the position, the same one again changes nothing
+void analyse_position(GameManager *game_manager) {
+  Analyst *a = &analyst;
+  if (game_manager->curr_player == game_manager->computer)
+    return;
+  start_analyst(a);
+  pthread_mutex_lock(&a->lock);
+  if (!a->has_position ||
+      a->position.curr_player != game_manager->curr_player ||
+      !same_dice(&a->position.dice_roll, &game_manager->dice_roll) ||
+      !same_board(&a->position.board, &game_manager->board)) {
+    a->generation++;
+    a->position =
+        analysis_state(game_manager, &game_manager->board,
+                       game_manager->curr_player, game_manager->dice_roll);
+    a->has_position = true;
+    a->hint_taken = false;
+    a->hint_count = 0;
+    a->hint_plies = -1;
+    pthread_cond_broadcast(&a->wake);
+  }
+  pthread_mutex_unlock(&a->lock);
+}
+
+// drops the work on the game, the threads go idle
+void stop_analysis() {
+  Analyst *a = &analyst;
+  if (!a->started)
+    return;
+  pthread_mutex_lock(&a->lock);
+  a->generation++;
+  a->ponder_generation++;
+  a->has_position = false;
+  a->pondering = false;
+  pthread_mutex_unlock(&a->lock);
+}
+
+void free_analyst() {
+  Analyst *a = &analyst;
+  if (!a->started)
+    return;
+  pthread_mutex_lock(&a->lock);
+  a->stop = true;
+  pthread_cond_broadcast(&a->wake);
+  pthread_mutex_unlock(&a->lock);
+  for (int i = 0; i < a->thread_count; i++)
+    pthread_join(a->threads[i], NULL);
+  pthread_mutex_destroy(&a->lock);
+  pthread_cond_destroy(&a->wake);
+  pthread_cond_destroy(&a->done);
+  free_opening_book(&a->book);
+  free_hyper_database(&a->hyper);
+  opening_book = NULL;
+  hyper_db = NULL;
+  eval_network = race_network = NULL;
+  memset(a, 0, sizeof(*a));
+}
+
+// steps as the prompts take them: point, or bar, and die, '*' for a hit
+void format_play(Play *play, char *out) {
+  out[0] = '\0';
+  for (int i = 0; i < play->move_count; i++) {
+    MoveEntry *move = &play->moves[i];
+    int len = strlen(out);
+    if (is_pos_on_bar(move->from))
+      snprintf(out + len, MAX_PLAY_TEXT_LEN - len, "%sbar:%d%s",
+               i > 0 ? " " : "", move->by, move->hit_enemy ? "*" : "");
+    else
+      snprintf(out + len, MAX_PLAY_TEXT_LEN - len, "%s%d:%d%s",
+               i > 0 ? " " : "", move->from + 1, move->by,
+               move->hit_enemy ? "*" : "");
+  }
+  if (play->move_count == 0)
+    snprintf(out, MAX_PLAY_TEXT_LEN, "no move");
+}
+
+// whatever the analysis has so far, it never waits for it
+void show_hints(WinManager *win_manager) {
+  Analyst *a = &analyst;
+  WinWrapper *io_wrapper = &win_manager->io_win;
+  HintPlay hints[MAX_HINT_PLAYS];
+  int count = 0, plies = -1;
+  if (a->started) {
+    pthread_mutex_lock(&a->lock);
+    if (a->has_position) {
+      count = a->hint_count;
+      plies = a->hint_plies;
+      memcpy(hints, a->hints, count * sizeof(HintPlay));
+    }
+    pthread_mutex_unlock(&a->lock);
+  }
+
+  clear_win(io_wrapper);
+  if (plies < 0)
+    printf_centered_nl(io_wrapper, "Hint: still thinking");
+  else if (count == 0)
+    printf_centered_nl(io_wrapper, "Hint: no legal move");
+  for (int i = 0; i < count; i++) {
+    char text[MAX_PLAY_TEXT_LEN];
+    format_play(&hints[i].play, text);
+    printf_centered_nl(io_wrapper, "%d. %s  %+.3f  %d-ply%s", i + 1, text,
+                       hints[i].equity, plies,
+                       plies < HINT_PLIES ? ", thinking" : "");
+  }
+}
+
+// the pondered reply when the human's turn ended as predicted, waiting for
+// it when its roll is still being searched
+bool pondered_play(Analyst *a, GameManager *game_manager, Play *play,
+                   bool *found) {
+  int roll =
+      roll_index(game_manager->dice_roll.v1, game_manager->dice_roll.v2);
+  pthread_mutex_lock(&a->lock);
+  bool hit = a->thread_count > 0 && a->pondering &&
+             a->ponder_state.curr_player == game_manager->curr_player &&
+             same_board(&a->ponder_state.board, &game_manager->board);
+  unsigned generation = a->ponder_generation;
+  while (hit && !a->ponder_done[roll] && generation == a->ponder_generation)
+    pthread_cond_wait(&a->done, &a->lock);
+  hit = hit && generation == a->ponder_generation;
+  if (hit) {
+    *play = a->ponder_plays[roll];
+    *found = a->ponder_found[roll];
+  }
+  // the human's turn is over, and this ponder with it
+  a->has_position = false;
+  a->pondering = false;
+  a->generation++;
+  a->ponder_generation++;
+  pthread_mutex_unlock(&a->lock);
+  return hit;
+}
+
+// plays the computer's turn through the same moves a human makes, a step
+// that doesn't go through leaves the rest of the turn to the prompts
+void computer_turn(WinManager *win_manager, GameManager *game_manager,
+                   char *play_text) {
+  Analyst *a = &analyst;
+  start_analyst(a);
+  Play play;
+  bool found = false;
+  if (!pondered_play(a, game_manager, &play, &found)) {
+    EngineConfig config = a->config;
+    GameManager state =
+        analysis_state(game_manager, &game_manager->board,
+                       game_manager->curr_player, game_manager->dice_roll);
+    EvalOutput eval;
+    FilterStats stats;
+    found = best_play(&config, &state, &play, &eval, &stats);
+  }
+  if (!found)
+    play.move_count = 0;
+
+  format_play(&play, play_text);
+  for (int i = 0; i < play.move_count; i++) {
+    MoveEntry *move = &play.moves[i];
+    bool legal = is_pos_on_bar(move->from)
+                     ? player_enter(win_manager, game_manager, move->by)
+                     : player_move(win_manager, game_manager, move->from,
+                                   move->by);
+    if (!legal)
+      break;
+    use_roll_val(&game_manager->dice_roll, move->by);
+  }
+  display_game(win_manager, game_manager);
+}
+
+void analyse_cube_action(GameManager *game_manager, CubeAnalysis *analysis) {
+  Analyst *a = &analyst;
+  start_analyst(a);
+  EngineConfig config = a->config;
+  use_game_rules(&config, game_manager);
+  EvalOutput eval;
+  evaluate_plies(&config, &game_manager->board, game_manager->curr_player,
+                 config.plies, &eval);
+  analyse_cube(&game_manager->match, game_manager->curr_player, &eval,
+               analysis);
+}
+
+// before the computer rolls, it doubles when the opponent should still take
+// or already pass, and plays on when it's too good
+bool computer_doubles(GameManager *game_manager) {
+  CubeAnalysis analysis;
+  analyse_cube_action(game_manager, &analysis);
+  return analysis.decision == DoubleTake || analysis.decision == DoublePass;
+}
+
+// the human on roll doubled, the computer takes when passing costs more
+bool computer_takes(GameManager *game_manager) {
+  CubeAnalysis analysis;
+  analyse_cube_action(game_manager, &analysis);
+  return analysis.double_take <= analysis.double_pass;
+}
@@ -0,0 +1,462 @@
+#pragma once
+#include "../headers/eval.h"
+#include "../headers/hypergammon.h"
+#include "../headers/movegen.h"
+#include "game.c"
+#include "position.c"
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+  char magic[HYPER_MAGIC_LEN];
+  uint32_t checkers;
+  uint32_t side_count;
+  uint32_t iterations;
+  uint32_t reserved;
+} HyperHeader;
+
+typedef struct {
+  void *map;
+  size_t map_len;
+  int checkers;
+  int side_count;
+  const int16_t *equities;
+} HyperDatabase;
+
+// exact hypergammon equities evaluate_position uses when they fit
+HyperDatabase *hyper_db = NULL;
+
+int hyper_binomials[HYPER_SLOTS + MAX_HYPER_CHECKERS][MAX_HYPER_CHECKERS + 1];
+pthread_once_t hyper_once = PTHREAD_ONCE_INIT;
+
+void init_hyper_binomials() {
+  for (int n = 0; n < HYPER_SLOTS + MAX_HYPER_CHECKERS; n++) {
+    hyper_binomials[n][0] = 1;
+    for (int k = 1; k <= MAX_HYPER_CHECKERS; k++)
+      hyper_binomials[n][k] = n == 0 ? 0
+                                     : hyper_binomials[n - 1][k - 1] +
+                                           hyper_binomials[n - 1][k];
+  }
+}
+
+int hyper_choose(int n, int k) { return hyper_binomials[n][k]; }
+
+// placements of checkers indistinguishable checkers on the slots
+int hyper_side_count(int checkers) {
+  return hyper_choose(HYPER_SLOTS + checkers - 1, checkers);
+}
+
+// rank of the placement among all of them: with the slots sorted, slot + i
+// of the i-th checker is an increasing sequence
+int hyper_side_index(const uint8_t *counts) {
+  int index = 0, checker = 0;
+  for (int slot = 0; slot < HYPER_SLOTS; slot++) {
+    for (int i = 0; i < counts[slot]; i++, checker++)
+      index += hyper_choose(slot + checker, checker + 1);
+  }
+  return index;
+}
+
+void hyper_side_counts(int index, int checkers, uint8_t *counts) {
+  memset(counts, 0, HYPER_SLOTS);
+  for (int checker = checkers - 1; checker >= 0; checker--) {
+    int val = checker;
+    while (hyper_choose(val + 1, checker + 1) <= index)
+      val++;
+    index -= hyper_choose(val, checker + 1);
+    counts[val - checker]++;
+  }
+}
+
+typedef struct {
+  int me, opp;
+  int steps;
+  bool used_larger;
+  // points the play scores when it bears off the last checker, else 0
+  int won;
+} HyperPlay;
+
+typedef struct {
+  HyperPlay plays[MAX_HYPER_PLAYS];
+  int count;
+} HyperPlays;
+
+typedef struct {
+  int checkers, side_count;
+  // placement and farthest slot of every side index, decoded once
+  uint8_t (*sides)[HYPER_SLOTS];
+  uint8_t *backs;
+  // side index after moving a checker, by side, from slot and to slot
+  int *moves;
+  float *values, *next;
+} HyperSolver;
+
+// the farthest checker of the side, 0 when all are off
+int hyper_back(const uint8_t *counts) {
+  for (int slot = HYPER_BAR; slot > 0; slot--)
+    if (counts[slot] > 0)
+      return slot;
+  return 0;
+}
+
+int hyper_move(HyperSolver *solver, int side, int from, int to) {
+  return solver->moves[(side * HYPER_SLOTS + from) * HYPER_SLOTS + to];
+}
+
+void fill_hyper_moves(HyperSolver *solver) {
+  for (int side = 0; side < solver->side_count; side++) {
+    uint8_t counts[HYPER_SLOTS];
+    memcpy(counts, solver->sides[side], HYPER_SLOTS);
+    solver->backs[side] = hyper_back(counts);
+    for (int from = 0; from < HYPER_SLOTS; from++) {
+      if (counts[from] == 0)
+        continue;
+      counts[from]--;
+      for (int to = 0; to < HYPER_SLOTS; to++) {
+        counts[to]++;
+        solver->moves[(side * HYPER_SLOTS + from) * HYPER_SLOTS + to] =
+            hyper_side_index(counts);
+        counts[to]--;
+      }
+      counts[from]++;
+    }
+  }
+}
+
+int hyper_win_points(const uint8_t *loser) {
+  if (loser[0] > 0)
+    return 1;
+  // slots 19-24 of the loser are the winner's home board, then the bar
+  for (int slot = BOARD_SIZE - 5; slot <= HYPER_BAR; slot++)
+    if (loser[slot] > 0)
+      return 3;
+  return 2;
+}
+
+void add_hyper_play(HyperSolver *solver, HyperPlays *plays, int me, int opp,
+                    int steps, bool used_larger) {
+  for (int i = 0; i < plays->count; i++) {
+    HyperPlay *play = &plays->plays[i];
+    if (play->me == me && play->opp == opp) {
+      if (steps > play->steps)
+        play->steps = steps;
+      play->used_larger |= used_larger;
+      return;
+    }
+  }
+  if (plays->count == MAX_HYPER_PLAYS)
+    return;
+  int won = solver->sides[me][0] == solver->checkers
+                ? hyper_win_points(solver->sides[opp])
+                : 0;
+  plays->plays[plays->count++] =
+      (HyperPlay){me, opp, steps, used_larger, won};
+}
+
+// standard rules: enter first, bear off with a bigger die only from the
+// farthest checker
+void hyper_plays_from(HyperSolver *solver, int me, int opp, const int *dice,
+                      int dice_left, int larger, int steps, bool used_larger,
+                      HyperPlays *plays) {
+  const uint8_t *mine = solver->sides[me], *theirs = solver->sides[opp];
+  int back = solver->backs[me];
+  bool moved = false;
+  if (dice_left > 0 && back > 0) {
+    int die = dice[0];
+    for (int from = back; from > 0; from--) {
+      if (mine[from] == 0 || (back == HYPER_BAR && from != HYPER_BAR))
+        continue;
+      int to = from - die;
+      if (to <= 0 && (back > HYPER_HOME_POINTS || (to < 0 && from != back)))
+        continue;
+      if (to < 0)
+        to = 0;
+      int opp_slot = HYPER_BAR - to;
+      if (to > 0 && theirs[opp_slot] >= 2)
+        continue;
+
+      int next_opp = to > 0 && theirs[opp_slot] == 1
+                         ? hyper_move(solver, opp, opp_slot, HYPER_BAR)
+                         : opp;
+      hyper_plays_from(solver, hyper_move(solver, me, from, to), next_opp,
+                       dice + 1, dice_left - 1, larger, steps + 1,
+                       used_larger || die == larger, plays);
+      moved = true;
+    }
+  }
+  if (!moved)
+    add_hyper_play(solver, plays, me, opp, steps, used_larger);
+}
+
+// every play of the roll that uses as many dice as possible, and the larger
+// die when only one can be used
+void hyper_plays(HyperSolver *solver, int me, int opp, int v1, int v2,
+                 HyperPlays *plays) {
+  plays->count = 0;
+  int larger = v1 > v2 ? v1 : v2;
+  if (v1 == v2) {
+    int dice[] = {v1, v1, v1, v1};
+    hyper_plays_from(solver, me, opp, dice, 4, larger, 0, false, plays);
+  } else {
+    int dice[] = {v1, v2, v1};
+    hyper_plays_from(solver, me, opp, dice, 2, larger, 0, false, plays);
+    hyper_plays_from(solver, me, opp, dice + 1, 2, larger, 0, false, plays);
+  }
+
+  int most = 0;
+  bool larger_fits = false;
+  for (int i = 0; i < plays->count; i++) {
+    if (plays->plays[i].steps > most)
+      most = plays->plays[i].steps;
+    larger_fits |= plays->plays[i].used_larger;
+  }
+  bool need_larger = most == 1 && v1 != v2 && larger_fits;
+  int kept = 0;
+  for (int i = 0; i < plays->count; i++) {
+    HyperPlay *play = &plays->plays[i];
+    if (play->steps == most && (!need_larger || play->used_larger))
+      plays->plays[kept++] = *play;
+  }
+  plays->count = kept;
+}
+
+// no side has won yet and no point holds checkers of both
+bool hyper_state_valid(const uint8_t *me, const uint8_t *opp, int checkers) {
+  if (me[0] == checkers || opp[0] == checkers)
+    return false;
+  for (int point = 1; point <= BOARD_SIZE; point++)
+    if (me[point] > 0 && opp[HYPER_BAR - point] > 0)
+      return false;
+  return true;
+}
+
+// one Bellman update: every roll played to the best equity for the mover
+float hyper_update(HyperSolver *solver, int me, int opp, HyperPlays *plays) {
+  float value = 0;
+  for (int v1 = 1; v1 <= 6; v1++) {
+    for (int v2 = v1; v2 <= 6; v2++) {
+      hyper_plays(solver, me, opp, v1, v2, plays);
+      float best = -4;
+      for (int i = 0; i < plays->count; i++) {
+        HyperPlay *play = &plays->plays[i];
+        float equity =
+            play->won > 0
+                ? play->won
+                : -solver->values[play->opp * solver->side_count + play->me];
+        if (equity > best)
+          best = equity;
+      }
+      value += best * (v1 == v2 ? 1 : 2) / (float)ROLL_OUTCOMES;
+    }
+  }
+  return value;
+}
+
+typedef struct {
+  HyperSolver *solver;
+  int first_side, end_side;
+  float max_delta;
+  pthread_t thread;
+  bool started;
+} HyperWorker;
+
+void *hyper_worker(void *arg) {
+  HyperWorker *worker = arg;
+  HyperSolver *solver = worker->solver;
+  static _Thread_local HyperPlays plays;
+  worker->max_delta = 0;
+  for (int me = worker->first_side; me < worker->end_side; me++) {
+    for (int opp = 0; opp < solver->side_count; opp++) {
+      int index = me * solver->side_count + opp;
+      if (!hyper_state_valid(solver->sides[me], solver->sides[opp],
+                             solver->checkers)) {
+        solver->next[index] = 0;
+        continue;
+      }
+      float value = hyper_update(solver, me, opp, &plays);
+      float delta = fabsf(value - solver->values[index]);
+      if (delta > worker->max_delta)
+        worker->max_delta = delta;
+      solver->next[index] = value;
+    }
+  }
+  return NULL;
+}
+
+bool save_hyper_database(HyperSolver *solver, int iterations,
+                         const char *filename) {
+  char tmp[MAX_FILENAME_LEN];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+  FILE *fp = fopen(tmp, "wb");
+  if (fp == NULL)
+    return false;
+  HyperHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, HYPER_MAGIC, sizeof(HYPER_MAGIC));
+  header.checkers = solver->checkers;
+  header.side_count = solver->side_count;
+  header.iterations = iterations;
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+  long long states = (long long)solver->side_count * solver->side_count;
+  for (long long i = 0; i < states && ok; i++) {
+    int16_t equity = lrintf(solver->values[i] * HYPER_EQUITY_SCALE);
+    ok = fwrite(&equity, sizeof(equity), 1, fp) == 1;
+  }
+  ok = fclose(fp) == 0 && ok;
+  return ok && rename(tmp, filename) == 0;
+}
+
+// Jacobi value iteration over every state, the threads split the states
+// by the side on roll
+int run_hyper_solver(int checkers, const char *filename, int threads) {
+  if (checkers < 1 || checkers > MAX_HYPER_CHECKERS)
+    checkers = HYPERGAMMON_CHECKER_COUNT;
+  pthread_once(&hyper_once, init_hyper_binomials);
+  HyperSolver solver;
+  memset(&solver, 0, sizeof(solver));
+  solver.checkers = checkers;
+  solver.side_count = hyper_side_count(checkers);
+  long long states = (long long)solver.side_count * solver.side_count;
+  solver.sides = malloc(solver.side_count * sizeof(*solver.sides));
+  solver.backs = malloc(solver.side_count);
+  solver.moves =
+      malloc((size_t)solver.side_count * HYPER_SLOTS * HYPER_SLOTS *
+             sizeof(int));
+  solver.values = calloc(states, sizeof(float));
+  solver.next = calloc(states, sizeof(float));
+  if (solver.sides == NULL || solver.backs == NULL || solver.moves == NULL ||
+      solver.values == NULL || solver.next == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  for (int i = 0; i < solver.side_count; i++)
+    hyper_side_counts(i, checkers, solver.sides[i]);
+  fill_hyper_moves(&solver);
+
+  HyperWorker workers[MAX_HYPER_THREADS];
+  if (threads < 1 || threads > MAX_HYPER_THREADS)
+    threads = 1;
+  double start = monotonic_seconds();
+  int iteration = 0;
+  float max_delta = 1;
+  while (max_delta > HYPER_TOLERANCE && iteration < MAX_HYPER_ITERATIONS) {
+    for (int i = 0; i < threads; i++) {
+      workers[i].solver = &solver;
+      workers[i].first_side = solver.side_count * i / threads;
+      workers[i].end_side = solver.side_count * (i + 1) / threads;
+      workers[i].started =
+          i > 0 && pthread_create(&workers[i].thread, NULL, hyper_worker,
+                                  &workers[i]) == 0;
+    }
+    // every worker owns a range of the table, the ones whose thread didn't
+    // start are swept here
+    max_delta = 0;
+    for (int i = 0; i < threads; i++) {
+      if (workers[i].started)
+        pthread_join(workers[i].thread, NULL);
+      else
+        hyper_worker(&workers[i]);
+      if (workers[i].max_delta > max_delta)
+        max_delta = workers[i].max_delta;
+    }
+    float *swap = solver.values;
+    solver.values = solver.next;
+    solver.next = swap;
+    iteration++;
+    fprintf(stderr, "iteration %d: max change %.6f, %.1fs\n", iteration,
+            max_delta, monotonic_seconds() - start);
+  }
+
+  bool saved = save_hyper_database(&solver, iteration, filename);
+  if (!saved)
+    fprintf(stderr, "can't write %s\n", filename);
+  else
+    fprintf(stderr, "%lld states, %d checkers, saved to %s\n", states,
+            checkers, filename);
+  free(solver.sides);
+  free(solver.backs);
+  free(solver.moves);
+  free(solver.values);
+  free(solver.next);
+  return saved ? 0 : 1;
+}
+
+bool load_hyper_database(HyperDatabase *db, const char *filename) {
+  pthread_once(&hyper_once, init_hyper_binomials);
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(HyperHeader)) {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  const HyperHeader *header = map;
+  size_t states = (size_t)header->side_count * header->side_count;
+  if (memcmp(header->magic, HYPER_MAGIC, HYPER_MAGIC_LEN) != 0 ||
+      header->checkers < 1 || header->checkers > MAX_HYPER_CHECKERS ||
+      header->side_count != (uint32_t)hyper_side_count(header->checkers) ||
+      sizeof(HyperHeader) + states * sizeof(int16_t) > (size_t)st.st_size) {
+    munmap(map, st.st_size);
+    return false;
+  }
+  db->map = map;
+  db->map_len = st.st_size;
+  db->checkers = header->checkers;
+  db->side_count = header->side_count;
+  db->equities = (const int16_t *)((const char *)map + sizeof(HyperHeader));
+  return true;
+}
+
+void free_hyper_database(HyperDatabase *db) {
+  if (db->map != NULL)
+    munmap(db->map, db->map_len);
+  db->map = NULL;
+}
+
+// placement of the side's checkers, false when the count doesn't fit
+bool hyper_side_from_board(Board *board, CheckerKind side, int checkers,
+                           uint8_t *counts) {
+  int total = side == White ? board->white_out_count : board->red_out_count;
+  counts[0] = total;
+  for (int slot = 0; slot < POSITION_SLOT_COUNT; slot++) {
+    counts[slot + 1] = slot_count(board, side, slot);
+    total += counts[slot + 1];
+  }
+  return total == checkers;
+}
+
+// Exact equity from the database spread over the outputs so eval_equity
+// gives it back: the win chance up to one point, then gammons and
+// backgammons. Only the equity is exact.
+bool hyper_evaluate(HyperDatabase *db, Board *board, CheckerKind on_roll,
+                    EvalOutput *out) {
+  uint8_t me[HYPER_SLOTS], opp[HYPER_SLOTS];
+  if (!hyper_side_from_board(board, on_roll, db->checkers, me) ||
+      !hyper_side_from_board(board, opposite_checker(on_roll), db->checkers,
+                             opp) ||
+      !hyper_state_valid(me, opp, db->checkers))
+    return false;
+
+  int index = hyper_side_index(me) * db->side_count + hyper_side_index(opp);
+  float equity = db->equities[index] / HYPER_EQUITY_SCALE;
+  float extra = fabsf(equity) > 1 ? fabsf(equity) - 1 : 0;
+  float gammon = extra < 1 ? extra : 1;
+  float backgammon = extra > 1 ? extra - 1 : 0;
+  if (equity >= 0)
+    *out = (EvalOutput){equity > 1 ? 1 : (1 + equity) / 2, gammon,
+                        backgammon, 0, 0};
+  else
+    *out = (EvalOutput){equity < -1 ? 0 : (1 + equity) / 2, 0, 0, gammon,
+                        backgammon};
+  return true;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include "../headers/journal.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// An append-only log file. Records are written and flushed as they come,
+// so a crash of the process loses nothing. A background thread fsyncs at
+// most every JOURNAL_SYNC_MS, so the input loop never waits on the disk
+// and a power loss costs at most that much.
+typedef struct {
+  FILE *fp;
+  char path[MAX_JOURNAL_PATH];
+  pthread_t syncer;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  // dirty: records since the last fsync, syncing: fsync outside the lock
+  bool open, dirty, syncing, stop;
+} Journal;
+
+void *journal_syncer(void *arg) {
+  Journal *journal = arg;
+  pthread_mutex_lock(&journal->lock);
+  while (!journal->stop) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += (JOURNAL_SYNC_MS % 1000) * 1000000L;
+    until.tv_sec += JOURNAL_SYNC_MS / 1000 + until.tv_nsec / 1000000000L;
+    until.tv_nsec %= 1000000000L;
+    pthread_cond_timedwait(&journal->wake, &journal->lock, &until);
+    if (!journal->dirty || journal->fp == NULL)
+      continue;
+    int fd = fileno(journal->fp);
+    journal->dirty = false;
+    journal->syncing = true;
+    pthread_mutex_unlock(&journal->lock);
+    fsync(fd);
+    pthread_mutex_lock(&journal->lock);
+    journal->syncing = false;
+    pthread_cond_broadcast(&journal->wake);
+  }
+  pthread_mutex_unlock(&journal->lock);
+  return NULL;
+}
+
+// the file can only be swapped or closed while no fsync is running on it
+void wait_journal_sync(Journal *journal) {
+  while (journal->syncing)
+    pthread_cond_wait(&journal->wake, &journal->lock);
+}
+
+bool open_journal(Journal *journal, const char *path) {
+  memset(journal, 0, sizeof(*journal));
+  snprintf(journal->path, sizeof(journal->path), "%s", path);
+  pthread_mutex_init(&journal->lock, NULL);
+  pthread_cond_init(&journal->wake, NULL);
+  if (pthread_create(&journal->syncer, NULL, journal_syncer, journal) != 0)
+    return false;
+  journal->open = true;
+  return true;
+}
+
+// the snapshot is written to a temporary file, commit_journal_snapshot
+// puts it in place of the journal and appends after it
+FILE *start_journal_snapshot(Journal *journal) {
+  if (!journal->open)
+    return NULL;
+  char tmp[MAX_JOURNAL_PATH + 4];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", journal->path);
+  return fopen(tmp, "w");
+}
+
+bool commit_journal_snapshot(Journal *journal, FILE *snapshot) {
+  char tmp[MAX_JOURNAL_PATH + 4];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", journal->path);
+  bool ok = fflush(snapshot) == 0 && fsync(fileno(snapshot)) == 0;
+  ok = fclose(snapshot) == 0 && ok;
+
+  pthread_mutex_lock(&journal->lock);
+  wait_journal_sync(journal);
+  if (journal->fp != NULL)
+    fclose(journal->fp);
+  journal->fp = NULL;
+  journal->dirty = false;
+  if (ok && rename(tmp, journal->path) == 0)
+    journal->fp = fopen(journal->path, "a");
+  pthread_mutex_unlock(&journal->lock);
+  return journal->fp != NULL;
+}
+
+void journal_append(Journal *journal, const char *format, ...) {
+  pthread_mutex_lock(&journal->lock);
+  if (journal->fp != NULL) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(journal->fp, format, args);
+    va_end(args);
+    fflush(journal->fp);
+    journal->dirty = true;
+  }
+  pthread_mutex_unlock(&journal->lock);
+}
+
+// keep is false when the game ended normally and there is nothing to recover
+void close_journal(Journal *journal, bool keep) {
+  if (!journal->open)
+    return;
+  pthread_mutex_lock(&journal->lock);
+  journal->stop = true;
+  pthread_cond_broadcast(&journal->wake);
+  pthread_mutex_unlock(&journal->lock);
+  pthread_join(journal->syncer, NULL);
+
+  if (journal->fp != NULL) {
+    if (keep)
+      fsync(fileno(journal->fp));
+    fclose(journal->fp);
+  }
+  if (!keep)
+    unlink(journal->path);
+  pthread_mutex_destroy(&journal->lock);
+  pthread_cond_destroy(&journal->wake);
+  journal->fp = NULL;
+  journal->open = false;
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "../headers/match_equity.h"
+#include "eval.c"
+#include "game.c"
+#include <stdio.h>
+#include <string.h>
+
+// chance to win the match, indexed by the points both players still need,
+// while neither of them is 1-away
+float met_table[MAX_MATCH_LENGTH + 1][MAX_MATCH_LENGTH + 1];
+// trailer's chance in the Crawford game and after it, the leader is 1-away
+float met_crawford[MAX_MATCH_LENGTH + 1];
+float met_post_crawford[MAX_MATCH_LENGTH + 1];
+bool met_ready = false;
+
+float post_crawford_equity(int away) {
+  return away <= 0 ? 1 : met_post_crawford[away];
+}
+
+// the trailer doubles at once after the Crawford game, so every game is
+// played for two points
+void compute_post_crawford() {
+  met_post_crawford[0] = 1;
+  met_post_crawford[1] = 0.5f;
+  for (int n = 2; n <= MAX_MATCH_LENGTH; n++) {
+    met_post_crawford[n] =
+        0.5f * ((1 - MET_GAMMON_RATE) * post_crawford_equity(n - 2) +
+                MET_GAMMON_RATE * post_crawford_equity(n - 4));
+  }
+}
+
+// no cube in the Crawford game, the leader wins the match with any win
+void compute_crawford() {
+  met_crawford[0] = 1;
+  met_crawford[1] = 0.5f;
+  for (int n = 2; n <= MAX_MATCH_LENGTH; n++) {
+    met_crawford[n] =
+        0.5f * ((1 - MET_GAMMON_RATE) * post_crawford_equity(n - 1) +
+                MET_GAMMON_RATE * post_crawford_equity(n - 2));
+  }
+}
+
+float table_equity(int away, int opp_away) {
+  if (away <= 0)
+    return 1;
+  if (opp_away <= 0)
+    return 0;
+  if (away == 1)
+    return 1 - met_crawford[opp_away];
+  if (opp_away == 1)
+    return met_crawford[away];
+  return met_table[away][opp_away];
+}
+
+// every game is worth one point or two for a gammon, filled by the sum of
+// the away scores so all entries a game can lead to are known already
+void compute_match_equity() {
+  compute_post_crawford();
+  compute_crawford();
+  memset(met_table, 0, sizeof(met_table));
+
+  for (int sum = 4; sum <= 2 * MAX_MATCH_LENGTH; sum++) {
+    for (int away = 2; away <= MAX_MATCH_LENGTH; away++) {
+      int opp_away = sum - away;
+      if (opp_away < 2 || opp_away > MAX_MATCH_LENGTH)
+        continue;
+      float win = (1 - MET_GAMMON_RATE) * table_equity(away - 1, opp_away) +
+                  MET_GAMMON_RATE * table_equity(away - 2, opp_away);
+      float lose = (1 - MET_GAMMON_RATE) * table_equity(away, opp_away - 1) +
+                   MET_GAMMON_RATE * table_equity(away, opp_away - 2);
+      met_table[away][opp_away] = 0.5f * (win + lose);
+    }
+  }
+}
+
+bool save_match_equity(const char *filename) {
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+
+  int max_length = MAX_MATCH_LENGTH;
+  bool success =
+      fwrite(MET_HEADER, 1, MET_HEADER_LEN, fp) == MET_HEADER_LEN &&
+      fwrite(&max_length, sizeof(int), 1, fp) == 1 &&
+      fwrite(met_table, sizeof(met_table), 1, fp) == 1 &&
+      fwrite(met_crawford, sizeof(met_crawford), 1, fp) == 1 &&
+      fwrite(met_post_crawford, sizeof(met_post_crawford), 1, fp) == 1;
+  return fclose(fp) == 0 && success;
+}
+
+bool load_match_equity(const char *filename) {
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return false;
+
+  char header[MET_HEADER_LEN];
+  int max_length = 0;
+  bool success =
+      fread(header, 1, MET_HEADER_LEN, fp) == MET_HEADER_LEN &&
+      memcmp(header, MET_HEADER, MET_HEADER_LEN) == 0 &&
+      fread(&max_length, sizeof(int), 1, fp) == 1 &&
+      max_length == MAX_MATCH_LENGTH &&
+      fread(met_table, sizeof(met_table), 1, fp) == 1 &&
+      fread(met_crawford, sizeof(met_crawford), 1, fp) == 1 &&
+      fread(met_post_crawford, sizeof(met_post_crawford), 1, fp) == 1;
+  fclose(fp);
+  return success;
+}
+
+// loads MET_FILE when it's there, otherwise the table is computed
+void init_match_equity() {
+  if (met_ready)
+    return;
+  if (!load_match_equity(MET_FILE))
+    compute_match_equity();
+  met_ready = true;
+}
+
+// crawford_pending means the Crawford game hasn't been played yet, so a
+// player who gets to 1-away plays it next
+float match_equity(int away, int opp_away, bool crawford_pending) {
+  if (away <= 0)
+    return 1;
+  if (opp_away <= 0)
+    return 0;
+  if (away > MAX_MATCH_LENGTH)
+    away = MAX_MATCH_LENGTH;
+  if (opp_away > MAX_MATCH_LENGTH)
+    opp_away = MAX_MATCH_LENGTH;
+
+  if (away == 1 && opp_away == 1)
+    return 0.5f;
+  if (opp_away == 1)
+    return crawford_pending ? met_crawford[away] : met_post_crawford[away];
+  if (away == 1)
+    return 1 - (crawford_pending ? met_crawford[opp_away]
+                                 : met_post_crawford[opp_away]);
+  return met_table[away][opp_away];
+}
+
+// match equity of player once the game ends with winner scoring points
+float match_equity_after(MatchState *match, CheckerKind player,
+                         CheckerKind winner, int points) {
+  int away = match_away(match, player);
+  int opp_away = match_away(match, opposite_checker(player));
+  if (winner == player)
+    away -= points;
+  else
+    opp_away -= points;
+  bool crawford_pending = !match->crawford && !match->post_crawford;
+  return match_equity(away, opp_away, crawford_pending);
+}
+
+// cubeless chance to win the match with the game result probabilities of
+// eval, the cube stays where it is
+float eval_match_equity(EvalOutput *eval, MatchState *match,
+                        CheckerKind player) {
+  CheckerKind opp = opposite_checker(player);
+  int cube = match->cube_value;
+  float win_single = eval->win - eval->win_gammon;
+  float win_gammon = eval->win_gammon - eval->win_backgammon;
+  float lose_single = 1 - eval->win - eval->lose_gammon;
+  float lose_gammon = eval->lose_gammon - eval->lose_backgammon;
+
+  return win_single * match_equity_after(match, player, player, cube) +
+         win_gammon * match_equity_after(match, player, player, 2 * cube) +
+         eval->win_backgammon *
+             match_equity_after(match, player, player, 3 * cube) +
+         lose_single * match_equity_after(match, player, opp, cube) +
+         lose_gammon * match_equity_after(match, player, opp, 2 * cube) +
+         eval->lose_backgammon *
+             match_equity_after(match, player, opp, 3 * cube);
+}
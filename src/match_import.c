@@ -0,0 +1,576 @@
+#pragma once
+#include "../headers/match_import.h"
+#include "game.c"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// A game being rebuilt from a match file. Match files record standard
+// games, so every turn is checked and saved under the standard rules.
+typedef struct {
+  GameManager game;
+  bool active, valid;
+  // the current turn was rolled and hasn't been checked yet
+  bool rolled;
+  int number, turns;
+  // steps of the current turn as from and to points, they are checked once
+  // the turn is complete because the die of a bear off can be ambiguous
+  int steps[MAX_DOUBLET_USES][2];
+  int step_count;
+  long long line, step_line, error_line;
+  const char *error;
+  // holds the game's turn log, reset for every game
+  Arena arena;
+} ImportGame;
+
+typedef struct {
+  atomic_llong files, games, invalid_games, turns, bytes;
+} ImportStats;
+
+typedef struct {
+  char **files;
+  int file_count;
+  atomic_int next_file;
+  const char *out_dir;
+  ImportStats stats;
+} Importer;
+
+void import_fail(ImportGame *ig, const char *error) {
+  if (ig->valid) {
+    ig->valid = false;
+    ig->error = error;
+    ig->error_line = ig->line;
+  }
+}
+
+void import_start_game(ImportGame *ig, int length, int white_score,
+                       int red_score) {
+  arena_reset(&ig->arena);
+  memset(&ig->game, 0, sizeof(ig->game));
+  ig->game.board = default_board();
+  ig->game.curr_player = None;
+  ig->game.rules = StandardRules;
+  new_turn_log_in(&ig->game.turn_log, 0, &ig->arena);
+  ig->game.match = new_match_state(length);
+  ig->game.match.white_score = white_score;
+  ig->game.match.red_score = red_score;
+  ig->active = true;
+  ig->valid = true;
+  ig->number++;
+  ig->turns = 0;
+  ig->step_count = 0;
+  ig->rolled = false;
+  ig->error = NULL;
+}
+
+void import_flush_turn(ImportGame *ig);
+
+void import_roll(ImportGame *ig, CheckerKind side, int v1, int v2) {
+  if (!ig->active)
+    return;
+  import_flush_turn(ig);
+  if (v1 < 1 || v1 > 6 || v2 < 1 || v2 > 6 ||
+      (ig->turns > 0 && side == ig->game.curr_player)) {
+    import_fail(ig, "bad roll");
+    return;
+  }
+  // the replay takes the first player from the order of the opening dice
+  if (ig->turns == 0 && (v1 < v2) != (side == Red)) {
+    int tmp = v1;
+    v1 = v2;
+    v2 = tmp;
+  }
+  ig->game.curr_player = side;
+  ig->game.dice_roll = new_dice_roll(v1, v2);
+  log_new_turn(&ig->game);
+  ig->turns++;
+  ig->rolled = true;
+}
+
+int import_board_pos(CheckerKind side, int point) {
+  if (point == IMPORT_BAR_POINT)
+    return PLAYER_BAR_POS(side);
+  return side == White ? BOARD_SIZE - point : point - 1;
+}
+
+bool import_step_legal(GameManager *game, int from_point, int by) {
+  return can_use_roll_val(&game->dice_roll, by) &&
+         standard_step_error(
+             game, import_board_pos(game->curr_player, from_point), by) ==
+             MoveOk;
+}
+
+// finds a die for every step from step on, a bear off may use any larger
+// die than its distance. The turn has to end with no die left to use, the
+// steps alone don't show a play that stops short.
+bool assign_step_dice(ImportGame *ig, GameManager game, int step, int *dice) {
+  if (step == ig->step_count)
+    return max_dice_usable(&game) == 0;
+  int from_point = ig->steps[step][0], to_point = ig->steps[step][1];
+  int distance = from_point - to_point;
+  int max_by = to_point == IMPORT_OFF_POINT ? 6 : distance;
+  for (int by = distance; by <= max_by; by++) {
+    if (!import_step_legal(&game, from_point, by))
+      continue;
+    GameManager next = game;
+    move_checker_check_hit(&next, import_board_pos(next.curr_player,
+                                                   from_point),
+                           by);
+    use_roll_val(&next.dice_roll, by);
+    dice[step] = by;
+    if (assign_step_dice(ig, next, step + 1, dice))
+      return true;
+  }
+  return false;
+}
+
+// checks the steps of the turn and adds them to the game and its log
+void import_flush_turn(ImportGame *ig) {
+  int dice[MAX_DOUBLET_USES];
+  bool rolled = ig->rolled;
+  ig->rolled = false;
+  if (!rolled && ig->step_count > 0)
+    import_fail(ig, "move without a roll");
+  if (!rolled || !ig->valid) {
+    ig->step_count = 0;
+    return;
+  }
+  if (!assign_step_dice(ig, ig->game, 0, dice)) {
+    import_fail(ig, "illegal move");
+    ig->error_line = ig->step_line;
+    ig->step_count = 0;
+    return;
+  }
+
+  GameManager *game = &ig->game;
+  for (int i = 0; i < ig->step_count; i++) {
+    int from = import_board_pos(game->curr_player, ig->steps[i][0]);
+    bool hit = move_checker_check_hit(game, from, dice[i]);
+    game_add_move_entry(game, from, dice[i], hit);
+    use_roll_val(&game->dice_roll, dice[i]);
+  }
+  ig->step_count = 0;
+}
+
+void import_step(ImportGame *ig, int from_point, int to_point) {
+  if (!ig->active || !ig->valid)
+    return;
+  if (ig->game.curr_player == None || from_point <= to_point ||
+      from_point > IMPORT_BAR_POINT || to_point < IMPORT_OFF_POINT ||
+      ig->step_count >= MAX_DOUBLET_USES) {
+    import_fail(ig, "bad step");
+    return;
+  }
+  ig->steps[ig->step_count][0] = from_point;
+  ig->steps[ig->step_count][1] = to_point;
+  ig->step_count++;
+  ig->step_line = ig->line;
+}
+
+void import_double(ImportGame *ig, CheckerKind side) {
+  if (!ig->active)
+    return;
+  import_flush_turn(ig);
+  MatchState *match = &ig->game.match;
+  if (match->cube_owner != None && match->cube_owner != side)
+    import_fail(ig, "double without the cube");
+}
+
+void import_take(ImportGame *ig, CheckerKind side) {
+  if (ig->active)
+    accept_double(&ig->game.match, side);
+}
+
+bool write_import_game(Importer *importer, ImportGame *ig, const char *file) {
+  const char *base = strrchr(file, '/');
+  base = base != NULL ? base + 1 : file;
+  char path[IMPORT_PATH_LEN];
+  snprintf(path, sizeof(path), "%s/%s_%d%s", importer->out_dir, base,
+           ig->number, IMPORT_SAVE_SUFFIX);
+  return serialize_game(&ig->game, path);
+}
+
+// a game with no turns has nothing worth saving
+void import_end_game(Importer *importer, ImportGame *ig, const char *file) {
+  if (!ig->active)
+    return;
+  import_flush_turn(ig);
+  ig->active = false;
+  if (ig->turns == 0)
+    return;
+  atomic_fetch_add(&importer->stats.games, 1);
+  atomic_fetch_add(&importer->stats.turns, ig->turns);
+  if (ig->valid && !write_import_game(importer, ig, file))
+    import_fail(ig, "can't write the save file");
+  if (!ig->valid) {
+    atomic_fetch_add(&importer->stats.invalid_games, 1);
+    fprintf(stderr, "%s: game %d, line %lld: %s\n", file, ig->number,
+            ig->error_line, ig->error);
+  }
+}
+
+// "13/7(2)", "24/18*/13", "bar/22", "6/off", returns false when it isn't a
+// move at all
+bool import_mat_move(ImportGame *ig, const char *token) {
+  if (strchr(token, '/') == NULL)
+    return false;
+  int points[MAX_DOUBLET_USES + 1];
+  int count = 0, repeat = 1;
+  const char *c = token;
+  while (*c != '\0' && *c != '(') {
+    if (count > MAX_DOUBLET_USES) {
+      import_fail(ig, "bad move");
+      return true;
+    }
+    if (strncasecmp(c, "bar", 3) == 0) {
+      points[count++] = IMPORT_BAR_POINT;
+      c += 3;
+    } else if (strncasecmp(c, "off", 3) == 0) {
+      points[count++] = IMPORT_OFF_POINT;
+      c += 3;
+    } else if (isdigit(*c)) {
+      points[count++] = strtol(c, (char **)&c, 10);
+    } else {
+      import_fail(ig, "bad move");
+      return true;
+    }
+    while (*c == '*' || *c == '/')
+      c++;
+  }
+  if (*c == '(' && sscanf(c, "(%d)", &repeat) != 1)
+    repeat = 0;
+  if (count < 2 || repeat < 1 || repeat > MAX_DOUBLET_USES) {
+    import_fail(ig, "bad move");
+    return true;
+  }
+
+  for (int r = 0; r < repeat; r++) {
+    for (int i = 0; i + 1 < count; i++)
+      import_step(ig, points[i], points[i + 1]);
+  }
+  return true;
+}
+
+// column where the second player's actions start, from the score line
+int mat_second_column(const char *line) {
+  const char *colon = strchr(line, ':');
+  if (colon == NULL)
+    return IMPORT_LINE_LEN;
+  const char *c = colon + 1;
+  while (isspace(*c))
+    c++;
+  while (isdigit(*c))
+    c++;
+  while (isspace(*c))
+    c++;
+  return c - line;
+}
+
+// one numbered line: the first action goes to the side whose column it's
+// in, the rest alternate
+void import_mat_actions(Importer *importer, ImportGame *ig, const char *file,
+                        char *line, int second_column) {
+  char *c = strchr(line, ')') + 1;
+  CheckerKind side = None;
+  while (true) {
+    while (isspace(*c))
+      c++;
+    if (*c == '\0')
+      break;
+    char token[IMPORT_TOKEN_LEN];
+    int len = 0;
+    if (sscanf(c, "%63s%n", token, &len) != 1)
+      break;
+    CheckerKind column_side = c - line >= second_column ? Red : White;
+    c += len;
+
+    int v1, v2;
+    bool action = true;
+    if (strlen(token) == 3 && isdigit(token[0]) && isdigit(token[1]) &&
+        token[2] == ':') {
+      side = side == None ? column_side : opposite_checker(side);
+      v1 = token[0] - '0';
+      v2 = token[1] - '0';
+      import_roll(ig, side, v1, v2);
+    } else if (strcmp(token, "Doubles") == 0) {
+      side = side == None ? column_side : opposite_checker(side);
+      import_double(ig, side);
+    } else if (strcmp(token, "Takes") == 0 || strcmp(token, "Beavers") == 0) {
+      side = side == None ? column_side : opposite_checker(side);
+      import_take(ig, side);
+    } else if (strcmp(token, "Drops") == 0) {
+      side = side == None ? column_side : opposite_checker(side);
+    } else if (strcmp(token, "Wins") == 0) {
+      import_end_game(importer, ig, file);
+      return;
+    } else {
+      action = false;
+    }
+    if (!action && !import_mat_move(ig, token) && side == None)
+      side = column_side;
+  }
+}
+
+// .mat text export: "N point match", then per game "Game N", the score
+// line and numbered lines of both players' rolls, moves and cube actions
+bool import_mat(Importer *importer, FILE *fp, const char *file) {
+  char line[IMPORT_LINE_LEN];
+  ImportGame ig;
+  memset(&ig, 0, sizeof(ig));
+  int length = MONEY_GAME, second_column = IMPORT_LINE_LEN;
+  bool score_next = false;
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    ig.line++;
+    atomic_fetch_add(&importer->stats.bytes, strlen(line));
+    char *text = line;
+    while (isspace(*text))
+      text++;
+    int number, white_score, red_score, matched = 0;
+    char white_name[IMPORT_TOKEN_LEN], red_name[IMPORT_TOKEN_LEN];
+
+    if (*text == ';' || *text == '\0') {
+      continue;
+    } else if (sscanf(text, "%d point match%n", &number, &matched) == 1 &&
+               matched > 0) {
+      length = number;
+    } else if (sscanf(text, "Game %d", &number) == 1) {
+      import_end_game(importer, &ig, file);
+      score_next = true;
+    } else if (score_next &&
+               sscanf(text, "%63s : %d %63s : %d", white_name, &white_score,
+                      red_name, &red_score) == 4) {
+      import_start_game(&ig, length, white_score, red_score);
+      second_column = mat_second_column(line);
+      score_next = false;
+    } else if (isdigit(*text) && strchr(text, ')') != NULL && ig.active) {
+      import_mat_actions(importer, &ig, file, line, second_column);
+    }
+  }
+  import_end_game(importer, &ig, file);
+  free_arena(&ig.arena);
+  return !ferror(fp);
+}
+
+// reads the "KEY[value]" pairs of SGF nodes as a stream, the first child of
+// every node is the main line and the later ones are skipped as variations
+typedef struct {
+  FILE *fp;
+  int depth;
+  // depth of the variation being skipped, 0 when on the main line
+  int skip_depth;
+  // depth of the node whose main line child is already closed
+  int closed_parent;
+  // prop is kept between calls for properties with more values
+  int prop_len;
+  bool after_value, game_end;
+  long long bytes;
+} SgfReader;
+
+// returns false at the end of the file, game_end is set after a game tree
+bool sgf_next_prop(SgfReader *reader, char *prop, char *value) {
+  reader->game_end = false;
+  int c;
+  while ((c = fgetc(reader->fp)) != EOF) {
+    reader->bytes++;
+    if (c == '(') {
+      reader->depth++;
+      if (reader->skip_depth == 0 && reader->depth >= 2 &&
+          reader->closed_parent == reader->depth - 1)
+        reader->skip_depth = reader->depth;
+    } else if (c == ')') {
+      if (reader->skip_depth == reader->depth)
+        reader->skip_depth = 0;
+      else if (reader->skip_depth == 0 && reader->depth >= 2)
+        reader->closed_parent = reader->depth - 1;
+      reader->depth--;
+      if (reader->depth == 0) {
+        reader->closed_parent = 0;
+        reader->game_end = true;
+        return true;
+      }
+    } else if (isupper(c)) {
+      if (reader->after_value)
+        reader->prop_len = 0;
+      reader->after_value = false;
+      if (reader->prop_len < SGF_PROP_LEN - 1)
+        prop[reader->prop_len++] = c;
+    } else if (c == '[') {
+      int value_len = 0;
+      bool escaped = false;
+      while ((c = fgetc(reader->fp)) != EOF) {
+        reader->bytes++;
+        if (!escaped && c == ']')
+          break;
+        escaped = !escaped && c == '\\';
+        if (!escaped && value_len < SGF_VALUE_LEN - 1)
+          value[value_len++] = c;
+      }
+      value[value_len] = '\0';
+      prop[reader->prop_len] = '\0';
+      reader->after_value = true;
+      // more values of the same property keep its name
+      if (reader->skip_depth == 0)
+        return true;
+    } else if (!isspace(c)) {
+      reader->prop_len = 0;
+    }
+  }
+  return false;
+}
+
+int sgf_point(char c) {
+  if (c == SGF_BAR_CHAR)
+    return IMPORT_BAR_POINT;
+  if (c == SGF_OFF_CHAR)
+    return IMPORT_OFF_POINT;
+  if (c >= 'a' && c <= 'x')
+    return c - 'a' + 1;
+  return -1;
+}
+
+// "52lgjh": the dice, then pairs of from and to points
+void import_sgf_move(ImportGame *ig, CheckerKind side, const char *value) {
+  if (strcmp(value, "double") == 0) {
+    import_double(ig, side);
+    return;
+  }
+  if (strcmp(value, "take") == 0) {
+    import_take(ig, side);
+    return;
+  }
+  if (strcmp(value, "drop") == 0)
+    return;
+  if (!isdigit(value[0]) || !isdigit(value[1])) {
+    import_fail(ig, "bad move");
+    return;
+  }
+
+  import_roll(ig, side, value[0] - '0', value[1] - '0');
+  for (const char *c = value + 2; c[0] != '\0' && c[1] != '\0'; c += 2) {
+    int from = sgf_point(c[0]), to = sgf_point(c[1]);
+    if (from < 0 || to < 0) {
+      import_fail(ig, "bad move");
+      return;
+    }
+    import_step(ig, from, to);
+  }
+}
+
+// gnubg SGF: one game tree per game, MI holds the match length and score,
+// W[] and B[] nodes are the moves of White and Red
+bool import_sgf(Importer *importer, FILE *fp, const char *file) {
+  SgfReader reader = {fp, 0, 0, 0, 0, false, false, 0};
+  ImportGame ig;
+  memset(&ig, 0, sizeof(ig));
+  char prop[SGF_PROP_LEN], value[SGF_VALUE_LEN];
+  int length = MONEY_GAME, white_score = 0, red_score = 0;
+
+  while (sgf_next_prop(&reader, prop, value)) {
+    if (reader.game_end) {
+      import_end_game(importer, &ig, file);
+      length = MONEY_GAME;
+      white_score = red_score = 0;
+    } else if (strcmp(prop, "MI") == 0) {
+      int val;
+      if (sscanf(value, "length:%d", &val) == 1)
+        length = val;
+      else if (sscanf(value, "ws:%d", &val) == 1)
+        white_score = val;
+      else if (sscanf(value, "bs:%d", &val) == 1)
+        red_score = val;
+    } else if (strcmp(prop, "W") == 0 || strcmp(prop, "B") == 0) {
+      if (!ig.active)
+        import_start_game(&ig, length, white_score, red_score);
+      import_sgf_move(&ig, prop[0] == 'W' ? White : Red, value);
+    }
+  }
+  import_end_game(importer, &ig, file);
+  free_arena(&ig.arena);
+  atomic_fetch_add(&importer->stats.bytes, reader.bytes);
+  return !ferror(fp);
+}
+
+bool has_suffix(const char *str, const char *suffix) {
+  size_t len = strlen(str), suffix_len = strlen(suffix);
+  return len >= suffix_len &&
+         strcasecmp(str + len - suffix_len, suffix) == 0;
+}
+
+void import_file(Importer *importer, const char *file) {
+  FILE *fp = fopen(file, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "can't read %s\n", file);
+    return;
+  }
+  bool success = has_suffix(file, ".sgf") ? import_sgf(importer, fp, file)
+                                          : import_mat(importer, fp, file);
+  fclose(fp);
+  if (!success)
+    fprintf(stderr, "error reading %s\n", file);
+  atomic_fetch_add(&importer->stats.files, 1);
+}
+
+// files are handed out one at a time, so big and small ones mix well
+void *import_worker(void *arg) {
+  Importer *importer = arg;
+  int id;
+  while ((id = atomic_fetch_add(&importer->next_file, 1)) <
+         importer->file_count)
+    import_file(importer, importer->files[id]);
+  return NULL;
+}
+
+// usage: import [-j threads] <out dir> <file.mat|file.sgf>...
+int run_importer(int argc, char **argv) {
+  int arg = 1;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+    threads = atoi(argv[2]);
+    arg = 3;
+  }
+  if (argc - arg < 2) {
+    fprintf(stderr, "usage: %s [-j threads] <out dir> <match file>...\n",
+            argv[0]);
+    return 1;
+  }
+  if (threads < 1)
+    threads = 1;
+  if (threads > MAX_IMPORT_THREADS)
+    threads = MAX_IMPORT_THREADS;
+
+  static Importer importer;
+  importer.out_dir = argv[arg];
+  importer.files = argv + arg + 1;
+  importer.file_count = argc - arg - 1;
+  atomic_init(&importer.next_file, 0);
+  if (threads > importer.file_count)
+    threads = importer.file_count;
+
+  double start = monotonic_seconds();
+  pthread_t workers[MAX_IMPORT_THREADS];
+  int started = 0;
+  for (int i = 1; i < threads; i++) {
+    if (pthread_create(&workers[started], NULL, import_worker, &importer) ==
+        0)
+      started++;
+  }
+  import_worker(&importer);
+  for (int i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+
+  double secs = monotonic_seconds() - start;
+  ImportStats *stats = &importer.stats;
+  long long bytes = atomic_load(&stats->bytes);
+  long long games = atomic_load(&stats->games);
+  printf("files %lld games %lld invalid %lld turns %lld %.2f MB %.2fs "
+         "%.2f MB/s %.0f games/s\n",
+         (long long)atomic_load(&stats->files), games,
+         (long long)atomic_load(&stats->invalid_games),
+         (long long)atomic_load(&stats->turns), bytes / 1e6, secs,
+         secs > 0 ? bytes / 1e6 / secs : 0, secs > 0 ? games / secs : 0);
+  return atomic_load(&stats->invalid_games) > 0;
+}
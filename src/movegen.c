@@ -0,0 +1,248 @@
+#pragma once
+#include "../headers/movegen.h"
+#include "game.c"
+#include "position.c"
+#include <string.h>
+
+typedef struct {
+  MoveEntry moves[MAX_DOUBLET_USES];
+  int move_count;
+  // position after the play, so callers don't have to replay it
+  Board board;
+  PositionKey key;
+} Play;
+
+// every distinct position reachable with one roll, the Vec holds Plays
+typedef struct {
+  Vec vec;
+  // open addressing over indices into vec, -1 is an empty slot
+  int *slots;
+  int slot_cap;
+  // where the plays and slots live, NULL for the heap
+  Arena *arena;
+} PlayList;
+
+void clear_play_list(PlayList *play_list) {
+  play_list->vec.len = 0;
+  memset(play_list->slots, -1, play_list->slot_cap * sizeof(int));
+}
+
+void new_play_list_in(PlayList *play_list, Arena *arena) {
+  vec_in_arena(&play_list->vec, sizeof(Play), DEFAULT_CAP, arena);
+  play_list->arena = arena;
+  play_list->slot_cap = PLAY_SET_MIN_CAP;
+  play_list->slots = pool_alloc(arena, play_list->slot_cap * sizeof(int));
+  if (play_list->vec.data == NULL || play_list->slots == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  clear_play_list(play_list);
+}
+
+void new_play_list(PlayList *play_list) { new_play_list_in(play_list, NULL); }
+
+void free_play_list(PlayList *play_list) {
+  vec_free(&play_list->vec);
+  pool_free(play_list->arena, play_list->slots);
+  play_list->slots = NULL;
+}
+
+Play *play_at(PlayList *play_list, int id) {
+  Play *data = play_list->vec.data;
+  return &data[id];
+}
+
+int play_count(PlayList *play_list) { return play_list->vec.len; }
+
+int play_slot(PlayList *play_list, PositionKey *key) {
+  int mask = play_list->slot_cap - 1;
+  int slot = key_hash(key, None) & mask;
+  while (play_list->slots[slot] != -1) {
+    Play *play = play_at(play_list, play_list->slots[slot]);
+    if (memcmp(&play->key, key, sizeof(PositionKey)) == 0)
+      return slot;
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+void grow_play_slots(PlayList *play_list) {
+  pool_free(play_list->arena, play_list->slots);
+  play_list->slot_cap *= 2;
+  play_list->slots =
+      pool_alloc(play_list->arena, play_list->slot_cap * sizeof(int));
+  if (play_list->slots == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  memset(play_list->slots, -1, play_list->slot_cap * sizeof(int));
+
+  for (int i = 0; i < play_count(play_list); i++)
+    play_list->slots[play_slot(play_list, &play_at(play_list, i)->key)] = i;
+}
+
+// returns false if the resulting position was already there
+bool add_play(PlayList *play_list, Play *play) {
+  position_key(&play->board, &play->key);
+  int slot = play_slot(play_list, &play->key);
+  if (play_list->slots[slot] != -1) {
+    // the same position by more steps, needed to tell which dice it uses,
+    // and by as many steps the one starting with the larger die, since the
+    // standard rules refuse the smaller one first when only one die fits
+    Play *known = play_at(play_list, play_list->slots[slot]);
+    if (play->move_count > known->move_count ||
+        (play->move_count == known->move_count && play->move_count > 0 &&
+         play->moves[0].by > known->moves[0].by))
+      *known = *play;
+    return false;
+  }
+
+  if (play_list->vec.len + 1 > play_list->vec.cap) {
+    if (vec_extend(&play_list->vec) == 1)
+      exit(NO_HEAP_MEM_EXIT);
+  }
+  play_list->slots[slot] = play_list->vec.len;
+  *play_at(play_list, play_list->vec.len++) = *play;
+
+  if (play_list->vec.len * 2 > play_list->slot_cap)
+    grow_play_slots(play_list);
+  return true;
+}
+
+// distinct die values that can still be used, returns their count
+int usable_dice(DiceRoll *dice_roll, int *vals) {
+  int count = 0;
+  if (can_use_roll_val(dice_roll, dice_roll->v1))
+    vals[count++] = dice_roll->v1;
+  if (dice_roll->v1 != dice_roll->v2 &&
+      can_use_roll_val(dice_roll, dice_roll->v2))
+    vals[count++] = dice_roll->v2;
+  return count;
+}
+
+void apply_play_step(GameManager *state, Play *play, int from, int by) {
+  bool hit = move_checker_check_hit(state, from, by);
+  use_roll_val(&state->dice_roll, by);
+  play->moves[play->move_count++] = (MoveEntry){from, by, hit};
+}
+
+bool house_enter_ok(GameManager *state, int by) {
+  return house_enter_error(state, by) == MoveOk;
+}
+
+bool house_move_ok(GameManager *state, int from, int by) {
+  return house_move_error(state, from, by) == MoveOk;
+}
+
+bool standard_enter_ok(GameManager *state, int by) {
+  return is_enter_legal_basic(state, by);
+}
+
+bool standard_move_ok(GameManager *state, int from, int by) {
+  return is_step_legal_standard(state, from, by);
+}
+
+// One recursive generator per rule set, so the rules are fixed at compile
+// time instead of being looked up for every step. The standard rules only
+// check single steps here, keep_standard_plays applies the dice rule.
+#define DEFINE_PLAY_GENERATOR(name, enter_ok, move_ok)                        \
+  void name(GameManager *state, Play *play, PlayList *out) {                 \
+    int vals[2];                                                               \
+    int val_count = usable_dice(&state->dice_roll, vals);                      \
+    CheckerKind player = state->curr_player;                                   \
+    bool moved = false;                                                        \
+                                                                               \
+    if (bar_count(&state->board, player) > 0) {                                \
+      for (int i = 0; i < val_count; i++) {                                    \
+        if (!enter_ok(state, vals[i]))                                         \
+          continue;                                                            \
+        GameManager next = *state;                                             \
+        Play next_play = *play;                                                \
+        apply_play_step(&next, &next_play, PLAYER_BAR_POS(player), vals[i]);   \
+        name(&next, &next_play, out);                                          \
+        moved = true;                                                          \
+      }                                                                        \
+    } else {                                                                   \
+      for (int from = 0; from < BOARD_SIZE; from++) {                          \
+        if (checker_kind_at(&state->board, from) != player)                    \
+          continue;                                                            \
+        for (int i = 0; i < val_count; i++) {                                  \
+          if (!move_ok(state, from, vals[i]))                                  \
+            continue;                                                          \
+          GameManager next = *state;                                           \
+          Play next_play = *play;                                              \
+          apply_play_step(&next, &next_play, from, vals[i]);                   \
+          name(&next, &next_play, out);                                        \
+          moved = true;                                                        \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+                                                                               \
+    if (!moved) {                                                              \
+      play->board = state->board;                                              \
+      add_play(out, play);                                                     \
+    }                                                                          \
+  }
+
+DEFINE_PLAY_GENERATOR(generate_house_plays, house_enter_ok, house_move_ok)
+DEFINE_PLAY_GENERATOR(generate_standard_plays, standard_enter_ok,
+                      standard_move_ok)
+
+bool play_uses_die(Play *play, int val) {
+  for (int i = 0; i < play->move_count; i++)
+    if (play->moves[i].by == val)
+      return true;
+  return false;
+}
+
+// drops the plays that use fewer dice than possible and, when only one die
+// can be used, the ones using the smaller die if the larger one fits
+void keep_standard_plays(PlayList *out, DiceRoll *dice_roll) {
+  int most = 0;
+  for (int i = 0; i < play_count(out); i++)
+    if (play_at(out, i)->move_count > most)
+      most = play_at(out, i)->move_count;
+
+  int larger = dice_roll->v1 > dice_roll->v2 ? dice_roll->v1 : dice_roll->v2;
+  bool need_larger = false;
+  if (most == 1 && dice_roll->v1 != dice_roll->v2) {
+    for (int i = 0; i < play_count(out) && !need_larger; i++)
+      need_larger = play_uses_die(play_at(out, i), larger);
+  }
+
+  int kept = 0;
+  for (int i = 0; i < play_count(out); i++) {
+    Play *play = play_at(out, i);
+    if (play->move_count == most &&
+        (!need_larger || play_uses_die(play, larger)))
+      *play_at(out, kept++) = *play;
+  }
+  if (kept == play_count(out))
+    return;
+  out->vec.len = kept;
+  memset(out->slots, -1, out->slot_cap * sizeof(int));
+  for (int i = 0; i < kept; i++)
+    out->slots[play_slot(out, &play_at(out, i)->key)] = i;
+}
+
+// fills out with every distinct position the player to move can reach with
+// the current roll, under the same rules as game_move and game_enter
+void generate_plays(GameManager *game_manager, PlayList *out) {
+  clear_play_list(out);
+  GameManager state = *game_manager;
+  Play play;
+  play.move_count = 0;
+  if (game_manager->rules == StandardRules) {
+    generate_standard_plays(&state, &play, out);
+    keep_standard_plays(out, &game_manager->dice_roll);
+  } else {
+    generate_house_plays(&state, &play, out);
+  }
+}
+
+// the 21 distinct rolls with their weight out of ROLL_OUTCOMES
+void all_rolls(DiceRoll *rolls, int *weights) {
+  int count = 0;
+  for (int v1 = 1; v1 <= 6; v1++) {
+    for (int v2 = v1; v2 <= 6; v2++) {
+      rolls[count] = new_dice_roll(v1, v2);
+      weights[count++] = v1 == v2 ? 1 : 2;
+    }
+  }
+}
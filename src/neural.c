@@ -0,0 +1,134 @@
+#pragma once
+#include "../headers/neural.h"
+#include "game.c"
+#include "rng.c"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// plain arrays of floats only, so weights, gradients and eligibility
+// traces can all be handled as one flat vector
+typedef struct {
+  float hidden_weights[NET_HIDDEN][NET_INPUTS];
+  float hidden_bias[NET_HIDDEN];
+  float output_weights[NET_OUTPUTS][NET_HIDDEN];
+  float output_bias[NET_OUTPUTS];
+} Network;
+
+#define NET_PARAM_COUNT (sizeof(Network) / sizeof(float))
+
+typedef struct {
+  float inputs[NET_INPUTS];
+  float hidden[NET_HIDDEN];
+  float outputs[NET_OUTPUTS];
+} NetworkActivations;
+
+float *network_params(Network *network) { return (float *)network; }
+
+void init_network(Network *network, Rng *rng) {
+  float *params = network_params(network);
+  for (size_t i = 0; i < NET_PARAM_COUNT; i++)
+    params[i] = (rng_double(rng) * 2 - 1) * NET_INIT_RANGE;
+}
+
+void encode_point(float *units, int count) {
+  units[0] = count >= 1;
+  units[1] = count >= 2;
+  units[2] = count >= 3;
+  units[3] = count > 3 ? (count - 3) / 2.0f : 0;
+}
+
+// always from White's side, the side to roll only gets the turn units
+void encode_board(Board *board, CheckerKind on_roll, float *inputs) {
+  memset(inputs, 0, NET_INPUTS * sizeof(float));
+  float *white = inputs, *red = inputs + BOARD_SIZE * NET_POINT_UNITS;
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    BoardPoint *point = &board->board_points[i];
+    if (point->checker_kind == White)
+      encode_point(white + i * NET_POINT_UNITS, point->checker_count);
+    else if (point->checker_kind == Red)
+      encode_point(red + i * NET_POINT_UNITS, point->checker_count);
+  }
+
+  float *rest = inputs + BOARD_SIZE * NET_POINT_UNITS * 2;
+  rest[0] = board->white_bar.checker_count / 2.0f;
+  rest[1] = board->red_bar.checker_count / 2.0f;
+  rest[2] = board->white_out_count / (float)CHECKER_COUNT;
+  rest[3] = board->red_out_count / (float)CHECKER_COUNT;
+  rest[4] = on_roll == White;
+  rest[5] = on_roll == Red;
+}
+
+float sigmoid(float x) { return 1 / (1 + expf(-x)); }
+
+void network_forward(Network *network, NetworkActivations *act) {
+  for (int j = 0; j < NET_HIDDEN; j++) {
+    const float *weights = network->hidden_weights[j];
+    float sum = network->hidden_bias[j];
+    for (int i = 0; i < NET_INPUTS; i++)
+      sum += weights[i] * act->inputs[i];
+    act->hidden[j] = sigmoid(sum);
+  }
+  for (int k = 0; k < NET_OUTPUTS; k++) {
+    const float *weights = network->output_weights[k];
+    float sum = network->output_bias[k];
+    for (int j = 0; j < NET_HIDDEN; j++)
+      sum += weights[j] * act->hidden[j];
+    act->outputs[k] = sigmoid(sum);
+  }
+}
+
+// the outputs are independent sigmoids, gammons are capped by the wins
+void outputs_to_eval(const float *outputs, CheckerKind on_roll,
+                     EvalOutput *out) {
+  float win = outputs[0];
+  float win_gammon = fminf(outputs[1], win);
+  float win_backgammon = fminf(outputs[2], win_gammon);
+  float lose_gammon = fminf(outputs[3], 1 - win);
+  float lose_backgammon = fminf(outputs[4], lose_gammon);
+  if (on_roll == White)
+    *out = (EvalOutput){win, win_gammon, win_backgammon, lose_gammon,
+                        lose_backgammon};
+  else
+    *out = (EvalOutput){1 - win, lose_gammon, lose_backgammon, win_gammon,
+                        win_backgammon};
+}
+
+void network_evaluate(Network *network, Board *board, CheckerKind on_roll,
+                      EvalOutput *out) {
+  NetworkActivations act;
+  encode_board(board, on_roll, act.inputs);
+  network_forward(network, &act);
+  outputs_to_eval(act.outputs, on_roll, out);
+}
+
+bool save_network(Network *network, const char *filename) {
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+
+  int shape[3] = {NET_INPUTS, NET_HIDDEN, NET_OUTPUTS};
+  bool success =
+      fwrite(NETWORK_HEADER, 1, NETWORK_HEADER_LEN, fp) ==
+          NETWORK_HEADER_LEN &&
+      fwrite(shape, sizeof(shape), 1, fp) == 1 &&
+      fwrite(network, sizeof(Network), 1, fp) == 1;
+  return fclose(fp) == 0 && success;
+}
+
+bool load_network(Network *network, const char *filename) {
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return false;
+
+  char header[NETWORK_HEADER_LEN];
+  int shape[3];
+  bool success =
+      fread(header, 1, NETWORK_HEADER_LEN, fp) == NETWORK_HEADER_LEN &&
+      memcmp(header, NETWORK_HEADER, NETWORK_HEADER_LEN) == 0 &&
+      fread(shape, sizeof(shape), 1, fp) == 1 && shape[0] == NET_INPUTS &&
+      shape[1] == NET_HIDDEN && shape[2] == NET_OUTPUTS &&
+      fread(network, sizeof(Network), 1, fp) == 1;
+  fclose(fp);
+  return success;
+}
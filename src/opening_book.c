@@ -0,0 +1,152 @@
+#pragma once
+#include "../headers/opening_book.h"
+#include "game.c"
+#include "position.c"
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+  uint64_t hash;
+  PositionKey key;
+  // smaller die in the high nibble
+  uint8_t dice;
+  uint8_t step_count;
+  // board position and die of every step
+  int8_t steps[MAX_DOUBLET_USES][2];
+  float equity;
+} BookEntry;
+
+_Static_assert(sizeof(BookEntry) == BOOK_ENTRY_SIZE,
+               "BookEntry is read straight from the file");
+
+typedef struct {
+  char magic[BOOK_MAGIC_LEN];
+  uint32_t entry_count;
+  uint32_t entry_size;
+} BookHeader;
+
+typedef struct {
+  void *map;
+  size_t map_len;
+  const BookEntry *entries;
+  uint32_t entry_count;
+} OpeningBook;
+
+// the book engines consult before searching, NULL when there is none
+OpeningBook *opening_book = NULL;
+
+uint8_t book_dice(int v1, int v2) {
+  return v1 < v2 ? v1 << 4 | v2 : v2 << 4 | v1;
+}
+
+int compare_book_entries(const void *a, const void *b) {
+  const BookEntry *x = a, *y = b;
+  if (x->hash != y->hash)
+    return x->hash < y->hash ? -1 : 1;
+  return (int)x->dice - (int)y->dice;
+}
+
+bool load_opening_book(OpeningBook *book, const char *filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(BookHeader)) {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  const BookHeader *header = map;
+  if (memcmp(header->magic, BOOK_MAGIC, BOOK_MAGIC_LEN) != 0 ||
+      header->entry_size != BOOK_ENTRY_SIZE ||
+      sizeof(BookHeader) + (size_t)header->entry_count * BOOK_ENTRY_SIZE >
+          (size_t)st.st_size) {
+    munmap(map, st.st_size);
+    return false;
+  }
+  book->map = map;
+  book->map_len = st.st_size;
+  book->entries = (const BookEntry *)((const char *)map + sizeof(BookHeader));
+  book->entry_count = header->entry_count;
+  return true;
+}
+
+void free_opening_book(OpeningBook *book) {
+  if (book->map != NULL)
+    munmap(book->map, book->map_len);
+  book->map = NULL;
+  book->entries = NULL;
+  book->entry_count = 0;
+}
+
+// sorts the entries and writes them in the format load_opening_book maps
+bool save_opening_book(BookEntry *entries, uint32_t count,
+                       const char *filename) {
+  qsort(entries, count, sizeof(BookEntry), compare_book_entries);
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+  BookHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BOOK_MAGIC, BOOK_MAGIC_LEN);
+  header.entry_count = count;
+  header.entry_size = BOOK_ENTRY_SIZE;
+  bool success = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                 fwrite(entries, sizeof(BookEntry), count, fp) == count;
+  return fclose(fp) == 0 && success;
+}
+
+// binary search on hash and dice, the key guards against hash collisions
+const BookEntry *find_book_entry(OpeningBook *book, Board *white_board,
+                                 uint8_t dice) {
+  PositionKey key;
+  position_key(white_board, &key);
+  BookEntry probe;
+  probe.hash = key_hash(&key, White);
+  probe.dice = dice;
+
+  uint32_t lo = 0, hi = book->entry_count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (compare_book_entries(&book->entries[mid], &probe) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == book->entry_count ||
+      compare_book_entries(&book->entries[lo], &probe) != 0 ||
+      memcmp(&book->entries[lo].key, &key, sizeof(key)) != 0)
+    return NULL;
+  return &book->entries[lo];
+}
+
+// fills moves with the book play for the side to move, in its own colours;
+// returns the number of steps or -1 when the position isn't in the book
+int book_lookup(OpeningBook *book, Board *board, CheckerKind side,
+                DiceRoll *dice_roll, MoveEntry *moves) {
+  if (book == NULL || book->entry_count == 0)
+    return -1;
+  Board mirrored;
+  if (side == Red)
+    mirror_board(board, &mirrored);
+  const BookEntry *entry =
+      find_book_entry(book, side == Red ? &mirrored : board,
+                      book_dice(dice_roll->v1, dice_roll->v2));
+  if (entry == NULL)
+    return -1;
+
+  for (int i = 0; i < entry->step_count; i++) {
+    int from = entry->steps[i][0];
+    moves[i] = (MoveEntry){side == Red ? mirror_pos(from) : from,
+                           entry->steps[i][1], false};
+  }
+  return entry->step_count;
+}
@@ -0,0 +1,379 @@
+#pragma once
+#include "../headers/perft.h"
+#include "movegen.c"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+// Counts the positions reachable from a start position in a number of
+// plies, a ply being one of the 21 rolls followed by one of its plays.
+// Finished games are leaves. Each (roll, play) at the root is a task the
+// threads pull from a shared counter, so the counts don't depend on the
+// thread count.
+
+typedef struct {
+  int roll;
+  Board board;
+} PerftTask;
+
+typedef struct {
+  GameManager root;
+  DiceRoll rolls[ROLL_COUNT];
+  PerftTask *tasks;
+  long long *task_nodes;
+  int task_count;
+  int depth;
+  atomic_int next_task;
+} PerftRun;
+
+typedef struct {
+  PerftRun *run;
+  // one play list per ply so the recursion doesn't overwrite its parent's
+  PlayList lists[MAX_PERFT_DEPTH];
+  pthread_t thread;
+  bool started;
+} PerftWorker;
+
+GameManager perft_child(GameManager *state, Board *board) {
+  GameManager next = *state;
+  next.board = *board;
+  next.curr_player = opposite_checker(state->curr_player);
+  return next;
+}
+
+long long perft_count(PlayList *lists, GameManager *state, DiceRoll *rolls,
+                      int depth) {
+  if (depth == 0 || check_game_over(state, NULL) != None)
+    return 1;
+
+  long long nodes = 0;
+  for (int i = 0; i < ROLL_COUNT; i++) {
+    state->dice_roll = rolls[i];
+    generate_plays(state, lists);
+    // every child is a leaf, finished games included
+    if (depth == 1) {
+      nodes += play_count(lists);
+      continue;
+    }
+    for (int j = 0; j < play_count(lists); j++) {
+      GameManager next = perft_child(state, &play_at(lists, j)->board);
+      nodes += perft_count(lists + 1, &next, rolls, depth - 1);
+    }
+  }
+  return nodes;
+}
+
+void *perft_worker(void *arg) {
+  PerftWorker *worker = arg;
+  PerftRun *run = worker->run;
+  int task;
+  while ((task = atomic_fetch_add(&run->next_task, 1)) < run->task_count) {
+    GameManager next = perft_child(&run->root, &run->tasks[task].board);
+    run->task_nodes[task] =
+        perft_count(worker->lists, &next, run->rolls, run->depth - 1);
+  }
+  return NULL;
+}
+
+// the root's plays for every roll, one task each
+void perft_tasks(PerftRun *run, PlayList *list) {
+  int cap = 0;
+  run->task_count = 0;
+  run->tasks = NULL;
+  for (int i = 0; i < ROLL_COUNT; i++) {
+    run->root.dice_roll = run->rolls[i];
+    generate_plays(&run->root, list);
+    if (run->task_count + play_count(list) > cap) {
+      cap = (run->task_count + play_count(list)) * GROWTH_FACTOR;
+      run->tasks = realloc(run->tasks, cap * sizeof(PerftTask));
+      if (run->tasks == NULL)
+        exit(NO_HEAP_MEM_EXIT);
+    }
+    for (int j = 0; j < play_count(list); j++)
+      run->tasks[run->task_count++] = (PerftTask){i, play_at(list, j)->board};
+  }
+  run->task_nodes = calloc(run->task_count, sizeof(long long));
+  if (run->task_nodes == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+}
+
+// fills roll_nodes with the count below each of the root's rolls
+long long perft(GameManager *root, int depth, PerftWorker *workers,
+                int threads, long long *roll_nodes) {
+  memset(roll_nodes, 0, ROLL_COUNT * sizeof(long long));
+  if (depth == 0 || check_game_over(root, NULL) != None)
+    return 1;
+
+  static PerftRun run;
+  run.root = *root;
+  run.depth = depth;
+  int weights[ROLL_COUNT];
+  all_rolls(run.rolls, weights);
+  perft_tasks(&run, workers[0].lists);
+  atomic_store(&run.next_task, 0);
+
+  // the tasks are pulled from a counter, so this thread takes part and
+  // threads that fail to start only leave more tasks to the others
+  for (int i = 0; i < threads; i++) {
+    workers[i].run = &run;
+    workers[i].started =
+        i > 0 && pthread_create(&workers[i].thread, NULL, perft_worker,
+                                &workers[i]) == 0;
+  }
+  perft_worker(&workers[0]);
+  for (int i = 0; i < threads; i++) {
+    if (workers[i].started)
+      pthread_join(workers[i].thread, NULL);
+  }
+
+  long long nodes = 0;
+  for (int i = 0; i < run.task_count; i++) {
+    roll_nodes[run.tasks[i].roll] += run.task_nodes[i];
+    nodes += run.task_nodes[i];
+  }
+  free(run.tasks);
+  free(run.task_nodes);
+  return nodes;
+}
+
+// The reference walks the same tree one step at a time through
+// move_error and enter_error, which the game itself checks every move
+// against and which come down to is_move_legal_basic. It's slow on
+// purpose: nothing is shared with generate_plays but the board updates.
+
+typedef struct {
+  PositionKey key;
+  Board board;
+} ReferencePlay;
+
+typedef struct {
+  Vec plays[MAX_PERFT_DEPTH];
+  PlayList lists[MAX_PERFT_DEPTH];
+  long long mismatches;
+  // turns the game wouldn't end but no step is allowed in
+  long long stuck;
+} PerftReference;
+
+ReferencePlay *reference_play_at(Vec *plays, int id) {
+  ReferencePlay *data = plays->data;
+  return &data[id];
+}
+
+bool reference_contains(Vec *plays, PositionKey *key) {
+  for (int i = 0; i < plays->len; i++) {
+    if (memcmp(&reference_play_at(plays, i)->key, key, sizeof(*key)) == 0)
+      return true;
+  }
+  return false;
+}
+
+void add_reference_play(Vec *plays, Board *board) {
+  ReferencePlay play;
+  play.board = *board;
+  position_key(board, &play.key);
+  if (reference_contains(plays, &play.key))
+    return;
+  if (plays->len + 1 > plays->cap && vec_extend(plays) == 1)
+    exit(NO_HEAP_MEM_EXIT);
+  *reference_play_at(plays, plays->len++) = play;
+}
+
+void report_perft_position(PerftReference *ref, GameManager *state,
+                           const char *what, int fast, int slow) {
+  if (ref->mismatches + ref->stuck > MAX_PERFT_REPORTS)
+    return;
+  char id[POSITION_ID_LEN + 1];
+  position_id(&state->board, state->curr_player, id);
+  printf("%s at %s roll %d%d: generator %d reference %d\n", what, id,
+         state->dice_roll.v1, state->dice_roll.v2, fast, slow);
+}
+
+void reference_plays(PerftReference *ref, GameManager *state, Vec *out) {
+  int vals[2];
+  int val_count = usable_dice(&state->dice_roll, vals);
+  CheckerKind player = state->curr_player;
+  bool on_bar = bar_count(&state->board, player) > 0;
+  bool moved = false;
+
+  for (int from = on_bar ? PLAYER_BAR_POS(player) : 0; from < BOARD_SIZE;
+       from = on_bar ? BOARD_SIZE : from + 1) {
+    for (int i = 0; i < val_count; i++) {
+      MoveError error = on_bar ? enter_error(state, vals[i])
+                               : move_error(state, from, vals[i]);
+      if (error != MoveOk)
+        continue;
+      GameManager next = *state;
+      move_checker_check_hit(&next, from, vals[i]);
+      use_roll_val(&next.dice_roll, vals[i]);
+      reference_plays(ref, &next, out);
+      moved = true;
+    }
+  }
+  if (moved)
+    return;
+  if (!turn_finished(state)) {
+    ref->stuck++;
+    report_perft_position(ref, state, "stuck turn", 0, 0);
+  }
+  add_reference_play(out, &state->board);
+}
+
+void compare_plays(PerftReference *ref, GameManager *state, Vec *plays,
+                   PlayList *list) {
+  generate_plays(state, list);
+  bool same = play_count(list) == plays->len;
+  for (int i = 0; i < play_count(list) && same; i++)
+    same = reference_contains(plays, &play_at(list, i)->key);
+  if (same)
+    return;
+  ref->mismatches++;
+  report_perft_position(ref, state, "mismatch", play_count(list),
+                        plays->len);
+}
+
+long long reference_count(PerftReference *ref, GameManager *state,
+                          DiceRoll *rolls, int depth, long long *roll_nodes) {
+  if (depth == 0 || check_game_over(state, NULL) != None)
+    return 1;
+
+  long long nodes = 0;
+  for (int i = 0; i < ROLL_COUNT; i++) {
+    state->dice_roll = rolls[i];
+    Vec *plays = &ref->plays[depth - 1];
+    plays->len = 0;
+    reference_plays(ref, state, plays);
+    compare_plays(ref, state, plays, &ref->lists[depth - 1]);
+
+    long long roll_total = 0;
+    for (int j = 0; j < plays->len; j++) {
+      GameManager next =
+          perft_child(state, &reference_play_at(plays, j)->board);
+      roll_total += reference_count(ref, &next, rolls, depth - 1, NULL);
+    }
+    if (roll_nodes != NULL)
+      roll_nodes[i] = roll_total;
+    nodes += roll_total;
+  }
+  return nodes;
+}
+
+bool check_perft(GameManager *root, int depth, long long *roll_nodes) {
+  static PerftReference ref;
+  for (int i = 0; i < depth; i++) {
+    vec_new(&ref.plays[i], sizeof(ReferencePlay));
+    if (ref.plays[i].data == NULL)
+      exit(NO_HEAP_MEM_EXIT);
+    new_play_list(&ref.lists[i]);
+  }
+  DiceRoll rolls[ROLL_COUNT];
+  int weights[ROLL_COUNT];
+  all_rolls(rolls, weights);
+
+  long long ref_nodes[ROLL_COUNT];
+  memset(ref_nodes, 0, sizeof(ref_nodes));
+  GameManager state = *root;
+  double start = monotonic_seconds();
+  long long nodes = reference_count(&ref, &state, rolls, depth, ref_nodes);
+  double secs = monotonic_seconds() - start;
+
+  bool ok = ref.mismatches == 0 && ref.stuck == 0;
+  for (int i = 0; i < ROLL_COUNT; i++) {
+    if (ref_nodes[i] == roll_nodes[i])
+      continue;
+    printf("roll %d%d: perft %lld reference %lld\n", rolls[i].v1,
+           rolls[i].v2, roll_nodes[i], ref_nodes[i]);
+    ok = false;
+  }
+  printf("reference: %lld nodes %.3fs, %lld mismatching nodes, %lld stuck "
+         "turns, %s\n",
+         nodes, secs, ref.mismatches, ref.stuck, ok ? "ok" : "FAILED");
+  for (int i = 0; i < depth; i++) {
+    vec_free(&ref.plays[i]);
+    free_play_list(&ref.lists[i]);
+  }
+  return ok;
+}
+
+bool perft_start(GameManager *root, RuleSet rules, Variant variant,
+                 const char *id) {
+  memset(root, 0, sizeof(*root));
+  root->rules = rules;
+  root->variant = variant;
+  root->board = variant_board(variant);
+  root->curr_player = White;
+  if (id == NULL)
+    return true;
+  return position_from_id(id, variant_checker_count(variant), &root->board,
+                          &root->curr_player);
+}
+
+int run_perft(int argc, char **argv) {
+  int depth = argc > 1 ? atoi(argv[1]) : 0;
+  int threads = 1;
+  RuleSet rules = HouseRules;
+  Variant variant = Backgammon;
+  const char *id = NULL;
+  bool check = false;
+  bool args_ok = depth >= 1 && depth <= MAX_PERFT_DEPTH;
+  for (int i = 2; i < argc && args_ok; i++) {
+    bool has_val = i + 1 < argc;
+    if (strcmp(argv[i], PERFT_CHECK_FLAG) == 0)
+      check = true;
+    else if (strcmp(argv[i], PERFT_THREADS_FLAG) == 0 && has_val)
+      threads = atoi(argv[++i]);
+    else if (strcmp(argv[i], PERFT_RULES_FLAG) == 0 && has_val)
+      args_ok = rule_set_from_name(argv[++i], &rules);
+    else if (strcmp(argv[i], PERFT_VARIANT_FLAG) == 0 && has_val)
+      args_ok = variant_from_name(argv[++i], &variant);
+    else if (strcmp(argv[i], PERFT_POSITION_FLAG) == 0 && has_val)
+      id = argv[++i];
+    else
+      args_ok = false;
+  }
+  if (!args_ok) {
+    fprintf(stderr,
+            "usage: %s <depth 1-%d> [%s <n>] [%s house|standard]\n"
+            "       [%s <name>] [%s <position id>] [%s]\n",
+            argv[0], MAX_PERFT_DEPTH, PERFT_THREADS_FLAG, PERFT_RULES_FLAG,
+            PERFT_VARIANT_FLAG, PERFT_POSITION_FLAG, PERFT_CHECK_FLAG);
+    return 1;
+  }
+  if (threads < 1 || threads > MAX_PERFT_THREADS)
+    threads = 1;
+
+  GameManager root;
+  if (!perft_start(&root, rules, variant, id)) {
+    fprintf(stderr, "bad position id %s\n", id);
+    return 1;
+  }
+
+  static PerftWorker workers[MAX_PERFT_THREADS];
+  for (int i = 0; i < threads; i++) {
+    for (int j = 0; j < depth; j++)
+      new_play_list(&workers[i].lists[j]);
+  }
+
+  long long roll_nodes[ROLL_COUNT];
+  for (int d = 1; d <= depth; d++) {
+    double start = monotonic_seconds();
+    long long nodes = perft(&root, d, workers, threads, roll_nodes);
+    double secs = monotonic_seconds() - start;
+    printf("depth %d: %lld nodes %.3fs %.0f nodes/s\n", d, nodes, secs,
+           secs > 0 ? nodes / secs : 0);
+  }
+
+  DiceRoll rolls[ROLL_COUNT];
+  int weights[ROLL_COUNT];
+  all_rolls(rolls, weights);
+  for (int i = 0; i < ROLL_COUNT; i++)
+    printf("roll %d%d: %lld\n", rolls[i].v1, rolls[i].v2, roll_nodes[i]);
+
+  for (int i = 0; i < threads; i++) {
+    for (int j = 0; j < depth; j++)
+      free_play_list(&workers[i].lists[j]);
+  }
+  if (check && !check_perft(&root, depth, roll_nodes))
+    return 1;
+  return 0;
+}
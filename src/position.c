@@ -0,0 +1,175 @@
+#pragma once
+#include "../headers/position.h"
+#include "game.c"
+#include <string.h>
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define SIDE_HASH_MIX 0x9e3779b97f4a7c15ULL
+
+const char *BASE64_CHARS =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// slot 0-23 are the points counted from the side's home, 24 is the bar
+BoardPoint *position_slot(Board *board, CheckerKind side, int slot) {
+  if (slot == BOARD_SIZE)
+    return side == White ? &board->white_bar : &board->red_bar;
+  int id = side == White ? BOARD_SIZE - slot - 1 : slot;
+  return &board->board_points[id];
+}
+
+int slot_count(Board *board, CheckerKind side, int slot) {
+  BoardPoint *point = position_slot(board, side, slot);
+  if (point->checker_kind != side)
+    return 0;
+  return point->checker_count;
+}
+
+void set_key_bit(PositionKey *key, int bit) {
+  key->bytes[bit / 8] |= 1 << (bit % 8);
+}
+
+bool key_bit(const PositionKey *key, int bit) {
+  return key->bytes[bit / 8] & (1 << (bit % 8));
+}
+
+// for every slot of white and then red: one bit per checker and a zero
+void position_key(Board *board, PositionKey *key) {
+  memset(key, 0, sizeof(PositionKey));
+  int bit = 0;
+  CheckerKind sides[] = {White, Red};
+  for (int i = 0; i < 2; i++) {
+    for (int slot = 0; slot < POSITION_SLOT_COUNT; slot++) {
+      int count = slot_count(board, sides[i], slot);
+      for (int j = 0; j < count; j++)
+        set_key_bit(key, bit++);
+      bit++;
+    }
+  }
+}
+
+// the key only holds the checkers in play, the rest of the checkers each
+// side starts with are borne off
+bool board_from_key(const PositionKey *key, int checkers, Board *board) {
+  *board = empty_board();
+  int bit = 0;
+  CheckerKind sides[] = {White, Red};
+  for (int i = 0; i < 2; i++) {
+    int total = 0;
+    for (int slot = 0; slot < POSITION_SLOT_COUNT; slot++) {
+      int count = 0;
+      while (bit < POSITION_KEY_LEN * 8 && key_bit(key, bit)) {
+        count++;
+        bit++;
+      }
+      bit++;
+      if (count == 0)
+        continue;
+
+      BoardPoint *point = position_slot(board, sides[i], slot);
+      if (point->checker_count > 0 && point->checker_kind != sides[i])
+        return false;
+      point->checker_kind = sides[i];
+      point->checker_count = count;
+      total += count;
+    }
+    if (total > checkers)
+      return false;
+    add_to_out(board, sides[i], checkers - total);
+  }
+  return bit <= POSITION_KEY_LEN * 8;
+}
+
+unsigned long long key_hash(const PositionKey *key, CheckerKind side) {
+  unsigned long long hash = FNV_OFFSET;
+  for (int i = 0; i < POSITION_KEY_LEN; i++) {
+    hash ^= key->bytes[i];
+    hash *= FNV_PRIME;
+  }
+  if (side == Red)
+    hash ^= SIDE_HASH_MIX;
+  return hash;
+}
+
+unsigned long long position_hash(Board *board, CheckerKind side) {
+  PositionKey key;
+  position_key(board, &key);
+  return key_hash(&key, side);
+}
+
+// out has to hold POSITION_ID_LEN + 1 chars
+void position_id_from_key(const PositionKey *key, CheckerKind side,
+                          char *out) {
+  int side_bit = POSITION_KEY_LEN * 8;
+  for (int i = 0; i < POSITION_ID_LEN; i++) {
+    int val = 0;
+    for (int j = 0; j < BASE64_BITS; j++) {
+      int bit = i * BASE64_BITS + j;
+      bool set = bit < side_bit ? key_bit(key, bit)
+                                : bit == side_bit && side == Red;
+      if (set)
+        val |= 1 << j;
+    }
+    out[i] = BASE64_CHARS[val];
+  }
+  out[POSITION_ID_LEN] = '\0';
+}
+
+void position_id(Board *board, CheckerKind side, char *out) {
+  PositionKey key;
+  position_key(board, &key);
+  position_id_from_key(&key, side, out);
+}
+
+bool key_from_id(const char *id, PositionKey *key, CheckerKind *side) {
+  if (strlen(id) != POSITION_ID_LEN)
+    return false;
+
+  memset(key, 0, sizeof(PositionKey));
+  int side_bit = POSITION_KEY_LEN * 8;
+  *side = White;
+  for (int i = 0; i < POSITION_ID_LEN; i++) {
+    const char *found = strchr(BASE64_CHARS, id[i]);
+    if (found == NULL || id[i] == '\0')
+      return false;
+    int val = found - BASE64_CHARS;
+    for (int j = 0; j < BASE64_BITS; j++) {
+      int bit = i * BASE64_BITS + j;
+      if (!(val & (1 << j)))
+        continue;
+      if (bit < side_bit)
+        set_key_bit(key, bit);
+      else if (bit == side_bit)
+        *side = Red;
+    }
+  }
+  return true;
+}
+
+bool position_from_id(const char *id, int checkers, Board *board,
+                      CheckerKind *side) {
+  PositionKey key;
+  return key_from_id(id, &key, side) && board_from_key(&key, checkers, board);
+}
+
+int mirror_pos(int pos) {
+  if (pos == WHITE_BAR_POS)
+    return RED_BAR_POS;
+  if (pos == RED_BAR_POS)
+    return WHITE_BAR_POS;
+  return BOARD_SIZE - 1 - pos;
+}
+
+// the same position with the colours swapped
+void mirror_board(Board *board, Board *out) {
+  *out = empty_board();
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    BoardPoint *point = &board->board_points[BOARD_SIZE - 1 - i];
+    out->board_points[i].checker_kind = opposite_checker(point->checker_kind);
+    out->board_points[i].checker_count = point->checker_count;
+  }
+  out->white_bar.checker_count = board->red_bar.checker_count;
+  out->red_bar.checker_count = board->white_bar.checker_count;
+  out->white_out_count = board->red_out_count;
+  out->red_out_count = board->white_out_count;
+}
@@ -0,0 +1,586 @@
+#pragma once
+#include "../headers/position_index.h"
+#include "game.c"
+#include "position.c"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A position of an archived game: the board and side to move after move
+// moves of the turn. Positions between turns are kept once, as move 0 of
+// the next turn, and the last position of the game as its last move.
+typedef struct {
+  uint64_t hash;
+  uint32_t game;
+  uint16_t turn;
+  uint8_t move;
+  uint8_t side;
+  PositionKey key;
+  uint8_t reserved[6];
+} IndexEntry;
+
+_Static_assert(sizeof(IndexEntry) == INDEX_ENTRY_SIZE,
+               "IndexEntry is read straight from the file");
+
+typedef struct {
+  char magic[INDEX_MAGIC_LEN];
+  uint32_t entry_count;
+  uint32_t entry_size;
+  uint32_t game_count;
+  uint32_t names_len;
+} IndexHeader;
+
+// the pattern columns of the index, see headers/position_index.h
+typedef struct {
+  const uint32_t *held[2], *made[2];
+  const uint8_t *bar[2];
+} PatternColumns;
+
+typedef struct {
+  void *map;
+  size_t map_len;
+  const IndexEntry *entries;
+  uint32_t entry_count;
+  PatternColumns columns;
+  // game id to save file name, pointing into the map
+  const char **names;
+  uint32_t game_count;
+} PositionIndex;
+
+typedef struct IndexBuilder IndexBuilder;
+
+// every worker sorts its own entries, the runs are merged on writing
+typedef struct {
+  IndexBuilder *builder;
+  Vec entries;
+  long long games, failed;
+} IndexWorker;
+
+struct IndexBuilder {
+  char **files;
+  int file_count;
+  atomic_int next_file;
+  IndexWorker workers[MAX_INDEX_THREADS];
+};
+
+int compare_index_entries(const void *a, const void *b) {
+  const IndexEntry *x = a, *y = b;
+  if (x->hash != y->hash)
+    return x->hash < y->hash ? -1 : 1;
+  if (x->game != y->game)
+    return x->game < y->game ? -1 : 1;
+  if (x->turn != y->turn)
+    return (int)x->turn - (int)y->turn;
+  return (int)x->move - (int)y->move;
+}
+
+void push_index_entry(Vec *entries, GameManager *game, int id, int turn,
+                      int move) {
+  IndexEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  position_key(&game->board, &entry.key);
+  entry.hash = key_hash(&entry.key, game->curr_player);
+  entry.game = id;
+  entry.turn = turn;
+  entry.move = move;
+  entry.side = game->curr_player;
+  if (entries->len + 1 > entries->cap && vec_extend(entries) == 1)
+    exit(NO_HEAP_MEM_EXIT);
+  ((IndexEntry *)entries->data)[entries->len++] = entry;
+}
+
+typedef struct {
+  Vec *entries;
+  int id, last_turn, last_moves;
+} IndexReplay;
+
+// a turn without moves still gets its position
+bool index_replayed_turn(void *ctx, GameManager *game, TurnEntry *turn,
+                         int t) {
+  IndexReplay *replay = ctx;
+  if (t >= MAX_INDEX_TURNS)
+    return false;
+  if (turn->move_count == 0)
+    push_index_entry(replay->entries, game, replay->id, t, 0);
+  replay->last_turn = t;
+  replay->last_moves = turn->move_count;
+  return true;
+}
+
+bool index_replayed_move(void *ctx, GameManager *game, TurnEntry *turn,
+                         int t, int m) {
+  (void)turn;
+  IndexReplay *replay = ctx;
+  push_index_entry(replay->entries, game, replay->id, t, m);
+  return true;
+}
+
+// every position before a move and the one the game ended at, a game whose
+// log doesn't lead to the saved board is dropped
+bool index_saved_game(Vec *entries, const char *filename, int id) {
+  int start_len = entries->len;
+  IndexReplay replay = {entries, id, 0, 0};
+  ReplayHooks hooks = {index_replayed_turn, index_replayed_move, &replay};
+  GameManager game;
+  if (!replay_saved_game(filename, &game, &hooks)) {
+    entries->len = start_len;
+    return false;
+  }
+  if (replay.last_moves > 0)
+    push_index_entry(entries, &game, id, replay.last_turn, replay.last_moves);
+  return true;
+}
+
+// files are handed out one at a time like in the importer
+void *index_worker(void *arg) {
+  IndexWorker *worker = arg;
+  IndexBuilder *builder = worker->builder;
+  int id;
+  while ((id = atomic_fetch_add(&builder->next_file, 1)) <
+         builder->file_count) {
+    if (index_saved_game(&worker->entries, builder->files[id], id)) {
+      worker->games++;
+    } else {
+      fprintf(stderr, "skipping %s\n", builder->files[id]);
+      worker->failed++;
+    }
+  }
+  qsort(worker->entries.data, worker->entries.len, sizeof(IndexEntry),
+        compare_index_entries);
+  return NULL;
+}
+
+// the pattern columns of a position, 0 is the side to move
+void pattern_row(const IndexEntry *entry, uint32_t held[2], uint32_t made[2],
+                 uint8_t bar[2]) {
+  int bit = 0;
+  for (int i = 0; i < 2; i++) {
+    // the key holds White first
+    int side = (i == 0) == (entry->side == White) ? 0 : 1;
+    held[side] = made[side] = 0;
+    for (int slot = 0; slot < POSITION_SLOT_COUNT; slot++) {
+      int count = 0;
+      while (bit < POSITION_KEY_LEN * 8 && key_bit(&entry->key, bit)) {
+        count++;
+        bit++;
+      }
+      bit++;
+      if (slot == BOARD_SIZE) {
+        bar[side] = count;
+      } else {
+        held[side] |= (uint32_t)(count > 0) << slot;
+        made[side] |= (uint32_t)(count > 1) << slot;
+      }
+    }
+  }
+}
+
+// merges the sorted runs of the workers straight into the file
+bool write_position_index(IndexBuilder *builder, int threads,
+                          const char *filename) {
+  IndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, INDEX_MAGIC, INDEX_MAGIC_LEN);
+  header.entry_size = INDEX_ENTRY_SIZE;
+  header.game_count = builder->file_count;
+  for (int i = 0; i < threads; i++)
+    header.entry_count += builder->workers[i].entries.len;
+  for (int i = 0; i < builder->file_count; i++)
+    header.names_len += strlen(builder->files[i]) + 1;
+
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+  bool success = fwrite(&header, sizeof(header), 1, fp) == 1;
+  uint32_t *masks =
+      malloc((size_t)header.entry_count * PATTERN_MASK_COLUMNS * 4);
+  uint8_t *bars = malloc((size_t)header.entry_count * PATTERN_BAR_COLUMNS);
+  if (masks == NULL || bars == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+
+  int next[MAX_INDEX_THREADS] = {0};
+  for (uint32_t n = 0; n < header.entry_count && success; n++) {
+    const IndexEntry *min = NULL;
+    int min_run = 0;
+    for (int i = 0; i < threads; i++) {
+      Vec *run = &builder->workers[i].entries;
+      if (next[i] == run->len)
+        continue;
+      const IndexEntry *entry = (IndexEntry *)run->data + next[i];
+      if (min == NULL || compare_index_entries(entry, min) < 0) {
+        min = entry;
+        min_run = i;
+      }
+    }
+    next[min_run]++;
+    success = fwrite(min, sizeof(IndexEntry), 1, fp) == 1;
+
+    uint32_t held[2], made[2];
+    uint8_t bar[2];
+    pattern_row(min, held, made, bar);
+    for (int side = 0; side < 2; side++) {
+      masks[(2 * side) * (size_t)header.entry_count + n] = held[side];
+      masks[(2 * side + 1) * (size_t)header.entry_count + n] = made[side];
+      bars[side * (size_t)header.entry_count + n] = bar[side];
+    }
+  }
+  success = success &&
+            fwrite(masks, 4 * PATTERN_MASK_COLUMNS, header.entry_count,
+                   fp) == header.entry_count &&
+            fwrite(bars, PATTERN_BAR_COLUMNS, header.entry_count, fp) ==
+                header.entry_count;
+  free(masks);
+  free(bars);
+  for (int i = 0; i < builder->file_count && success; i++)
+    success = fwrite(builder->files[i], strlen(builder->files[i]) + 1, 1,
+                     fp) == 1;
+  return fclose(fp) == 0 && success;
+}
+
+int build_position_index(const char *filename, char **files, int file_count,
+                         int threads) {
+  static IndexBuilder builder;
+  builder.files = files;
+  builder.file_count = file_count;
+  atomic_init(&builder.next_file, 0);
+  if (threads > file_count)
+    threads = file_count;
+
+  double start = monotonic_seconds();
+  pthread_t handles[MAX_INDEX_THREADS];
+  bool started[MAX_INDEX_THREADS] = {false};
+  for (int i = 0; i < threads; i++) {
+    IndexWorker *worker = &builder.workers[i];
+    worker->builder = &builder;
+    vec_new(&worker->entries, sizeof(IndexEntry));
+    if (worker->entries.data == NULL)
+      exit(NO_HEAP_MEM_EXIT);
+    if (i > 0)
+      started[i] = pthread_create(&handles[i], NULL, index_worker, worker) ==
+                   0;
+  }
+  index_worker(&builder.workers[0]);
+  for (int i = 1; i < threads; i++) {
+    if (started[i])
+      pthread_join(handles[i], NULL);
+  }
+  // a worker that didn't start leaves its entries empty, the others took
+  // its files
+  double built = monotonic_seconds();
+  bool saved = write_position_index(&builder, threads, filename);
+  if (!saved)
+    fprintf(stderr, "can't write %s\n", filename);
+
+  long long games = 0, failed = 0, positions = 0;
+  for (int i = 0; i < threads; i++) {
+    games += builder.workers[i].games;
+    failed += builder.workers[i].failed;
+    positions += builder.workers[i].entries.len;
+    vec_free(&builder.workers[i].entries);
+  }
+  double secs = monotonic_seconds() - start;
+  printf("games %lld failed %lld positions %lld %.2fs (%.2fs replay) "
+         "%.0f games/s\n",
+         games, failed, positions, secs, built - start,
+         secs > 0 ? games / secs : 0);
+  return saved ? 0 : 1;
+}
+
+bool load_position_index(PositionIndex *index, const char *filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(IndexHeader)) {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  const IndexHeader *header = map;
+  size_t columns_at =
+      sizeof(IndexHeader) + (size_t)header->entry_count * INDEX_ENTRY_SIZE;
+  size_t names_at =
+      columns_at + (size_t)header->entry_count * PATTERN_COLUMNS_SIZE;
+  if (memcmp(header->magic, INDEX_MAGIC, INDEX_MAGIC_LEN) != 0 ||
+      header->entry_size != INDEX_ENTRY_SIZE ||
+      names_at + header->names_len > (size_t)st.st_size) {
+    munmap(map, st.st_size);
+    return false;
+  }
+
+  const char **names = malloc((header->game_count + 1) * sizeof(char *));
+  if (names == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  const char *name = (const char *)map + names_at;
+  const char *names_end = name + header->names_len;
+  for (uint32_t i = 0; i < header->game_count; i++) {
+    const char *end = name < names_end ? memchr(name, '\0', names_end - name)
+                                       : NULL;
+    if (end == NULL) {
+      free(names);
+      munmap(map, st.st_size);
+      return false;
+    }
+    names[i] = name;
+    name = end + 1;
+  }
+
+  index->map = map;
+  index->map_len = st.st_size;
+  index->entries =
+      (const IndexEntry *)((const char *)map + sizeof(IndexHeader));
+  index->entry_count = header->entry_count;
+  const uint32_t *masks = (const uint32_t *)((const char *)map + columns_at);
+  const uint8_t *bars =
+      (const uint8_t *)(masks + PATTERN_MASK_COLUMNS * header->entry_count);
+  for (int side = 0; side < 2; side++) {
+    index->columns.held[side] = masks + 2 * side * header->entry_count;
+    index->columns.made[side] = masks + (2 * side + 1) * header->entry_count;
+    index->columns.bar[side] = bars + side * header->entry_count;
+  }
+  index->names = names;
+  index->game_count = header->game_count;
+  return true;
+}
+
+void free_position_index(PositionIndex *index) {
+  if (index->map != NULL)
+    munmap(index->map, index->map_len);
+  free(index->names);
+  memset(index, 0, sizeof(*index));
+}
+
+// first entry with the hash, entry_count when there is none
+uint32_t find_index_entry(PositionIndex *index, uint64_t hash) {
+  uint32_t lo = 0, hi = index->entry_count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (index->entries[mid].hash < hash)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < index->entry_count && index->entries[lo].hash == hash
+             ? lo
+             : index->entry_count;
+}
+
+// the position is a position id or a save file, whose board and side to
+// move are looked up
+bool index_query_key(const char *position, PositionKey *key,
+                     CheckerKind *side) {
+  if (key_from_id(position, key, side))
+    return true;
+  FILE *fp = fopen(position, "r");
+  if (fp == NULL)
+    return false;
+  GameManager game;
+  memset(&game, 0, sizeof(game));
+  bool success = read_game(&game, fp);
+  fclose(fp);
+  if (!success)
+    return false;
+  position_key(&game.board, key);
+  *side = game.curr_player;
+  free_turn_log(&game.turn_log);
+  return true;
+}
+
+// prints every game, turn and move the position occurred at, the key guards
+// against hash collisions
+int find_position(const char *filename, const char *position) {
+  PositionKey key;
+  CheckerKind side;
+  if (!index_query_key(position, &key, &side)) {
+    fprintf(stderr, "bad position id or save file %s\n", position);
+    return 1;
+  }
+  PositionIndex index;
+  if (!load_position_index(&index, filename)) {
+    fprintf(stderr, "can't read %s\n", filename);
+    return 1;
+  }
+
+  int found = 0;
+  for (uint32_t i = find_index_entry(&index, key_hash(&key, side));
+       i < index.entry_count && index.entries[i].hash == key_hash(&key, side);
+       i++) {
+    const IndexEntry *entry = &index.entries[i];
+    if (memcmp(&entry->key, &key, sizeof(key)) != 0 ||
+        entry->side != side || entry->game >= index.game_count)
+      continue;
+    printf("%s turn %d move %d\n", index.names[entry->game], entry->turn,
+           entry->move);
+    found++;
+  }
+  printf("found %d\n", found);
+  free_position_index(&index);
+  return 0;
+}
+
+// A conjunction of terms on the columns, 0 is the side to move: the points
+// it has to hold, to have made and to have a blot on, the length of a
+// prime it has to have and its least checkers on the bar
+typedef struct {
+  uint32_t held[2], made[2], blots[2];
+  int prime[2];
+  uint8_t bar[2];
+} PatternQuery;
+
+// terms are [opp:]point=P, [opp:]blot=P, [opp:]prime=N and [opp:]bar>=N,
+// points counted from the side's own home like anchor=20
+bool parse_pattern_term(const char *term, PatternQuery *query) {
+  int side = 0;
+  size_t prefix_len = strlen(OPPONENT_PATTERN_PREFIX);
+  if (strncmp(term, OPPONENT_PATTERN_PREFIX, prefix_len) == 0) {
+    side = 1;
+    term += prefix_len;
+  }
+  int val;
+  char end;
+  if (sscanf(term, "bar>=%d%c", &val, &end) == 1 && val >= 0 &&
+      val <= CHECKER_COUNT) {
+    query->bar[side] = val;
+    return true;
+  }
+  if (sscanf(term, "prime=%d%c", &val, &end) == 1 && val >= 1 &&
+      val <= BOARD_SIZE) {
+    query->prime[side] = val;
+    return true;
+  }
+  char kind[8];
+  if (sscanf(term, "%7[a-z]=%d%c", kind, &val, &end) != 2 || val < 1 ||
+      val > BOARD_SIZE)
+    return false;
+  uint32_t bit = (uint32_t)1 << (val - 1);
+  if (strcmp(kind, "point") == 0 || strcmp(kind, "anchor") == 0)
+    query->made[side] |= bit;
+  else if (strcmp(kind, "blot") == 0)
+    query->blots[side] |= bit;
+  else
+    return false;
+  return true;
+}
+
+// Marks the positions of a block matching the query, every test is a pass
+// over the block's masks without branches so -O3 vectorizes it
+int scan_pattern_block(PatternColumns *columns, PatternQuery *query,
+                       uint32_t start, int len, uint8_t *match) {
+  for (int i = 0; i < len; i++)
+    match[i] = 1;
+  for (int side = 0; side < 2; side++) {
+    const uint32_t *held = columns->held[side] + start;
+    const uint32_t *made = columns->made[side] + start;
+    const uint8_t *bar = columns->bar[side] + start;
+    uint32_t need_held = query->held[side] | query->blots[side];
+    uint32_t need_made = query->made[side], blots = query->blots[side];
+    uint8_t min_bar = query->bar[side];
+    for (int i = 0; i < len; i++)
+      match[i] &= ((held[i] & need_held) == need_held) &
+                  ((made[i] & need_made) == need_made) &
+                  ((made[i] & blots) == 0) & (bar[i] >= min_bar);
+
+    if (query->prime[side] == 0)
+      continue;
+    // a run of prime made points leaves a bit standing after the shifts
+    uint32_t run[PATTERN_BLOCK];
+    for (int i = 0; i < len; i++)
+      run[i] = made[i];
+    for (int k = 1; k < query->prime[side]; k++) {
+      for (int i = 0; i < len; i++)
+        run[i] &= made[i] >> k;
+    }
+    for (int i = 0; i < len; i++)
+      match[i] &= run[i] != 0;
+  }
+
+  int count = 0;
+  for (int i = 0; i < len; i++)
+    count += match[i];
+  return count;
+}
+
+// counts the positions matching every term and prints the first ones
+int find_pattern(const char *filename, char **terms, int term_count) {
+  PatternQuery query;
+  memset(&query, 0, sizeof(query));
+  for (int i = 0; i < term_count; i++) {
+    if (!parse_pattern_term(terms[i], &query)) {
+      fprintf(stderr, "bad pattern term %s\n", terms[i]);
+      return 1;
+    }
+  }
+  PositionIndex index;
+  if (!load_position_index(&index, filename)) {
+    fprintf(stderr, "can't read %s\n", filename);
+    return 1;
+  }
+
+  double start = monotonic_seconds();
+  uint8_t match[PATTERN_BLOCK];
+  long long found = 0;
+  for (uint32_t block = 0; block < index.entry_count;
+       block += PATTERN_BLOCK) {
+    int len = index.entry_count - block < PATTERN_BLOCK
+                  ? index.entry_count - block
+                  : PATTERN_BLOCK;
+    int count = scan_pattern_block(&index.columns, &query, block, len, match);
+    for (int i = 0; i < len && count > 0 && found < MAX_PATTERN_PRINTS;
+         i++) {
+      if (!match[i])
+        continue;
+      const IndexEntry *entry = &index.entries[block + i];
+      if (entry->game < index.game_count)
+        printf("%s turn %d move %d\n", index.names[entry->game],
+               entry->turn, entry->move);
+      found++;
+      count--;
+    }
+    found += count;
+  }
+  double secs = monotonic_seconds() - start;
+  printf("found %lld of %u positions %.4fs %.0f positions/s\n", found,
+         index.entry_count, secs, secs > 0 ? index.entry_count / secs : 0);
+  free_position_index(&index);
+  return 0;
+}
+
+// usage: index [-j threads] <index file> <save file>...
+//        index --find <index file> <position id|save file>
+//        index --pattern <index file> <term>...
+int run_position_index(int argc, char **argv) {
+  if (argc == 4 && strcmp(argv[1], INDEX_FIND_FLAG) == 0)
+    return find_position(argv[2], argv[3]);
+  if (argc >= 4 && strcmp(argv[1], INDEX_PATTERN_FLAG) == 0)
+    return find_pattern(argv[2], argv + 3, argc - 3);
+
+  int arg = 1;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+    threads = atoi(argv[2]);
+    arg = 3;
+  }
+  if (argc - arg < 2) {
+    fprintf(stderr,
+            "usage: %s [-j threads] <index file> <save file>...\n"
+            "       %s %s <index file> <position id|save file>\n"
+            "       %s %s <index file> <term>...\n",
+            argv[0], argv[0], INDEX_FIND_FLAG, argv[0], INDEX_PATTERN_FLAG);
+    return 1;
+  }
+  if (threads < 1)
+    threads = 1;
+  if (threads > MAX_INDEX_THREADS)
+    threads = MAX_INDEX_THREADS;
+  return build_position_index(argv[arg], argv + arg + 1, argc - arg - 1,
+                              threads);
+}
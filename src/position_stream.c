@@ -0,0 +1,242 @@
+#pragma once
+#include "../headers/position_stream.h"
+#include "game.c"
+#include "position.c"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  PositionKey key;
+  unsigned char side;
+  // first die in the high nibble
+  unsigned char dice;
+  // points White won the game with, negative when Red won
+  signed char result;
+  unsigned char turn;
+  // streams written before variants were exported hold 0, Backgammon
+  unsigned char variant;
+  unsigned char reserved;
+} PositionRecord;
+
+_Static_assert(sizeof(PositionRecord) == POSITION_RECORD_SIZE,
+               "PositionRecord has to stay fixed width");
+
+typedef struct {
+  uint64_t offset;
+  uint32_t record_count;
+  uint32_t reserved;
+} ChunkIndexEntry;
+
+typedef struct {
+  uint64_t index_offset;
+  uint32_t chunk_count;
+  char magic[POSITION_MAGIC_LEN];
+  char reserved[2];
+} StreamTrailer;
+
+typedef struct {
+  FILE *fp;
+  PositionRecord records[RECORDS_PER_CHUNK];
+  int record_count;
+  unsigned char packed[CHUNK_BUF_SIZE];
+  Vec index;
+  uint64_t offset;
+  long long total_records;
+  uint64_t packed_bytes;
+} PositionWriter;
+
+typedef struct {
+  FILE *fp;
+  ChunkIndexEntry *index;
+  uint32_t chunk_count;
+  unsigned char packed[CHUNK_BUF_SIZE];
+} PositionReader;
+
+PositionRecord new_position_record(Board *board, Variant variant,
+                                   CheckerKind side, int v1, int v2,
+                                   int turn) {
+  PositionRecord record;
+  memset(&record, 0, sizeof(record));
+  position_key(board, &record.key);
+  record.side = side;
+  record.dice = v1 << 4 | v2;
+  record.result = NO_RESULT;
+  record.turn = turn < MAX_RECORD_TURN ? turn : MAX_RECORD_TURN;
+  record.variant = variant;
+  return record;
+}
+
+// XOR with the previous record, then zero runs become (0, length)
+int pack_records(PositionRecord *records, int count, unsigned char *out) {
+  unsigned char prev[POSITION_RECORD_SIZE] = {0};
+  int len = 0, zeros = 0;
+  for (int i = 0; i < count; i++) {
+    unsigned char *bytes = (unsigned char *)&records[i];
+    for (int b = 0; b < POSITION_RECORD_SIZE; b++) {
+      unsigned char delta = bytes[b] ^ prev[b];
+      prev[b] = bytes[b];
+      if (delta == 0 && zeros < MAX_ZERO_RUN) {
+        zeros++;
+        continue;
+      }
+      if (zeros > 0) {
+        out[len++] = 0;
+        out[len++] = zeros;
+        zeros = 0;
+      }
+      if (delta == 0)
+        zeros = 1;
+      else
+        out[len++] = delta;
+    }
+  }
+  if (zeros > 0) {
+    out[len++] = 0;
+    out[len++] = zeros;
+  }
+  return len;
+}
+
+// returns false on data that doesn't unpack to exactly count records
+bool unpack_records(const unsigned char *packed, int len,
+                    PositionRecord *records, int count) {
+  unsigned char *out = (unsigned char *)records;
+  int total = count * POSITION_RECORD_SIZE, pos = 0;
+  for (int i = 0; i < len; i++) {
+    if (packed[i] != 0) {
+      if (pos >= total)
+        return false;
+      out[pos++] = packed[i];
+      continue;
+    }
+    if (++i >= len || pos + packed[i] > total)
+      return false;
+    memset(out + pos, 0, packed[i]);
+    pos += packed[i];
+  }
+  if (pos != total)
+    return false;
+
+  for (int b = POSITION_RECORD_SIZE; b < total; b++)
+    out[b] ^= out[b - POSITION_RECORD_SIZE];
+  return true;
+}
+
+bool open_position_writer(PositionWriter *writer, const char *filename) {
+  writer->fp = fopen(filename, "wb");
+  if (writer->fp == NULL)
+    return false;
+  writer->record_count = 0;
+  writer->total_records = 0;
+  writer->packed_bytes = 0;
+  vec_new(&writer->index, sizeof(ChunkIndexEntry));
+  if (writer->index.data == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+
+  uint32_t sizes[2] = {POSITION_RECORD_SIZE, RECORDS_PER_CHUNK};
+  writer->offset = POSITION_MAGIC_LEN + sizeof(sizes);
+  return fwrite(POSITION_STREAM_MAGIC, 1, POSITION_MAGIC_LEN, writer->fp) ==
+             POSITION_MAGIC_LEN &&
+         fwrite(sizes, sizeof(sizes), 1, writer->fp) == 1;
+}
+
+bool flush_position_chunk(PositionWriter *writer) {
+  if (writer->record_count == 0)
+    return true;
+  uint32_t header[2] = {writer->record_count, 0};
+  header[1] = pack_records(writer->records, writer->record_count,
+                           writer->packed);
+
+  if (writer->index.len + 1 > writer->index.cap &&
+      vec_extend(&writer->index) == 1)
+    exit(NO_HEAP_MEM_EXIT);
+  ChunkIndexEntry *index = writer->index.data;
+  index[writer->index.len++] =
+      (ChunkIndexEntry){writer->offset, writer->record_count, 0};
+
+  writer->offset += sizeof(header) + header[1];
+  writer->packed_bytes += sizeof(header) + header[1];
+  writer->record_count = 0;
+  return fwrite(header, sizeof(header), 1, writer->fp) == 1 &&
+         fwrite(writer->packed, 1, header[1], writer->fp) == header[1];
+}
+
+bool write_position_record(PositionWriter *writer, PositionRecord *record) {
+  writer->records[writer->record_count++] = *record;
+  writer->total_records++;
+  if (writer->record_count < RECORDS_PER_CHUNK)
+    return true;
+  return flush_position_chunk(writer);
+}
+
+// writes the last chunk, the index and the trailer
+bool close_position_writer(PositionWriter *writer) {
+  bool success = flush_position_chunk(writer);
+  StreamTrailer trailer = {writer->offset, writer->index.len,
+                           POSITION_INDEX_MAGIC, {0}};
+  size_t index_len = writer->index.len;
+  success = success &&
+            fwrite(writer->index.data, sizeof(ChunkIndexEntry), index_len,
+                   writer->fp) == index_len &&
+            fwrite(&trailer, sizeof(trailer), 1, writer->fp) == 1;
+  vec_free(&writer->index);
+  return fclose(writer->fp) == 0 && success;
+}
+
+bool open_position_reader(PositionReader *reader, const char *filename) {
+  reader->index = NULL;
+  reader->fp = fopen(filename, "rb");
+  if (reader->fp == NULL)
+    return false;
+
+  char magic[POSITION_MAGIC_LEN];
+  uint32_t sizes[2];
+  StreamTrailer trailer;
+  bool success =
+      fread(magic, 1, POSITION_MAGIC_LEN, reader->fp) == POSITION_MAGIC_LEN &&
+      memcmp(magic, POSITION_STREAM_MAGIC, POSITION_MAGIC_LEN) == 0 &&
+      fread(sizes, sizeof(sizes), 1, reader->fp) == 1 &&
+      sizes[0] == POSITION_RECORD_SIZE && sizes[1] == RECORDS_PER_CHUNK &&
+      fseek(reader->fp, -(long)sizeof(trailer), SEEK_END) == 0 &&
+      fread(&trailer, sizeof(trailer), 1, reader->fp) == 1 &&
+      memcmp(trailer.magic, POSITION_INDEX_MAGIC, POSITION_MAGIC_LEN) == 0;
+  if (success) {
+    reader->chunk_count = trailer.chunk_count;
+    reader->index =
+        malloc(sizeof(ChunkIndexEntry) * (trailer.chunk_count + 1));
+    if (reader->index == NULL)
+      exit(NO_HEAP_MEM_EXIT);
+    success = fseek(reader->fp, trailer.index_offset, SEEK_SET) == 0 &&
+              fread(reader->index, sizeof(ChunkIndexEntry),
+                    trailer.chunk_count,
+                    reader->fp) == trailer.chunk_count;
+  }
+  if (!success) {
+    free(reader->index);
+    fclose(reader->fp);
+  }
+  return success;
+}
+
+// reads any chunk, in any order; returns its record count or -1
+int read_position_chunk(PositionReader *reader, uint32_t chunk,
+                        PositionRecord *records) {
+  if (chunk >= reader->chunk_count)
+    return -1;
+  ChunkIndexEntry *entry = &reader->index[chunk];
+  uint32_t header[2];
+  if (fseek(reader->fp, entry->offset, SEEK_SET) != 0 ||
+      fread(header, sizeof(header), 1, reader->fp) != 1 ||
+      header[0] != entry->record_count || header[0] > RECORDS_PER_CHUNK ||
+      header[1] > CHUNK_BUF_SIZE ||
+      fread(reader->packed, 1, header[1], reader->fp) != header[1] ||
+      !unpack_records(reader->packed, header[1], records, header[0]))
+    return -1;
+  return header[0];
+}
+
+void close_position_reader(PositionReader *reader) {
+  free(reader->index);
+  fclose(reader->fp);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "../headers/rng.h"
+#include "game.c"
+
+#define RNG_MULTIPLIER 2685821657736338717ULL
+#define RNG_SEED_MIX 0x9e3779b97f4a7c15ULL
+
+Rng new_rng(unsigned long long seed) {
+  Rng rng = {seed ^ RNG_SEED_MIX};
+  if (rng.state == 0)
+    rng.state = RNG_SEED_MIX;
+  return rng;
+}
+
+unsigned long long rng_next(Rng *rng) {
+  rng->state ^= rng->state >> 12;
+  rng->state ^= rng->state << 25;
+  rng->state ^= rng->state >> 27;
+  return rng->state * RNG_MULTIPLIER;
+}
+
+// uniform in [0, 1)
+double rng_double(Rng *rng) {
+  return (rng_next(rng) >> 11) * (1.0 / (1ULL << 53));
+}
+
+int rng_die(Rng *rng) { return (rng_next(rng) >> 32) % 6 + 1; }
+
+DiceRoll rng_dice_roll(Rng *rng) {
+  return new_dice_roll(rng_die(rng), rng_die(rng));
+}
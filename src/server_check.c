@@ -0,0 +1,258 @@
+#pragma once
+#include "../headers/server_check.h"
+#include "engine.c"
+#include "game_server.c"
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/wait.h>
+
+// Plays games through the line protocol like remote clients would. The
+// server runs in a child process, every game has a session per side and
+// the games take turns, so the server always has several going at once.
+// Each side keeps its own copy of the game to pick plays from and to
+// compare the server's board and replies with.
+
+typedef struct {
+  int fd;
+  FILE *in;
+} CheckClient;
+
+typedef struct {
+  int number;
+  // White's session first
+  CheckClient seats[2];
+  GameManager mirror;
+  // the last TURN both sessions got
+  char turn[SERVER_REPLY_LEN];
+  int turns;
+  bool active, failed;
+} CheckGame;
+
+void check_fail(CheckGame *check, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  printf("game %d: ", check->number);
+  vprintf(fmt, args);
+  printf("\n");
+  va_end(args);
+  check->failed = true;
+  check->active = false;
+}
+
+bool check_connect(CheckClient *client, const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  strcpy(addr.sun_path, path);
+  for (int i = 0; i < SERVER_CHECK_CONNECT_TRIES; i++) {
+    client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client->fd < 0)
+      return false;
+    if (connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+      client->in = fdopen(client->fd, "r");
+      return client->in != NULL;
+    }
+    close(client->fd);
+    usleep(SERVER_CHECK_CONNECT_WAIT_US);
+  }
+  return false;
+}
+
+void check_send(CheckClient *client, const char *fmt, ...) {
+  char buf[SERVER_LINE_LEN];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(buf, sizeof(buf) - 1, fmt, args);
+  va_end(args);
+  if (len > (int)sizeof(buf) - 2)
+    len = sizeof(buf) - 2;
+  buf[len++] = '\n';
+  // a server that went away shows up as an empty reply
+  if (write(client->fd, buf, len) != len)
+    return;
+}
+
+// a line without its newline, empty once the server hung up
+void check_read(CheckClient *client, char *line) {
+  if (fgets(line, SERVER_LINE_LEN, client->in) == NULL)
+    line[0] = '\0';
+  line[strcspn(line, "\r\n")] = '\0';
+}
+
+// the board text of the server against the one rendered from the copy
+bool check_board(CheckClient *client, Board *board) {
+  char expected[BOARD_TEXT_LEN], got[BOARD_TEXT_LEN + SERVER_LINE_LEN] = "";
+  render_board_text(board, expected);
+  check_send(client, "BOARD");
+  int len = 0;
+  char line[SERVER_LINE_LEN];
+  while (true) {
+    if (fgets(line, sizeof(line), client->in) == NULL)
+      return false;
+    if (strcmp(line, ".\n") == 0)
+      break;
+    if (len + (int)strlen(line) < BOARD_TEXT_LEN)
+      len += sprintf(got + len, "%s", line);
+  }
+  return strcmp(got, expected) == 0;
+}
+
+// both sessions get the same line after a turn
+bool check_event(CheckGame *check, char *line) {
+  char other[SERVER_LINE_LEN];
+  check_read(&check->seats[0], line);
+  check_read(&check->seats[1], other);
+  if (strcmp(line, other) == 0)
+    return true;
+  check_fail(check, "sides got '%s' and '%s'", line, other);
+  return false;
+}
+
+void open_check_game(CheckGame *check, const char *path, int number) {
+  memset(check, 0, sizeof(*check));
+  check->number = number;
+  check->active = true;
+  check->mirror = new_game_manager();
+  if (!check_connect(&check->seats[0], path) ||
+      !check_connect(&check->seats[1], path)) {
+    check_fail(check, "can't connect");
+    return;
+  }
+
+  char line[SERVER_LINE_LEN];
+  int id = -1;
+  check_send(&check->seats[0], "NEW");
+  check_read(&check->seats[0], line);
+  if (sscanf(line, "OK game %d w", &id) != 1) {
+    check_fail(check, "NEW replied '%s'", line);
+    return;
+  }
+  check_send(&check->seats[1], "JOIN %d", id);
+  check_read(&check->seats[1], line);
+  char expected[SERVER_LINE_LEN];
+  snprintf(expected, sizeof(expected), "OK game %d r", id);
+  if (strcmp(line, expected) != 0) {
+    check_fail(check, "JOIN replied '%s'", line);
+    return;
+  }
+  if (check_event(check, check->turn) &&
+      strncmp(check->turn, "TURN", 4) != 0)
+    check_fail(check, "expected the first turn, got '%s'", check->turn);
+}
+
+// the mover plays its choice step by step
+void play_check_turn(CheckGame *check, EngineConfig *policy, PlayList *plays,
+                     long long *moves) {
+  char side;
+  int v1, v2;
+  if (sscanf(check->turn, "TURN %c %d %d", &side, &v1, &v2) != 3) {
+    check_fail(check, "bad turn '%s'", check->turn);
+    return;
+  }
+  GameManager *mirror = &check->mirror;
+  mirror->curr_player = side == 'w' ? White : Red;
+  mirror->dice_roll = new_dice_roll(v1, v2);
+  CheckClient *mover = &check->seats[mirror->curr_player == Red];
+  if (!check_board(mover, &mirror->board)) {
+    check_fail(check, "board differs before turn %d", check->turns);
+    return;
+  }
+
+  EvalOutput eval;
+  Play *play = play_at(plays, choose_play(policy, mirror, plays, 0, &eval));
+  char line[SERVER_LINE_LEN];
+  for (int i = 0; i < play->move_count; i++) {
+    MoveEntry *move = &play->moves[i];
+    if (is_pos_on_bar(move->from))
+      check_send(mover, "ENTER %d", move->by);
+    else
+      check_send(mover, "MOVE %d %d", move->from + 1, move->by);
+    check_read(mover, line);
+    if (strcmp(line, "OK") != 0) {
+      check_fail(check, "step %d of turn %d replied '%s'", i, check->turns,
+                 line);
+      return;
+    }
+  }
+  mirror->board = play->board;
+  *moves += play->move_count;
+  check->turns++;
+
+  if (!check_event(check, check->turn))
+    return;
+  if (strncmp(check->turn, "TURN", 4) == 0) {
+    if (check->turns >= SERVER_CHECK_MAX_TURNS)
+      check_fail(check, "still going after %d turns", check->turns);
+    return;
+  }
+  check->active = false;
+  WinKind win_kind;
+  CheckerKind winner = check_game_over(mirror, &win_kind);
+  char expected[SERVER_LINE_LEN] = "OVER - 0";
+  if (winner != None)
+    snprintf(expected, sizeof(expected), "OVER %c %d", side_char(winner),
+             game_points(&mirror->match, win_kind));
+  if (strcmp(check->turn, expected) != 0)
+    check_fail(check, "got '%s' instead of '%s'", check->turn, expected);
+}
+
+void close_check_game(CheckGame *check) {
+  for (int i = 0; i < 2; i++) {
+    if (check->seats[i].in != NULL)
+      fclose(check->seats[i].in);
+  }
+  free_game_manager(&check->mirror);
+}
+
+// usage: ./server --check [games]
+int check_server(int games) {
+  if (games < 1)
+    games = 1;
+  if (games > MAX_SERVER_CHECK_GAMES)
+    games = MAX_SERVER_CHECK_GAMES;
+  char path[SERVER_REPLY_LEN], address[2 * SERVER_REPLY_LEN];
+  snprintf(path, sizeof(path), SERVER_CHECK_SOCKET, (int)getpid());
+  snprintf(address, sizeof(address), "%s%s", UNIX_ADDRESS_PREFIX, path);
+
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("cannot start server");
+    return 1;
+  }
+  if (pid == 0)
+    exit(run_server(address));
+  signal(SIGPIPE, SIG_IGN);
+
+  static CheckGame checks[MAX_SERVER_CHECK_GAMES];
+  for (int i = 0; i < games; i++)
+    open_check_game(&checks[i], path, i + 1);
+
+  // the 0-ply player of the exporter, the server's dice vary the games
+  EngineConfig policy = default_engine_config();
+  policy.plies = 0;
+  PlayList plays;
+  new_play_list(&plays);
+  long long moves = 0;
+  for (bool playing = true; playing;) {
+    playing = false;
+    for (int i = 0; i < games; i++) {
+      if (!checks[i].active)
+        continue;
+      play_check_turn(&checks[i], &policy, &plays, &moves);
+      playing = true;
+    }
+  }
+  free_play_list(&plays);
+
+  int failed = 0, turns = 0;
+  for (int i = 0; i < games; i++) {
+    failed += checks[i].failed;
+    turns += checks[i].turns;
+    close_check_game(&checks[i]);
+  }
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+  unlink(path);
+  printf("check: %d games %d turns %lld moves, %d failed\n", games, turns,
+         moves, failed);
+  return failed > 0;
+}
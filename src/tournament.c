@@ -0,0 +1,328 @@
+#pragma once
+#include "../headers/tournament.h"
+#include "engine.c"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+// An engine configuration taking part: search settings and the weights it
+// evaluates with, the heuristic evaluator when it has none
+typedef struct {
+  char name[MAX_PLAYER_NAME];
+  EngineConfig config;
+  Network network, race_network;
+  bool has_network, has_race_network;
+} TournamentPlayer;
+
+typedef struct {
+  double elo0, elo1, alpha, beta;
+} SprtConfig;
+
+// Two players over pairs of games with the same dice, each playing White in
+// one of them. A pair scores the first player's wins in it divided by two,
+// so the luck of the dice mostly cancels out within the pair.
+typedef struct {
+  TournamentPlayer *players[2];
+  unsigned long long seed;
+  int max_pairs;
+  SprtConfig sprt;
+  atomic_int next_pair;
+  atomic_bool stop;
+  pthread_mutex_t lock;
+  // guarded by lock
+  long long pairs, wins, points;
+  double score_sum, score_squares, llr;
+} Matchup;
+
+double elo_score(double elo) { return 1 / (1 + pow(10, -elo / 400)); }
+
+double score_elo(double score) {
+  if (score <= 0 || score >= 1)
+    return score <= 0 ? -INFINITY : INFINITY;
+  return 400 * log10(score / (1 - score));
+}
+
+// Generalized SPRT on the pair scores: the log likelihood ratio of elo1
+// against elo0 with the scores taken as normal around their mean
+double sprt_llr(Matchup *matchup) {
+  double mean = matchup->score_sum / matchup->pairs;
+  double var = matchup->score_squares / matchup->pairs - mean * mean;
+  if (var <= 0)
+    return 0;
+  double s0 = elo_score(matchup->sprt.elo0);
+  double s1 = elo_score(matchup->sprt.elo1);
+  return matchup->pairs * (s1 - s0) * (2 * mean - s0 - s1) / (2 * var);
+}
+
+double sprt_lower(SprtConfig *sprt) {
+  return log(sprt->beta / (1 - sprt->alpha));
+}
+
+double sprt_upper(SprtConfig *sprt) {
+  return log((1 - sprt->beta) / sprt->alpha);
+}
+
+// points won by White, 0 when the game runs past MAX_TOURNAMENT_TURNS
+int play_tournament_game(TournamentPlayer *white, TournamentPlayer *red,
+                         EngineConfig configs[2], unsigned long long seed) {
+  Rng rng = new_rng(seed);
+  DiceRoll roll;
+  do {
+    roll = rng_dice_roll(&rng);
+  } while (roll.v1 == roll.v2);
+  Board board = default_board();
+  GameManager state =
+      position_state(&board, roll.v1 < roll.v2 ? Red : White, roll);
+
+  for (int turn = 0; turn < MAX_TOURNAMENT_TURNS; turn++) {
+    bool white_moves = state.curr_player == White;
+    TournamentPlayer *player = white_moves ? white : red;
+    thread_eval_network = player->has_network ? &player->network : NULL;
+    thread_race_network =
+        player->has_race_network ? &player->race_network : NULL;
+
+    Play play;
+    EvalOutput eval;
+    FilterStats stats;
+    if (best_play(&configs[!white_moves], &state, &play, &eval, &stats))
+      state.board = play.board;
+    WinKind win_kind;
+    CheckerKind won = check_game_over(&state, &win_kind);
+    if (won != None)
+      return won == White ? (int)win_kind : -(int)win_kind;
+    state.curr_player = opposite_checker(state.curr_player);
+    state.dice_roll = rng_dice_roll(&rng);
+  }
+  return 0;
+}
+
+// pairs are handed out one at a time until they run out or the SPRT
+// decides, pairs already started when it does still count
+void *tournament_worker(void *arg) {
+  Matchup *matchup = arg;
+  TournamentPlayer *first = matchup->players[0];
+  TournamentPlayer *second = matchup->players[1];
+  EngineConfig first_white[2] = {first->config, second->config};
+  EngineConfig second_white[2] = {second->config, first->config};
+  int pair;
+  while (!atomic_load(&matchup->stop) &&
+         (pair = atomic_fetch_add(&matchup->next_pair, 1)) <
+             matchup->max_pairs) {
+    unsigned long long seed = matchup->seed ^ (pair + 1) * RNG_MULTIPLIER;
+    int white_game = play_tournament_game(first, second, first_white, seed);
+    int red_game = -play_tournament_game(second, first, second_white, seed);
+    double score = ((white_game > 0) + (white_game == 0) * 0.5 +
+                    (red_game > 0) + (red_game == 0) * 0.5) /
+                   2;
+
+    pthread_mutex_lock(&matchup->lock);
+    matchup->pairs++;
+    matchup->wins += (white_game > 0) + (red_game > 0);
+    matchup->points += white_game + red_game;
+    matchup->score_sum += score;
+    matchup->score_squares += score * score;
+    if (matchup->pairs >= MIN_SPRT_PAIRS) {
+      matchup->llr = sprt_llr(matchup);
+      if (matchup->llr <= sprt_lower(&matchup->sprt) ||
+          matchup->llr >= sprt_upper(&matchup->sprt))
+        atomic_store(&matchup->stop, true);
+    }
+    pthread_mutex_unlock(&matchup->lock);
+  }
+  thread_eval_network = thread_race_network = NULL;
+  return NULL;
+}
+
+// the scratch arena is thread local, the threads started here free theirs
+void *tournament_thread(void *arg) {
+  tournament_worker(arg);
+  free_arena(scratch_arena());
+  return NULL;
+}
+
+void report_matchup(Matchup *matchup, double secs) {
+  long long pairs = matchup->pairs;
+  double mean = pairs > 0 ? matchup->score_sum / pairs : 0.5;
+  double var = pairs > 0 ? matchup->score_squares / pairs - mean * mean : 0;
+  double margin = pairs > 0 && var > 0 ? 1.96 * sqrt(var / pairs) : 0;
+  const char *verdict = "no decision";
+  if (matchup->llr >= sprt_upper(&matchup->sprt))
+    verdict = "H1 accepted";
+  else if (matchup->llr <= sprt_lower(&matchup->sprt))
+    verdict = "H0 accepted";
+
+  printf("%s vs %s: pairs %lld wins %lld/%lld score %.4f elo %+.1f "
+         "[%+.1f, %+.1f] points/game %+.3f\n",
+         matchup->players[0]->name, matchup->players[1]->name, pairs,
+         matchup->wins, 2 * pairs, mean, score_elo(mean),
+         score_elo(mean - margin), score_elo(mean + margin),
+         pairs > 0 ? (double)matchup->points / (2 * pairs) : 0);
+  printf("  sprt elo %.1f vs %.1f llr %.3f [%.3f, %.3f] %s, %.2fs "
+         "%.1f games/s\n",
+         matchup->sprt.elo0, matchup->sprt.elo1, matchup->llr,
+         sprt_lower(&matchup->sprt), sprt_upper(&matchup->sprt), verdict,
+         secs, secs > 0 ? 2 * pairs / secs : 0);
+}
+
+void run_matchup(Matchup *matchup, int threads) {
+  atomic_init(&matchup->next_pair, 0);
+  atomic_init(&matchup->stop, false);
+  pthread_mutex_init(&matchup->lock, NULL);
+  double start = monotonic_seconds();
+
+  pthread_t handles[MAX_TOURNAMENT_THREADS];
+  int started = 0;
+  for (int i = 1; i < threads; i++) {
+    if (pthread_create(&handles[started], NULL, tournament_thread,
+                       matchup) == 0)
+      started++;
+  }
+  tournament_worker(matchup);
+  for (int i = 0; i < started; i++)
+    pthread_join(handles[i], NULL);
+
+  report_matchup(matchup, monotonic_seconds() - start);
+  fflush(stdout);
+  pthread_mutex_destroy(&matchup->lock);
+}
+
+// name[:key=value,...] with plies, keep and margin of the move filter's
+// first stage, halved at every later one, movetime in ms, weights and
+// raceweights files
+bool parse_player(const char *spec, TournamentPlayer *player) {
+  memset(player, 0, sizeof(*player));
+  player->config = default_engine_config();
+  char buf[MAX_PLAYER_SPEC_LEN];
+  if (strlen(spec) >= sizeof(buf))
+    return false;
+  strcpy(buf, spec);
+
+  char *opts = strchr(buf, ':');
+  if (opts != NULL)
+    *opts++ = '\0';
+  if (buf[0] == '\0' || strlen(buf) >= MAX_PLAYER_NAME)
+    return false;
+  strcpy(player->name, buf);
+
+  int keep = DEFAULT_FILTER_KEEP;
+  float margin = DEFAULT_FILTER_MARGIN;
+  char *save = NULL;
+  for (char *opt = opts != NULL ? strtok_r(opts, ",", &save) : NULL;
+       opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+    char *val = strchr(opt, '=');
+    if (val == NULL)
+      return false;
+    *val++ = '\0';
+    if (strcmp(opt, "plies") == 0) {
+      player->config.plies = atoi(val);
+      if (player->config.plies < 0 || player->config.plies > MAX_PLIES)
+        return false;
+    } else if (strcmp(opt, "keep") == 0) {
+      keep = atoi(val);
+    } else if (strcmp(opt, "margin") == 0) {
+      margin = atof(val);
+    } else if (strcmp(opt, "movetime") == 0) {
+      player->config.move_time_ms = atoi(val);
+      if (player->config.move_time_ms < 0 ||
+          player->config.move_time_ms > MAX_MOVE_TIME_MS)
+        return false;
+    } else if (strcmp(opt, "weights") == 0) {
+      player->has_network = load_network(&player->network, val);
+      if (!player->has_network)
+        return false;
+    } else if (strcmp(opt, "raceweights") == 0) {
+      player->has_race_network = load_network(&player->race_network, val);
+      if (!player->has_race_network)
+        return false;
+    } else {
+      return false;
+    }
+  }
+  if (keep < 1 || margin < 0)
+    return false;
+  for (int i = 0; i < MAX_PLIES; i++) {
+    int stage_keep = keep >> i;
+    player->config.filters[i] =
+        (MoveFilter){stage_keep > 0 ? stage_keep : 1, margin / (1 << i)};
+  }
+  return true;
+}
+
+void tournament_usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s %s <name[:plies=n,keep=n,margin=x,movetime=ms,"
+          "weights=file,raceweights=file]>...\n"
+          "       [%s] [%s <max pairs>] [%s <n>] [%s <n>]\n"
+          "       [%s <elo0> <elo1> <alpha> <beta>]\n",
+          program, TOURNAMENT_PLAYER_FLAG, TOURNAMENT_GAUNTLET_FLAG,
+          TOURNAMENT_PAIRS_FLAG, TOURNAMENT_THREADS_FLAG,
+          TOURNAMENT_SEED_FLAG, TOURNAMENT_SPRT_FLAG);
+}
+
+// Round robin between all players, or with --gauntlet the first player
+// against each of the others. Matchups are played one after the other,
+// every one of them on all threads.
+int run_tournament(int argc, char **argv) {
+  static TournamentPlayer players[MAX_TOURNAMENT_PLAYERS];
+  int player_count = 0;
+  bool gauntlet = false;
+  int max_pairs = DEFAULT_TOURNAMENT_PAIRS;
+  int threads = online_cpus();
+  unsigned long long seed = time(NULL);
+  SprtConfig sprt = {DEFAULT_SPRT_ELO0, DEFAULT_SPRT_ELO1, DEFAULT_SPRT_ALPHA,
+                     DEFAULT_SPRT_BETA};
+  bool args_ok = true;
+  for (int i = 1; i < argc && args_ok; i++) {
+    bool has_val = i + 1 < argc;
+    if (strcmp(argv[i], TOURNAMENT_PLAYER_FLAG) == 0 && has_val) {
+      args_ok = player_count < MAX_TOURNAMENT_PLAYERS &&
+                parse_player(argv[++i], &players[player_count]);
+      if (!args_ok)
+        fprintf(stderr, "bad player %s\n", argv[i]);
+      player_count++;
+    } else if (strcmp(argv[i], TOURNAMENT_GAUNTLET_FLAG) == 0) {
+      gauntlet = true;
+    } else if (strcmp(argv[i], TOURNAMENT_PAIRS_FLAG) == 0 && has_val) {
+      max_pairs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], TOURNAMENT_THREADS_FLAG) == 0 && has_val) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], TOURNAMENT_SEED_FLAG) == 0 && has_val) {
+      seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], TOURNAMENT_SPRT_FLAG) == 0 && i + 4 < argc) {
+      sprt = (SprtConfig){atof(argv[i + 1]), atof(argv[i + 2]),
+                          atof(argv[i + 3]), atof(argv[i + 4])};
+      i += 4;
+      args_ok = sprt.elo0 < sprt.elo1 && sprt.alpha > 0 && sprt.alpha < 1 &&
+                sprt.beta > 0 && sprt.beta < 1;
+    } else {
+      args_ok = false;
+    }
+  }
+  if (!args_ok || player_count < 2 || max_pairs < 1) {
+    tournament_usage(argv[0]);
+    return 1;
+  }
+  if (threads < 1)
+    threads = 1;
+  if (threads > MAX_TOURNAMENT_THREADS)
+    threads = MAX_TOURNAMENT_THREADS;
+  printf("seed %llu\n", seed);
+
+  static Matchup matchup;
+  for (int i = 0; i < player_count; i++) {
+    for (int j = i + 1; j < player_count; j++) {
+      if (gauntlet && i > 0)
+        break;
+      memset(&matchup, 0, sizeof(matchup));
+      matchup.players[0] = &players[i];
+      matchup.players[1] = &players[j];
+      matchup.seed = seed;
+      matchup.max_pairs = max_pairs;
+      matchup.sprt = sprt;
+      run_matchup(&matchup, threads);
+    }
+  }
+  return 0;
+}
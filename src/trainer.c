@@ -0,0 +1,326 @@
+#pragma once
+#include "../headers/trainer.h"
+#include "atomic_queue.c"
+#include "eval.c"
+#include "game.c"
+#include "movegen.c"
+#include "neural.c"
+#include "rng.c"
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Workers play whole self-play games with a snapshot of the weights and
+// hand the summed TD(lambda) update of each game to the learner through a
+// lock-free queue. The learner adds it to the weights, publishes a new
+// snapshot and sends the buffer back through a second queue.
+typedef struct {
+  Network weights;
+  Network snapshot;
+  pthread_mutex_t snapshot_lock;
+  atomic_uint snapshot_version;
+
+  AtomicQueue gradients;
+  AtomicQueue free_buffers;
+  Network *buffers;
+  int buffer_count;
+
+  atomic_bool stop;
+  atomic_llong positions;
+} Trainer;
+
+typedef struct {
+  Trainer *trainer;
+  pthread_t thread;
+  Rng rng;
+  Network weights;
+  unsigned weights_version;
+  // one trace per output, they share the hidden layer
+  Network traces[NET_OUTPUTS];
+  PlayList plays;
+} TrainWorker;
+
+volatile sig_atomic_t train_stop = 0;
+
+void handle_train_stop(int sig) {
+  (void)sig;
+  train_stop = 1;
+}
+
+void refresh_worker_weights(TrainWorker *worker) {
+  Trainer *trainer = worker->trainer;
+  unsigned version = atomic_load(&trainer->snapshot_version);
+  if (version == worker->weights_version)
+    return;
+  pthread_mutex_lock(&trainer->snapshot_lock);
+  worker->weights = trainer->snapshot;
+  worker->weights_version = atomic_load(&trainer->snapshot_version);
+  pthread_mutex_unlock(&trainer->snapshot_lock);
+}
+
+void scale_params(float *restrict params, float scale) {
+  for (size_t i = 0; i < NET_PARAM_COUNT; i++)
+    params[i] *= scale;
+}
+
+// params += scale * other, the hot loop of both the workers and the learner
+void add_scaled_params(float *restrict params, const float *restrict other,
+                       float scale) {
+  for (size_t i = 0; i < NET_PARAM_COUNT; i++)
+    params[i] += scale * other[i];
+}
+
+void add_scaled_inputs(float *restrict weights, const float *restrict inputs,
+                       float scale) {
+  for (int i = 0; i < NET_INPUTS; i++)
+    weights[i] += scale * inputs[i];
+}
+
+// decays the eligibility traces and adds the gradient of every output at
+// the position in act
+void update_traces(TrainWorker *worker, NetworkActivations *act) {
+  Network *weights = &worker->weights;
+  for (int k = 0; k < NET_OUTPUTS; k++) {
+    Network *trace = &worker->traces[k];
+    scale_params(network_params(trace), TD_LAMBDA);
+
+    float out = act->outputs[k];
+    float out_grad = out * (1 - out);
+    trace->output_bias[k] += out_grad;
+    for (int j = 0; j < NET_HIDDEN; j++) {
+      float hidden = act->hidden[j];
+      trace->output_weights[k][j] += out_grad * hidden;
+      float hidden_grad = out_grad * weights->output_weights[k][j] * hidden *
+                          (1 - hidden);
+      trace->hidden_bias[j] += hidden_grad;
+      add_scaled_inputs(trace->hidden_weights[j], act->inputs, hidden_grad);
+    }
+  }
+}
+
+void td_step(TrainWorker *worker, Network *update, const float *value,
+             const float *target) {
+  for (int k = 0; k < NET_OUTPUTS; k++) {
+    float error = target[k] - value[k];
+    add_scaled_params(network_params(update),
+                      network_params(&worker->traces[k]), TD_ALPHA * error);
+  }
+}
+
+float white_equity(const float *outputs) {
+  return 2 * outputs[0] - 1 + outputs[1] - outputs[3] + outputs[2] -
+         outputs[4];
+}
+
+// the play whose position is best for the player with the worker's weights
+Play *choose_training_play(TrainWorker *worker, GameManager *state) {
+  generate_plays(state, &worker->plays);
+  CheckerKind player = state->curr_player;
+  float sign = player == White ? 1 : -1;
+  Play *best = play_at(&worker->plays, 0);
+  float best_equity = -4;
+  for (int i = 0; i < play_count(&worker->plays); i++) {
+    Play *play = play_at(&worker->plays, i);
+    NetworkActivations act;
+    encode_board(&play->board, opposite_checker(player), act.inputs);
+    network_forward(&worker->weights, &act);
+    float equity = sign * white_equity(act.outputs);
+    if (equity > best_equity) {
+      best_equity = equity;
+      best = play;
+    }
+  }
+  return best;
+}
+
+void game_result_outputs(CheckerKind winner, WinKind win_kind, float *out) {
+  bool white_won = winner == White;
+  out[0] = white_won;
+  out[1] = white_won && win_kind >= GammonWin;
+  out[2] = white_won && win_kind >= BackgammonWin;
+  out[3] = !white_won && win_kind >= GammonWin;
+  out[4] = !white_won && win_kind >= BackgammonWin;
+}
+
+// plays one game against itself and sums its weight update into update
+void play_training_game(TrainWorker *worker, Network *update) {
+  memset(update, 0, sizeof(Network));
+  memset(worker->traces, 0, sizeof(worker->traces));
+
+  GameManager state;
+  memset(&state, 0, sizeof(state));
+  state.board = default_board();
+  do {
+    state.dice_roll = rng_dice_roll(&worker->rng);
+  } while (state.dice_roll.v1 == state.dice_roll.v2);
+  state.curr_player = state.dice_roll.v1 > state.dice_roll.v2 ? White : Red;
+
+  NetworkActivations act, next;
+  encode_board(&state.board, state.curr_player, act.inputs);
+  network_forward(&worker->weights, &act);
+  int turn;
+  for (turn = 0; turn < MAX_TRAIN_TURNS; turn++) {
+    update_traces(worker, &act);
+    state.board = choose_training_play(worker, &state)->board;
+
+    WinKind win_kind;
+    CheckerKind winner = check_game_over(&state, &win_kind);
+    if (winner != None) {
+      float result[NET_OUTPUTS];
+      game_result_outputs(winner, win_kind, result);
+      td_step(worker, update, act.outputs, result);
+      break;
+    }
+
+    state.curr_player = opposite_checker(state.curr_player);
+    state.dice_roll = rng_dice_roll(&worker->rng);
+    encode_board(&state.board, state.curr_player, next.inputs);
+    network_forward(&worker->weights, &next);
+    td_step(worker, update, act.outputs, next.outputs);
+    act = next;
+  }
+  atomic_fetch_add(&worker->trainer->positions, turn + 1);
+}
+
+void *train_worker(void *arg) {
+  TrainWorker *worker = arg;
+  Trainer *trainer = worker->trainer;
+  while (!atomic_load(&trainer->stop)) {
+    void *buffer;
+    if (!atomic_queue_pop(&trainer->free_buffers, &buffer)) {
+      usleep(TRAIN_IDLE_US);
+      continue;
+    }
+    refresh_worker_weights(worker);
+    play_training_game(worker, buffer);
+    // never full, it has room for every buffer
+    atomic_queue_push(&trainer->gradients, buffer);
+  }
+  return NULL;
+}
+
+void publish_weights(Trainer *trainer) {
+  pthread_mutex_lock(&trainer->snapshot_lock);
+  trainer->snapshot = trainer->weights;
+  atomic_fetch_add(&trainer->snapshot_version, 1);
+  pthread_mutex_unlock(&trainer->snapshot_lock);
+}
+
+// written next to the file first, so a crash never leaves half the weights
+bool checkpoint_weights(Network *weights, const char *filename) {
+  char tmp[MAX_FILENAME_LEN + sizeof(CHECKPOINT_TMP_SUFFIX)];
+  snprintf(tmp, sizeof(tmp), "%s%s", filename, CHECKPOINT_TMP_SUFFIX);
+  return save_network(weights, tmp) && rename(tmp, filename) == 0;
+}
+
+void report_training(Trainer *trainer, long long games, double elapsed) {
+  long long positions = atomic_load(&trainer->positions);
+  printf("games %lld games/hour %.0f positions/s %.0f\n", games,
+         elapsed > 0 ? games * 3600 / elapsed : 0,
+         elapsed > 0 ? positions / elapsed : 0);
+  fflush(stdout);
+}
+
+// trains the weights in weights_file, or new random ones, until max_games
+// games are played (0 means until SIGINT or SIGTERM)
+int run_trainer(const char *weights_file, long long max_games, int threads) {
+  if (weights_file == NULL)
+    weights_file = NETWORK_FILE;
+  if (strlen(weights_file) > MAX_FILENAME_LEN) {
+    fprintf(stderr, "weights file name too long\n");
+    return 1;
+  }
+  if (threads < 1)
+    threads = 1;
+  if (threads > MAX_TRAIN_THREADS)
+    threads = MAX_TRAIN_THREADS;
+
+  Trainer *trainer = malloc(sizeof(Trainer));
+  TrainWorker *workers = malloc(threads * sizeof(TrainWorker));
+  if (trainer == NULL || workers == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  Rng rng = new_rng(time(NULL));
+  if (!load_network(&trainer->weights, weights_file)) {
+    printf("starting from random weights\n");
+    init_network(&trainer->weights, &rng);
+  }
+  trainer->snapshot = trainer->weights;
+  pthread_mutex_init(&trainer->snapshot_lock, NULL);
+  atomic_init(&trainer->snapshot_version, 1);
+  atomic_init(&trainer->stop, false);
+  atomic_init(&trainer->positions, 0);
+
+  trainer->buffer_count = threads * TRAIN_BUFFERS_PER_WORKER;
+  trainer->buffers = malloc(trainer->buffer_count * sizeof(Network));
+  if (trainer->buffers == NULL)
+    exit(NO_HEAP_MEM_EXIT);
+  new_atomic_queue(&trainer->gradients, trainer->buffer_count);
+  new_atomic_queue(&trainer->free_buffers, trainer->buffer_count);
+  for (int i = 0; i < trainer->buffer_count; i++)
+    atomic_queue_push(&trainer->free_buffers, &trainer->buffers[i]);
+
+  signal(SIGINT, handle_train_stop);
+  signal(SIGTERM, handle_train_stop);
+  int started = 0;
+  for (int i = 0; i < threads; i++) {
+    TrainWorker *worker = &workers[i];
+    worker->trainer = trainer;
+    worker->rng = new_rng(rng_next(&rng));
+    worker->weights_version = 0;
+    new_play_list(&worker->plays);
+    if (pthread_create(&worker->thread, NULL, train_worker, worker) != 0)
+      break;
+    started++;
+  }
+  if (started == 0) {
+    fprintf(stderr, "can't start worker threads\n");
+    return 1;
+  }
+
+  long long games = 0;
+  double start = monotonic_seconds();
+  double last_report = start, last_checkpoint = start;
+  while (!train_stop && (max_games <= 0 || games < max_games)) {
+    void *buffer;
+    if (!atomic_queue_pop(&trainer->gradients, &buffer)) {
+      usleep(TRAIN_IDLE_US);
+    } else {
+      add_scaled_params(network_params(&trainer->weights), buffer, 1);
+      atomic_queue_push(&trainer->free_buffers, buffer);
+      publish_weights(trainer);
+      games++;
+    }
+
+    double now = monotonic_seconds();
+    if (now - last_report >= TRAIN_REPORT_SECS) {
+      report_training(trainer, games, now - start);
+      last_report = now;
+    }
+    if (now - last_checkpoint >= TRAIN_CHECKPOINT_SECS) {
+      if (!checkpoint_weights(&trainer->weights, weights_file))
+        fprintf(stderr, "can't write %s\n", weights_file);
+      last_checkpoint = now;
+    }
+  }
+
+  atomic_store(&trainer->stop, true);
+  for (int i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+    free_play_list(&workers[i].plays);
+  }
+  report_training(trainer, games, monotonic_seconds() - start);
+  bool saved = checkpoint_weights(&trainer->weights, weights_file);
+  if (!saved)
+    fprintf(stderr, "can't write %s\n", weights_file);
+
+  free_atomic_queue(&trainer->gradients);
+  free_atomic_queue(&trainer->free_buffers);
+  pthread_mutex_destroy(&trainer->snapshot_lock);
+  free(trainer->buffers);
+  free(trainer);
+  free(workers);
+  return saved ? 0 : 1;
+}
@@ -1,8 +1,9 @@
 #include "../headers/vec.h"
+#include "arena.c"
 #include <stdlib.h>
 
-void vec_with_cap(Vec *vec_out, size_t elem_size, int cap) {
-  void *data = malloc(cap * elem_size);
+void vec_in_arena(Vec *vec_out, size_t elem_size, int cap, Arena *arena) {
+  void *data = pool_alloc(arena, cap * elem_size);
   if (data == NULL) {
     vec_out->data = NULL;
     return;
@@ -11,6 +12,11 @@ void vec_with_cap(Vec *vec_out, size_t elem_size, int cap) {
   vec_out->data = data;
   vec_out->cap = cap;
   vec_out->len = 0;
+  vec_out->arena = arena;
+}
+
+void vec_with_cap(Vec *vec_out, size_t elem_size, int cap) {
+  vec_in_arena(vec_out, elem_size, cap, NULL);
 }
 
 void vec_new(Vec *vec_out, size_t elem_size) {
@@ -21,8 +27,10 @@ int vec_extend(Vec *vec) {
   if (vec == NULL)
     return 1;
 
+  size_t old_size = vec->cap * vec->elem_size;
   vec->cap *= GROWTH_FACTOR;
-  vec->data = realloc(vec->data, vec->cap * vec->elem_size);
+  vec->data = pool_realloc(vec->arena, vec->data, old_size,
+                           vec->cap * vec->elem_size);
 
   if (vec->data == NULL)
     return 1;
@@ -30,8 +38,26 @@ int vec_extend(Vec *vec) {
   return 0;
 }
 
+// drops the spare capacity, an empty vec keeps room for one element. Arena
+// memory only comes back on a reset, so an arena vec stays as it is.
+int vec_shrink(Vec *vec) {
+  if (vec == NULL)
+    return 1;
+  if (vec->arena != NULL)
+    return 0;
+
+  int cap = vec->len > 0 ? vec->len : 1;
+  void *data = realloc(vec->data, cap * vec->elem_size);
+  if (data == NULL)
+    return 1;
+
+  vec->data = data;
+  vec->cap = cap;
+  return 0;
+}
+
 void vec_free(Vec *vec) {
-  free(vec->data);
+  pool_free(vec->arena, vec->data);
   vec->data = NULL;
   vec->cap = 0;
   vec->len = 0;
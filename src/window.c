@@ -130,6 +130,17 @@ bool int_prompt_input(WinWrapper *io_wrapper, const char *prompt, int *res) {
   return false;
 }
 
+// true means user wants to quit, otherwise res says if the answer was yes
+bool yes_no_prompt_input(WinWrapper *io_wrapper, const char *prompt,
+                         bool *res) {
+  char input[MAX_INPUT_LEN] = "";
+  prompt_input(io_wrapper, prompt, input);
+  if (check_for_quit_input(input))
+    return true;
+  *res = tolower(input[0]) == 'y';
+  return false;
+}
+
 bool int_prompt_input_untill(WinWrapper *io_wrapper, const char *prompt,
                              int *res) {
   *res = -1;
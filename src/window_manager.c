@@ -1,7 +1,9 @@
 #include "../headers/window_manager.h"
 #include "../headers/game.h"
 #include "../headers/window.h"
+#include "board_text.c"
 #include "game.c"
+#include "hint.c"
 #include "window.c"
 #include <ncurses.h>
 #include <time.h>
@@ -111,9 +113,11 @@ void enable_cursor() {
 
 void menu_loop(WinManager *win_manager) {
   disable_cursor();
+  recover_game_menu(win_manager);
 
   while (true) {
     display_menu(win_manager);
+    report_save_failure(win_manager);
     switch (char_input()) {
     case 'q':
       return;
@@ -148,6 +152,9 @@ void run() {
 
   show_about_info(&win_manager.about_win);
   menu_loop(&win_manager);
+  free_analyst();
+  // the last saves are still being written
+  stop_autosave(&game_autosave);
 
   free_win_manager(&win_manager);
 }
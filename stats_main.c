@@ -0,0 +1,4 @@
+#include "src/window_manager.c"
+#include "src/game_stats.c"
+
+int main(int argc, char **argv) { return run_game_stats(argc, argv); }
@@ -0,0 +1,4 @@
+#include "src/window_manager.c"
+#include "src/tournament.c"
+
+int main(int argc, char **argv) { return run_tournament(argc, argv); }
@@ -0,0 +1,10 @@
+#include "src/window_manager.c"
+#include "src/trainer.c"
+
+// usage: ./train [weights file] [games, 0 = until interrupted] [threads]
+int main(int argc, char **argv) {
+  const char *weights_file = argc > 1 ? argv[1] : NULL;
+  long long games = argc > 2 ? atoll(argv[2]) : 0;
+  int threads = argc > 3 ? atoi(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+  return run_trainer(weights_file, games, threads);
+}